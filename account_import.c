@@ -0,0 +1,530 @@
+/*
+ * ========================================
+ * account_import.c
+ * =Description: Implementation of the bulk account
+ * loader.
+ *
+ * Pipeline:
+ * 1. Map the input and parse it into an array of
+ *    accounts, counting invalid rows
+ * 2. Sort (account_id, row) keys: repeats inside the
+ *    input are adjacent, the first one wins; existing
+ *    accounts are found by a merge against the sorted
+ *    IDs of accounts.dat
+ * 3. Append the survivors in ID order, IMPORT_BATCH_ROWS
+ *    at a time: one write for the profiles, one for the
+ *    states, one log append for the OPENING_BALANCE
+ *    entries, then the hash and B+tree index entries
+ *
+ * Concurrency: the load holds the account index writer
+ * lock (so no account is created meanwhile) and pauses
+ * the WAL (so no logged operation is pending while the
+ * data files and log are written directly).
+ *
+ * Atomicity: import.pending records the table and log
+ * lengths before the load and is removed once the load
+ * is on disk. If it is still there at startup the load
+ * is rolled back by truncating both. The MEMORY engine
+ * keeps nothing on disk and writes no marker.
+ * ========================================
+ */
+
+#include "account_import.h"
+#include "account_store.h"
+#include "record_index.h"
+#include "btree.h"
+#include "storage.h"
+#include "txn_log.h"
+#include "wal.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define IMPORT_PENDING_MAGIC 0x504d4931u // "IMP1"
+#define CSV_FIELDS_MAX 5
+
+// Contents of import.pending
+struct ImportPending {
+    unsigned int magic;
+    int reserved;
+    long long account_records;     // accounts.dat / account_profiles.dat length before the load
+    long long transaction_records; // Transaction log length before the load
+};
+
+// Position of one parsed row, sorted by account ID
+struct ImportKey {
+    int account_id;
+    int row;
+};
+
+// Collects the IDs already in accounts.dat
+struct ExistingIds {
+    int* ids;
+    long count;
+    long capacity;
+};
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// --- Parsing ---
+
+/**
+ * @brief Picks the input format from the file name: .bin and .dat are
+ * binary, anything else is CSV.
+ */
+int account_import_format(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (dot != NULL && (strcasecmp(dot, ".bin") == 0 || strcasecmp(dot, ".dat") == 0)) {
+        return IMPORT_FORMAT_BINARY;
+    }
+    return IMPORT_FORMAT_CSV;
+}
+
+/**
+ * @brief Parses a positive decimal account ID (digits only).
+ */
+static int parse_id(const char* text, size_t len, int* id) {
+    long long value = 0;
+    if (len == 0) return -1;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] < '0' || text[i] > '9') return -1;
+        value = value * 10 + (text[i] - '0');
+        if (value > INT_MAX) return -1;
+    }
+    if (value == 0) return -1;
+    *id = (int)value;
+    return 0;
+}
+
+/**
+ * @brief Copies a non-empty field that fits `size` with its terminator.
+ */
+static int copy_field(char* dst, size_t size, const char* text, size_t len) {
+    if (len == 0 || len >= size || memchr(text, '\0', len) != NULL) return -1;
+    memcpy(dst, text, len);
+    dst[len] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Parses "account_id,name,pin,opening_balance[,active]".
+ */
+static int parse_csv_row(const char* line, size_t len, struct CustomerAccount* account) {
+    const char* fields[CSV_FIELDS_MAX];
+    size_t lengths[CSV_FIELDS_MAX];
+    int count = 0;
+    const char* start = line;
+    const char* end = line + len;
+    for (;;) {
+        const char* comma = memchr(start, ',', (size_t)(end - start));
+        const char* stop = (comma != NULL) ? comma : end;
+        if (count == CSV_FIELDS_MAX) return -1;
+        fields[count] = start;
+        lengths[count++] = (size_t)(stop - start);
+        if (comma == NULL) break;
+        start = comma + 1;
+    }
+    if (count < 4) return -1;
+
+    char amount[32];
+    memset(account, 0, sizeof(*account));
+    if (parse_id(fields[0], lengths[0], &account->account_id) == -1 ||
+        copy_field(account->owner_name, sizeof(account->owner_name), fields[1], lengths[1]) == -1 ||
+        copy_field(account->access_pin, sizeof(account->access_pin), fields[2], lengths[2]) == -1 ||
+        copy_field(amount, sizeof(amount), fields[3], lengths[3]) == -1 ||
+        parse_money(amount, &account->balance) == -1 || account->balance < 0) return -1;
+
+    account->is_active = 1;
+    if (count == 5) {
+        if (lengths[4] != 1 || (fields[4][0] != '0' && fields[4][0] != '1')) return -1;
+        account->is_active = fields[4][0] - '0';
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks one binary input record.
+ */
+static int valid_account(const struct CustomerAccount* account) {
+    return account->account_id > 0 &&
+           account->owner_name[0] != '\0' && memchr(account->owner_name, '\0', sizeof(account->owner_name)) != NULL &&
+           account->access_pin[0] != '\0' && memchr(account->access_pin, '\0', sizeof(account->access_pin)) != NULL &&
+           account->balance >= 0 && account->balance <= MONEY_MAX_INPUT &&
+           (account->is_active == 0 || account->is_active == 1);
+}
+
+static void count_invalid(struct ImportReport* report, long position) {
+    if (report->invalid++ == 0) report->first_invalid = position;
+}
+
+/**
+ * @brief Parses a mapped CSV file. A first line that does not start with
+ * a digit is a header; blank lines are skipped.
+ * @return Number of valid rows stored in `rows`.
+ */
+static long parse_csv(const char* data, size_t size, struct CustomerAccount* rows, struct ImportReport* report) {
+    long valid = 0, line_number = 0;
+    const char* end = data + size;
+    for (const char* line = data; line < end; ) {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        const char* stop = (newline != NULL) ? newline : end;
+        size_t len = (size_t)(stop - line);
+        if (len > 0 && line[len - 1] == '\r') len--;
+        line_number++;
+
+        if (len > 0 && !(line_number == 1 && (line[0] < '0' || line[0] > '9'))) {
+            report->rows++;
+            if (parse_csv_row(line, len, &rows[valid]) == 0) {
+                valid++;
+            } else {
+                count_invalid(report, line_number);
+            }
+        }
+        line = stop + 1;
+    }
+    return valid;
+}
+
+/**
+ * @brief Parses a mapped file of struct CustomerAccount records.
+ * @return Number of valid rows stored in `rows`.
+ */
+static long parse_binary(const char* data, size_t size, struct CustomerAccount* rows, struct ImportReport* report) {
+    long records = (long)(size / sizeof(struct CustomerAccount));
+    long valid = 0;
+    for (long i = 0; i < records; i++) {
+        memcpy(&rows[valid], data + (size_t)i * sizeof(struct CustomerAccount), sizeof(struct CustomerAccount));
+        report->rows++;
+        if (valid_account(&rows[valid])) {
+            valid++;
+        } else {
+            count_invalid(report, i + 1);
+        }
+    }
+    return valid;
+}
+
+/**
+ * @brief Maps the input and parses it into a malloc'd array.
+ * @return The rows (NULL with *count 0 for an empty file), or NULL with
+ * *count -1 on error.
+ */
+static struct CustomerAccount* read_input(const char* path, int format, long* count, struct ImportReport* report) {
+    *count = -1;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (format == IMPORT_FORMAT_BINARY && st.st_size % sizeof(struct CustomerAccount) != 0)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    report->bytes = st.st_size;
+    if (st.st_size == 0) {
+        close(fd);
+        *count = 0;
+        return NULL;
+    }
+
+    const char* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    madvise((void*)data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    // Upper bound on rows: records, or newlines + 1
+    long capacity = (long)(st.st_size / sizeof(struct CustomerAccount));
+    if (format == IMPORT_FORMAT_CSV) {
+        capacity = 1;
+        for (const char* p = data; (p = memchr(p, '\n', (size_t)(data + st.st_size - p))) != NULL; p++) capacity++;
+    }
+
+    struct CustomerAccount* rows = malloc((size_t)capacity * sizeof(*rows));
+    if (rows != NULL) {
+        *count = (format == IMPORT_FORMAT_CSV) ? parse_csv(data, (size_t)st.st_size, rows, report)
+                                               : parse_binary(data, (size_t)st.st_size, rows, report);
+    }
+    munmap((void*)data, (size_t)st.st_size);
+    return rows;
+}
+
+// --- De-duplication ---
+
+static int compare_keys(const void* a, const void* b) {
+    const struct ImportKey* x = a;
+    const struct ImportKey* y = b;
+    if (x->account_id != y->account_id) return (x->account_id < y->account_id) ? -1 : 1;
+    return (x->row < y->row) ? -1 : (x->row > y->row);
+}
+
+static int compare_ids(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x < y) ? -1 : (x > y);
+}
+
+static int collect_existing_id(int record, const void* data, void* ctx) {
+    struct ExistingIds* existing = ctx;
+    if (existing->count == existing->capacity) return 1; // Appended after we counted: cannot happen under the lock
+    existing->ids[existing->count++] = ((const struct AccountState*)data)->account_id;
+    return 0;
+}
+
+/**
+ * @brief Sorts the rows by ID and drops repeats and existing accounts.
+ * Call with account creation locked out.
+ * @return The number of keys kept at the front of `keys` (in ID order),
+ * or -1 on error.
+ */
+static long select_new_accounts(const struct CustomerAccount* rows, long count, struct ImportKey* keys,
+                                struct ImportReport* report) {
+    for (long i = 0; i < count; i++) {
+        keys[i].account_id = rows[i].account_id;
+        keys[i].row = (int)i;
+    }
+    qsort(keys, (size_t)count, sizeof(*keys), compare_keys);
+
+    long existing_count = storage_count(STORAGE_ACCOUNTS);
+    if (existing_count < 0) return -1;
+    struct ExistingIds existing = {malloc((size_t)(existing_count + 1) * sizeof(int)), 0, existing_count};
+    if (existing.ids == NULL || storage_scan(STORAGE_ACCOUNTS, collect_existing_id, &existing) == -1) {
+        free(existing.ids);
+        return -1;
+    }
+    qsort(existing.ids, (size_t)existing.count, sizeof(int), compare_ids);
+
+    long kept = 0, e = 0;
+    for (long i = 0; i < count; i++) {
+        int id = keys[i].account_id;
+        while (e < existing.count && existing.ids[e] < id) e++;
+        if ((i > 0 && keys[i - 1].account_id == id) || (e < existing.count && existing.ids[e] == id)) {
+            report->duplicates++;
+        } else {
+            keys[kept++] = keys[i];
+        }
+    }
+    free(existing.ids);
+    return kept;
+}
+
+// --- Pending Marker ---
+
+static void sync_path(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int write_pending(long long account_records, long long transaction_records) {
+    struct ImportPending pending = {IMPORT_PENDING_MAGIC, 0, account_records, transaction_records};
+    int fd = open(IMPORT_PENDING_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return -1;
+    int ok = write(fd, &pending, sizeof(pending)) == sizeof(pending) && fsync(fd) == 0;
+    close(fd);
+    sync_path(".");
+    return ok ? 0 : -1;
+}
+
+static void remove_pending(void) {
+    unlink(IMPORT_PENDING_FILE);
+    sync_path(".");
+}
+
+/**
+ * @brief Rolls back a load that did not finish: cuts the account tables
+ * and the transaction log back to their length before it. Must run at
+ * startup after txn_log_init() and before wal_recover() and any index
+ * is built.
+ * @return 0 on success (or nothing to do), -1 on failure.
+ */
+int account_import_recover(void) {
+    int fd = open(IMPORT_PENDING_FILE, O_RDONLY);
+    if (fd == -1) return (errno == ENOENT) ? 0 : -1;
+
+    struct ImportPending pending;
+    ssize_t n = read(fd, &pending, sizeof(pending));
+    close(fd);
+    if (n != sizeof(pending) || pending.magic != IMPORT_PENDING_MAGIC) {
+        // Torn marker: the load had not written anything yet
+        remove_pending();
+        return 0;
+    }
+
+    struct stat st;
+    int rc = 0;
+    if (stat(ACCOUNT_PROFILE_FILE, &st) == 0 &&
+        st.st_size > (off_t)(pending.account_records * (long long)sizeof(struct AccountProfile))) {
+        if (truncate(ACCOUNT_PROFILE_FILE, pending.account_records * sizeof(struct AccountProfile)) == -1) rc = -1;
+    }
+    if (stat(ACCOUNT_DB_FILE, &st) == 0 &&
+        st.st_size > (off_t)(pending.account_records * (long long)sizeof(struct AccountState))) {
+        if (truncate(ACCOUNT_DB_FILE, pending.account_records * sizeof(struct AccountState)) == -1) rc = -1;
+    }
+    // transactions.idx is cut to the log's length by txn_index_init()
+    if (txn_log_record_count() > pending.transaction_records &&
+        txn_log_truncate((long)pending.transaction_records) == -1) rc = -1;
+    if (rc == -1) {
+        perror("import: rollback failed");
+        return -1;
+    }
+
+    sync_path(ACCOUNT_PROFILE_FILE);
+    sync_path(ACCOUNT_DB_FILE);
+    remove_pending();
+    printf("Import: rolled back an unfinished bulk load (%lld accounts kept)\n", pending.account_records);
+    return 0;
+}
+
+// --- Loading ---
+
+/**
+ * @brief Appends the selected rows in batches and indexes them.
+ * Caller holds the account writer lock.
+ */
+static int load_accounts(const struct CustomerAccount* rows, const struct ImportKey* keys, long count,
+                         int first_record) {
+    struct AccountProfile* profiles = malloc(IMPORT_BATCH_ROWS * sizeof(*profiles));
+    struct AccountState* states = malloc(IMPORT_BATCH_ROWS * sizeof(*states));
+    struct Transaction* entries = malloc(IMPORT_BATCH_ROWS * sizeof(*entries));
+    int rc = (profiles != NULL && states != NULL && entries != NULL) ? 0 : -1;
+
+    // Every entry of the load shares one timestamp
+    struct Transaction opening;
+    build_transaction(&opening, 0, TXN_OP_OPENING_BALANCE, 0, -1, 0);
+
+    for (long done = 0; rc == 0 && done < count; done += IMPORT_BATCH_ROWS) {
+        int batch = (count - done < IMPORT_BATCH_ROWS) ? (int)(count - done) : IMPORT_BATCH_ROWS;
+        for (int i = 0; i < batch; i++) {
+            const struct CustomerAccount* account = &rows[keys[done + i].row];
+            split_account(account, &states[i], &profiles[i]);
+            entries[i] = opening;
+            entries[i].account_id = account->account_id;
+            entries[i].amount = account->balance;
+            entries[i].resulting_balance = account->balance;
+        }
+
+        // Profiles first, so a record in the accounts table always has one
+        int record = first_record + (int)done;
+        if (storage_extend_batch(STORAGE_ACCOUNT_PROFILES, record, batch, profiles) == -1 ||
+            storage_extend_batch(STORAGE_ACCOUNTS, record, batch, states) == -1 ||
+            storage_append_transactions(entries, batch) == -1) {
+            rc = -1;
+            break;
+        }
+        for (int i = 0; i < batch; i++) {
+            if (g_account_index != NULL) record_index_insert(g_account_index, states[i].account_id, record + i);
+            btree_insert(g_account_btree, states[i].account_id, record + i);
+        }
+    }
+
+    free(profiles);
+    free(states);
+    free(entries);
+    return rc;
+}
+
+/**
+ * @brief Loads every new, valid account from `path`.
+ * @return 0 on success (see the report for what was skipped),
+ * IMPORT_UNREADABLE, or -1 on a database error.
+ */
+int account_import_file(const char* path, int format, struct ImportReport* report) {
+    struct timespec start;
+    memset(report, 0, sizeof(*report));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long count;
+    struct CustomerAccount* rows = read_input(path, format, &count, report);
+    if (count < 0) return IMPORT_UNREADABLE;
+    if (count == 0 || account_store_open() == -1) {
+        free(rows);
+        report->parse_seconds = seconds_since(&start);
+        return (count == 0) ? 0 : -1;
+    }
+    struct ImportKey* keys = malloc((size_t)count * sizeof(*keys));
+    if (keys == NULL) {
+        free(rows);
+        return -1;
+    }
+
+    // Same serialization as account_store_create(), then hold WAL operations back
+    int table_locked = (g_account_index == NULL || record_index_lock(g_account_index) == -1);
+    if (table_locked) storage_lock(STORAGE_ACCOUNTS, STORAGE_WHOLE_TABLE, 1);
+    int rc = -1;
+    if (wal_pause() == -1) {
+        fprintf(stderr, "import: could not pause the WAL\n");
+        goto unlock;
+    }
+
+    long selected = select_new_accounts(rows, count, keys, report);
+    long first_record = storage_count(STORAGE_ACCOUNTS);
+    report->parse_seconds = seconds_since(&start);
+    if (selected < 0 || first_record < 0 || first_record + selected > INT_MAX) goto resume;
+
+    int durable = (storage_engine() != STORAGE_MEMORY);
+    if (selected > 0) {
+        if (durable && write_pending(first_record, txn_log_record_count()) == -1) goto resume;
+        if (load_accounts(rows, keys, selected, (int)first_record) == -1) {
+            // Leave the marker: the next start rolls the partial load back
+            fprintf(stderr, "CRITICAL: bulk load failed after %ld rows were selected\n", selected);
+            goto failed;
+        }
+        if (durable) {
+            storage_sync(STORAGE_ACCOUNT_PROFILES);
+            storage_sync(STORAGE_ACCOUNTS);
+            if (txn_log_sync() == -1) goto failed;
+            sync_path(TRANSACTION_INDEX_FILE);
+            remove_pending();
+        }
+    }
+    report->imported = selected;
+    rc = 0;
+
+resume:
+    if (wal_resume() == -1) fprintf(stderr, "import: checkpoint after the load failed\n");
+unlock:
+    if (table_locked) {
+        storage_unlock(STORAGE_ACCOUNTS, STORAGE_WHOLE_TABLE);
+    } else {
+        record_index_unlock(g_account_index);
+    }
+    free(keys);
+    free(rows);
+    report->load_seconds = seconds_since(&start) - report->parse_seconds;
+    return rc;
+
+failed:
+    // WAL operations stay refused until a restart rolls the load back
+    wal_abandon();
+    goto unlock;
+}
+
+/**
+ * @brief Renders the report as one line, with load throughput.
+ */
+void account_import_summary(const struct ImportReport* report, char* line, size_t len) {
+    double seconds = report->parse_seconds + report->load_seconds;
+    char invalid[48] = "";
+    if (report->invalid > 0) snprintf(invalid, sizeof(invalid), " (first at %ld)", report->first_invalid);
+    snprintf(line, len,
+             "Imported %ld of %ld rows: %ld duplicate, %ld invalid%s. "
+             "%.2f s (parse %.2f s, load %.2f s), %.0f rows/s, %.1f MB/s",
+             report->imported, report->rows, report->duplicates, report->invalid, invalid,
+             seconds, report->parse_seconds, report->load_seconds,
+             seconds > 0 ? report->rows / seconds : 0.0,
+             seconds > 0 ? report->bytes / seconds / 1e6 : 0.0);
+}
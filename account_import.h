@@ -0,0 +1,50 @@
+/*
+ * ========================================
+ * account_import.h
+ * =Description: Bulk loader for customer accounts,
+ * used by bank_tool (offline) and the admin menu
+ * (online). Reads a CSV or binary file, validates and
+ * de-duplicates it in one sorted pass, then appends the
+ * accounts, their OPENING_BALANCE log entries and their
+ * index entries in large batches.
+ * ========================================
+ */
+
+#ifndef ACCOUNT_IMPORT_H
+#define ACCOUNT_IMPORT_H
+
+#include <stddef.h>
+
+// --- Files ---
+#define IMPORT_PENDING_FILE "import.pending" // Exists while a load is not yet durable
+
+// --- Input Formats ---
+#define IMPORT_FORMAT_CSV 0    // account_id,name,pin,opening_balance[,active] per line
+#define IMPORT_FORMAT_BINARY 1 // struct CustomerAccount records (pre-format-3 accounts.dat)
+
+#define IMPORT_BATCH_ROWS 65536 // Accounts written per batch
+
+// --- Return Codes ---
+#define IMPORT_UNREADABLE -2 // account_import_file(): the input could not be read (errno is set)
+
+// Outcome of one load
+struct ImportReport {
+    long rows;              // Records read from the input
+    long imported;
+    long duplicates;        // Already in the bank, or repeated in the input (first one wins)
+    long invalid;
+    long first_invalid;     // Line (CSV) or record (binary) number of the first invalid row, 0 if none
+    long long bytes;        // Input size
+    double parse_seconds;   // Read, validate and de-duplicate
+    double load_seconds;    // Write accounts, log entries and indexes
+};
+
+// --- Loading ---
+int account_import_format(const char* path);
+int account_import_file(const char* path, int format, struct ImportReport* report);
+void account_import_summary(const struct ImportReport* report, char* line, size_t len);
+
+// --- Recovery (startup, before wal_recover()) ---
+int account_import_recover(void);
+
+#endif // ACCOUNT_IMPORT_H
@@ -0,0 +1,184 @@
+/*
+ * ========================================
+ * account_store.c
+ * =Description: Implementation of record-level access
+ * to accounts on top of the storage engine.
+ *
+ * An account is stored in two tables with the same
+ * record number: its AccountState (balance, status) in
+ * STORAGE_ACCOUNTS and its AccountProfile (name, PIN) in
+ * STORAGE_ACCOUNT_PROFILES. Balance operations use the
+ * *_state calls and never touch the profile table.
+ * Record locks are taken on STORAGE_ACCOUNTS and cover
+ * both parts.
+ * ========================================
+ */
+
+#include "account_store.h"
+#include "record_index.h"
+#include "btree.h"
+#include "storage.h"
+#include "wal.h"
+#include "utils.h"
+
+/**
+ * @brief Opens both account tables for this process. Safe to call
+ * repeatedly; creates the files on first run.
+ */
+int account_store_open(void) {
+    if (storage_open(STORAGE_ACCOUNT_PROFILES) == -1) return -1;
+    return storage_open(STORAGE_ACCOUNTS);
+}
+
+/**
+ * @brief Returns the record number for account_id, or -1 if not found.
+ */
+int account_store_find(int account_id) {
+    return find_customer_record(account_id);
+}
+
+/**
+ * @brief Copies the hot part of one account out of the store.
+ */
+int account_store_read_state(int record, struct AccountState* state) {
+    return storage_get(STORAGE_ACCOUNTS, record, state);
+}
+
+/**
+ * @brief Copies the hot part of one account without locking it. Never
+ * blocks a writer; see storage_snapshot().
+ */
+int account_store_snapshot_state(int record, struct AccountState* state) {
+    return storage_snapshot(STORAGE_ACCOUNTS, record, state);
+}
+
+/**
+ * @brief Overwrites the hot part of one account. Caller must hold its lock.
+ */
+int account_store_write_state(int record, const struct AccountState* state) {
+    return storage_put(STORAGE_ACCOUNTS, record, state);
+}
+
+/**
+ * @brief Copies the hot part of two accounts with one batched read.
+ */
+int account_store_read_state_pair(int record_a, struct AccountState* state_a,
+                                  int record_b, struct AccountState* state_b) {
+    struct StorageRead reads[2] = {
+        {STORAGE_ACCOUNTS, record_a, state_a},
+        {STORAGE_ACCOUNTS, record_b, state_b},
+    };
+    return storage_read_set(reads, 2);
+}
+
+/**
+ * @brief Copies one full account (both parts) out of the store with one
+ * batched read.
+ */
+int account_store_read(int record, struct CustomerAccount* account) {
+    struct AccountState state;
+    struct AccountProfile profile;
+    struct StorageRead reads[2] = {
+        {STORAGE_ACCOUNTS, record, &state},
+        {STORAGE_ACCOUNT_PROFILES, record, &profile},
+    };
+    if (storage_read_set(reads, 2) == -1) return -1;
+    join_account(&state, &profile, account);
+    return 0;
+}
+
+/**
+ * @brief Overwrites one full account in place with one batched write.
+ * Caller must hold its lock.
+ */
+int account_store_write(int record, const struct CustomerAccount* account) {
+    struct AccountState state;
+    struct AccountProfile profile;
+    split_account(account, &state, &profile);
+    struct StorageWrite writes[2] = {
+        {STORAGE_ACCOUNTS, record, &state, 0},
+        {STORAGE_ACCOUNT_PROFILES, record, &profile, 0},
+    };
+    return storage_write_set(writes, 2);
+}
+
+/**
+ * @brief Writes an account at or past the end of the tables. The profile
+ * goes first, so a record in the accounts table always has one.
+ */
+int account_store_extend(int record, const struct CustomerAccount* account) {
+    struct AccountState state;
+    struct AccountProfile profile;
+    split_account(account, &state, &profile);
+    if (storage_extend(STORAGE_ACCOUNT_PROFILES, record, &profile) == -1) return -1;
+    return storage_extend(STORAGE_ACCOUNTS, record, &state);
+}
+
+/**
+ * @brief Appends a new account unless its ID already exists. The append
+ * is committed through `wal`, which may already hold the caller's
+ * transaction log entries, so both land atomically.
+ * Creators are serialized by the account index's writer lock, so the
+ * duplicate check is an index (or Bloom filter) probe and existing
+ * records stay unlocked. Only without an index does this fall back to
+ * locking the table and scanning it.
+ * @return The new record number, ACCOUNT_STORE_DUPLICATE, or -1 on error.
+ */
+int account_store_create(const struct CustomerAccount* account, struct WalRecord* wal) {
+    if (account_store_open() == -1) return -1;
+
+    int table_locked = (g_account_index == NULL || record_index_lock(g_account_index) == -1);
+    if (table_locked) storage_lock(STORAGE_ACCOUNTS, STORAGE_WHOLE_TABLE, 1);
+
+    int result = -1;
+    long record = storage_count(STORAGE_ACCOUNTS);
+    if (find_customer_record(account->account_id) != -1) {
+        result = ACCOUNT_STORE_DUPLICATE;
+    } else if (record >= 0) {
+        if (wal_add_account(wal, (int)record, account, 1) == 0 && wal_commit(wal) == 0) {
+            result = (int)record;
+            if (g_account_index != NULL) {
+                record_index_insert(g_account_index, account->account_id, result);
+            }
+            btree_insert(g_account_btree, account->account_id, result);
+        }
+    }
+
+    if (table_locked) {
+        storage_unlock(STORAGE_ACCOUNTS, STORAGE_WHOLE_TABLE);
+    } else {
+        record_index_unlock(g_account_index);
+    }
+    return result;
+}
+
+// --- Record Locking ---
+
+/**
+ * @brief Locks one record (shared or exclusive; MMAP and MEMORY locks
+ * are always exclusive).
+ */
+int account_store_lock(int record, int exclusive) {
+    return storage_lock(STORAGE_ACCOUNTS, record, exclusive);
+}
+
+/**
+ * @brief Releases a lock taken with account_store_lock().
+ */
+void account_store_unlock(int record) {
+    storage_unlock(STORAGE_ACCOUNTS, record);
+}
+
+/**
+ * @brief Exclusively locks two records in a global order to avoid deadlock.
+ */
+int account_store_lock_pair(int record_a, int record_b) {
+    return storage_lock_pair(STORAGE_ACCOUNTS, record_a, record_b);
+}
+
+/**
+ * @brief Releases a lock taken with account_store_lock_pair().
+ */
+void account_store_unlock_pair(int record_a, int record_b) {
+    storage_unlock_pair(STORAGE_ACCOUNTS, record_a, record_b);
+}
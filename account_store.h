@@ -0,0 +1,42 @@
+/*
+ * ========================================
+ * account_store.h
+ * =Description: Record-level access to accounts,
+ * stored as hot state (accounts.dat) and cold profile
+ * (account_profiles.dat) records.
+ * A thin layer over the storage engine (storage.h).
+ * ========================================
+ */
+
+#ifndef ACCOUNT_STORE_H
+#define ACCOUNT_STORE_H
+
+#include "bank_storage.h"
+
+struct WalRecord;
+
+// --- Return Codes ---
+#define ACCOUNT_STORE_DUPLICATE -2 // account_store_create(): ID already exists
+
+// --- Store Lifecycle ---
+int account_store_open(void);
+
+// --- Record Access ---
+int account_store_find(int account_id);
+int account_store_read(int record, struct CustomerAccount* account);
+int account_store_write(int record, const struct CustomerAccount* account);
+int account_store_read_state(int record, struct AccountState* state);
+int account_store_snapshot_state(int record, struct AccountState* state);
+int account_store_read_state_pair(int record_a, struct AccountState* state_a,
+                                  int record_b, struct AccountState* state_b);
+int account_store_write_state(int record, const struct AccountState* state);
+int account_store_extend(int record, const struct CustomerAccount* account);
+int account_store_create(const struct CustomerAccount* account, struct WalRecord* wal);
+
+// --- Record Locking ---
+int account_store_lock(int record, int exclusive);
+void account_store_unlock(int record);
+int account_store_lock_pair(int record_a, int record_b);
+void account_store_unlock_pair(int record_a, int record_b);
+
+#endif // ACCOUNT_STORE_H
@@ -0,0 +1,341 @@
+/*
+ * ========================================
+ * bank_ops.c
+ * =Description: Implementation of the banking
+ * operations behind the menus and the binary protocol.
+ *
+ * Each money movement takes its record locks, writes
+ * balances, loan records and log entries as one WAL
+ * record, and releases the locks, so every front end
+ * gets the same atomicity and lock order.
+ * ========================================
+ */
+
+#include "bank_ops.h"
+#include "account_store.h"
+#include "storage.h"
+#include "loan_index.h"
+#include "wal.h"
+#include "utils.h"
+
+#include <string.h>
+
+// --- Customer Operations ---
+
+/**
+ * @brief Credits `amount` to the account.
+ * @return BANK_OK with the new balance in `*balance`, or a BANK_ error.
+ */
+int bank_deposit(int account_id, money_t amount, money_t* balance) {
+    struct AccountState account;
+    if (account_store_open() == -1) return BANK_DATABASE_ERROR;
+
+    int record = account_store_find(account_id);
+    if (record == -1) return BANK_NOT_FOUND;
+    if (account_store_lock(record, 1) == -1) return BANK_LOCK_FAILED;
+
+    struct WalRecord wal;
+    wal_begin(&wal);
+    account_store_read_state(record, &account);
+    account.balance += amount;
+    wal_add_account_state(&wal, record, &account);
+    wal_add_transaction(&wal, account_id, TXN_OP_DEPOSIT, amount, -1, account.balance);
+    int committed = wal_commit(&wal);
+    account_store_unlock(record);
+
+    if (committed == -1) return BANK_NOT_RECORDED;
+    *balance = account.balance;
+    return BANK_OK;
+}
+
+/**
+ * @brief Debits `amount` from the account if the balance covers it.
+ * @return BANK_OK with the new balance in `*balance`,
+ * BANK_INSUFFICIENT_FUNDS with the current one, or another BANK_ error.
+ */
+int bank_withdraw(int account_id, money_t amount, money_t* balance) {
+    struct AccountState account;
+    if (account_store_open() == -1) return BANK_DATABASE_ERROR;
+
+    int record = account_store_find(account_id);
+    if (record == -1) return BANK_NOT_FOUND;
+    if (account_store_lock(record, 1) == -1) return BANK_LOCK_FAILED;
+
+    account_store_read_state(record, &account);
+
+    int result = BANK_OK;
+    if (account.balance < amount) {
+        result = BANK_INSUFFICIENT_FUNDS;
+    } else {
+        struct WalRecord wal;
+        wal_begin(&wal);
+        account.balance -= amount;
+        wal_add_account_state(&wal, record, &account);
+        wal_add_transaction(&wal, account_id, TXN_OP_WITHDRAWAL, -amount, -1, account.balance);
+        if (wal_commit(&wal) == -1) result = BANK_NOT_RECORDED;
+    }
+    account_store_unlock(record);
+
+    if (result != BANK_NOT_RECORDED) *balance = account.balance;
+    return result;
+}
+
+/**
+ * @brief Moves `amount` between two accounts.
+ * @return BANK_OK with the source's new balance in `*balance`,
+ * BANK_INSUFFICIENT_FUNDS with its current one, or another BANK_ error.
+ */
+int bank_transfer(int source_account_id, int dest_account_id, money_t amount, money_t* balance) {
+    struct AccountState source_ac, dest_ac;
+    if (source_account_id == dest_account_id) return BANK_SAME_ACCOUNT;
+    if (account_store_open() == -1) return BANK_DATABASE_ERROR;
+
+    int record_src = account_store_find(source_account_id);
+    int record_dest = account_store_find(dest_account_id);
+    if (record_dest == -1) return BANK_DEST_NOT_FOUND;
+    if (record_src == -1) return BANK_NOT_FOUND;
+
+    if (account_store_lock_pair(record_src, record_dest) == -1) return BANK_LOCK_FAILED;
+
+    account_store_read_state_pair(record_src, &source_ac, record_dest, &dest_ac);
+
+    int result = BANK_OK;
+    if (source_ac.balance < amount) {
+        result = BANK_INSUFFICIENT_FUNDS;
+    } else if (dest_ac.is_active == 0) {
+        result = BANK_DEST_INACTIVE;
+    } else {
+        // Both balances and both log entries are one WAL record, so they land together
+        struct WalRecord wal;
+        wal_begin(&wal);
+        source_ac.balance -= amount; dest_ac.balance += amount;
+        wal_add_account_state(&wal, record_src, &source_ac);
+        wal_add_account_state(&wal, record_dest, &dest_ac);
+        wal_add_transaction(&wal, source_account_id, TXN_OP_TRANSFER_OUT, -amount, dest_account_id, source_ac.balance);
+        wal_add_transaction(&wal, dest_account_id, TXN_OP_TRANSFER_IN, amount, source_account_id, dest_ac.balance);
+        if (wal_commit(&wal) == -1) result = BANK_NOT_RECORDED;
+    }
+    account_store_unlock_pair(record_src, record_dest);
+
+    if (result == BANK_OK || result == BANK_INSUFFICIENT_FUNDS) *balance = source_ac.balance;
+    return result;
+}
+
+/**
+ * @brief Reads the balance without locking: balance polling never holds
+ * up a deposit.
+ */
+int bank_balance(int account_id, money_t* balance) {
+    struct AccountState account;
+    if (account_store_open() == -1) return BANK_DATABASE_ERROR;
+
+    int record = account_store_find(account_id);
+    if (record == -1) return BANK_NOT_FOUND;
+    if (account_store_snapshot_state(record, &account) == -1) return BANK_DATABASE_ERROR;
+
+    *balance = account.balance;
+    return BANK_OK;
+}
+
+/**
+ * @brief Files a new loan request (status 0) for the account.
+ * @return BANK_OK with the new loan's ID in `*loan_id`, or a BANK_ error.
+ */
+int bank_request_loan(int account_id, money_t amount, int* loan_id) {
+    struct LoanApplication loan;
+    memset(&loan, 0, sizeof(loan));
+    loan.loan_id = loan_index_allocate_id();
+    if (loan.loan_id == -1) return BANK_NO_LOAN_ID;
+    loan.customer_account_id = account_id;
+    loan.amount = amount;
+    loan.status = 0; // 0 = Requested
+    loan.assigned_to_employee_id = -1;
+
+    // Without the shared record counter, fall back to locking the table to append
+    int record = loan_index_reserve_record();
+    int table_locked = (record == -1);
+    if (table_locked) {
+        long count = (storage_lock(STORAGE_LOANS, STORAGE_WHOLE_TABLE, 1) == -1) ? -1 : storage_count(STORAGE_LOANS);
+        if (count == -1) {
+            storage_unlock(STORAGE_LOANS, STORAGE_WHOLE_TABLE);
+            return BANK_DATABASE_ERROR;
+        }
+        record = (int)count;
+    }
+
+    // No lock held here, so concurrent requests share one group commit
+    struct WalRecord wal;
+    wal_begin(&wal);
+    wal_add_loan(&wal, record, &loan, 1);
+    int committed = wal_commit(&wal);
+    if (committed == 0) {
+        loan_index_add(loan.loan_id, record, loan.status, loan.assigned_to_employee_id);
+    }
+    if (table_locked) storage_unlock(STORAGE_LOANS, STORAGE_WHOLE_TABLE);
+
+    if (committed == -1) return BANK_DATABASE_ERROR;
+    *loan_id = loan.loan_id;
+    return BANK_OK;
+}
+
+// --- Loan Work Queues ---
+
+// Collects loans of one status for bank_list_loans()
+struct LoanFilter {
+    int status;
+    int employee_id; // Only checked for status 1 (Assigned)
+    struct LoanApplication* loans;
+    int max_loans;
+    int found;
+};
+
+static int collect_loan(int record, const void* data, void* ctx) {
+    const struct LoanApplication* loan = data;
+    struct LoanFilter* filter = ctx;
+    if (loan->loan_id == 0 || loan->status != filter->status) return 0;
+    if (filter->status == 1 && loan->assigned_to_employee_id != filter->employee_id) return 0;
+    filter->loans[filter->found++] = *loan;
+    return (filter->found == filter->max_loans); // Full: stop the scan
+}
+
+/**
+ * @brief Lists up to `max_loans` loans of one work queue (see
+ * loan_index.h): status 0 (Requested), or status 1 (Assigned) to
+ * `employee_id`. Each queued record is re-checked, because a queue
+ * snapshot can be overtaken by a concurrent assign or approval. Without
+ * the queues, the whole table is scanned under a shared table lock.
+ * @return Number of loans stored in `loans`, or BANK_DATABASE_ERROR.
+ */
+int bank_list_loans(int status, int employee_id, struct LoanApplication* loans, int max_loans) {
+    struct LoanFilter filter = {status, employee_id, loans, max_loans, 0};
+    if (max_loans <= 0) return 0;
+    if (storage_open(STORAGE_LOANS) == -1) return BANK_DATABASE_ERROR;
+
+    int records[max_loans];
+    int count = (status == 0) ? loan_index_list_unassigned(records, max_loans)
+                              : loan_index_list_assigned(employee_id, records, max_loans);
+    if (count >= 0) {
+        struct LoanApplication loan;
+        for (int i = 0; i < count; i++) {
+            if (storage_get(STORAGE_LOANS, records[i], &loan) == -1) continue;
+            collect_loan(records[i], &loan, &filter);
+        }
+        return filter.found;
+    }
+
+    // Queues unavailable: fall back to scanning the whole table
+    if (storage_lock(STORAGE_LOANS, STORAGE_WHOLE_TABLE, 0) == -1) return BANK_DATABASE_ERROR;
+    int rc = storage_scan(STORAGE_LOANS, collect_loan, &filter);
+    storage_unlock(STORAGE_LOANS, STORAGE_WHOLE_TABLE);
+    return (rc == -1) ? BANK_DATABASE_ERROR : filter.found;
+}
+
+/**
+ * @brief Checks that a loan is assigned to `employee_id` and pending
+ * (status 1), without locking it.
+ * @return BANK_OK with the loan's and its account's record numbers, or a
+ * BANK_ error.
+ */
+int bank_find_pending_loan(int employee_id, int loan_id, int* record_loan, int* record_acct) {
+    struct LoanApplication loan;
+    if (storage_open(STORAGE_LOANS) == -1 || account_store_open() == -1) return BANK_DATABASE_ERROR;
+
+    *record_loan = find_loan_record(loan_id);
+    if (*record_loan == -1 || storage_get(STORAGE_LOANS, *record_loan, &loan) == -1) return BANK_NOT_FOUND;
+    if (loan.assigned_to_employee_id != employee_id) return BANK_NOT_ASSIGNED;
+    if (loan.status != 1) return BANK_NOT_PENDING; // 1 = Assigned/Pending
+
+    *record_acct = account_store_find(loan.customer_account_id);
+    if (*record_acct == -1) return BANK_ACCOUNT_MISSING;
+    return BANK_OK;
+}
+
+/**
+ * @brief Approves (credits the account) or rejects a pending loan. The
+ * caller holds the loan record's lock and has re-read `loan`, whose
+ * status is updated.
+ * @return BANK_OK, BANK_LOCK_FAILED or BANK_NOT_RECORDED.
+ */
+int bank_decide_loan(int record_loan, int record_acct, struct LoanApplication* loan, int approve) {
+    struct WalRecord wal;
+    wal_begin(&wal);
+
+    int committed;
+    if (approve) {
+        // The account lock is only held for the update itself, never across a prompt.
+        // Credit, loan status and log entry are one WAL record.
+        struct AccountState state;
+        if (account_store_lock(record_acct, 1) == -1) return BANK_LOCK_FAILED;
+        account_store_read_state(record_acct, &state);
+        state.balance += loan->amount;
+        loan->status = 2; // Approved
+        wal_add_account_state(&wal, record_acct, &state);
+        wal_add_loan(&wal, record_loan, loan, 0);
+        wal_add_transaction(&wal, state.account_id, TXN_OP_LOAN_APPROVED, loan->amount, -1, state.balance);
+        committed = wal_commit(&wal);
+        account_store_unlock(record_acct);
+    } else {
+        loan->status = 3; // Rejected
+        wal_add_loan(&wal, record_loan, loan, 0);
+        committed = wal_commit(&wal);
+    }
+
+    if (committed == -1) {
+        loan->status = 1;
+        return BANK_NOT_RECORDED;
+    }
+    loan_index_update(record_loan, loan->status, loan->assigned_to_employee_id);
+    return BANK_OK;
+}
+
+/**
+ * @brief Approves or rejects a loan assigned to `employee_id` in one
+ * step (no prompt between the checks and the decision).
+ */
+int bank_process_loan(int employee_id, int loan_id, int approve) {
+    struct LoanApplication loan;
+    int record_loan, record_acct;
+    int result = bank_find_pending_loan(employee_id, loan_id, &record_loan, &record_acct);
+    if (result != BANK_OK) return result;
+
+    if (storage_lock(STORAGE_LOANS, record_loan, 1) == -1) return BANK_LOCK_FAILED;
+    if (storage_get(STORAGE_LOANS, record_loan, &loan) == -1 || loan.status != 1) {
+        result = BANK_NOT_PENDING;
+    } else {
+        result = bank_decide_loan(record_loan, record_acct, &loan, approve);
+    }
+    storage_unlock(STORAGE_LOANS, record_loan);
+    return result;
+}
+
+/**
+ * @brief Assigns a requested (status 0) loan to an employee.
+ * @return BANK_OK, BANK_NOT_FOUND, BANK_LOCK_FAILED, BANK_NOT_PENDING if
+ * it was already assigned or processed, or BANK_NOT_RECORDED.
+ */
+int bank_assign_loan(int loan_id, int employee_id) {
+    struct LoanApplication loan;
+    if (storage_open(STORAGE_LOANS) == -1) return BANK_DATABASE_ERROR;
+
+    int record = find_loan_record(loan_id);
+    if (record == -1) return BANK_NOT_FOUND;
+
+    if (storage_lock(STORAGE_LOANS, record, 1) == -1) return BANK_LOCK_FAILED;
+
+    int result = BANK_OK;
+    if (storage_get(STORAGE_LOANS, record, &loan) == -1 || loan.status != 0) {
+        result = BANK_NOT_PENDING;
+    } else {
+        loan.status = 1; // 1 = Assigned
+        loan.assigned_to_employee_id = employee_id;
+
+        struct WalRecord wal;
+        wal_begin(&wal);
+        wal_add_loan(&wal, record, &loan, 0);
+        if (wal_commit(&wal) == 0) loan_index_update(record, loan.status, employee_id);
+        else result = BANK_NOT_RECORDED;
+    }
+
+    storage_unlock(STORAGE_LOANS, record);
+    return result;
+}
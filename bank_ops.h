@@ -0,0 +1,49 @@
+/*
+ * ========================================
+ * bank_ops.h
+ * =Description: Banking operations with typed
+ * arguments and result codes, shared by the text
+ * menus (server_logic.c) and the binary protocol
+ * (binary_protocol.c).
+ * - No prompts and no socket I/O: the caller collects
+ *   the arguments and turns the result into a response
+ * - Amounts must already be validated as positive and
+ *   at most MONEY_MAX_INPUT (see utils.h)
+ * ========================================
+ */
+
+#ifndef BANK_OPS_H
+#define BANK_OPS_H
+
+#include "bank_storage.h"
+
+// --- Result Codes ---
+#define BANK_OK 0
+#define BANK_DATABASE_ERROR -1    // A table could not be opened or read
+#define BANK_NOT_FOUND -2         // Account (or loan) not found
+#define BANK_DEST_NOT_FOUND -3    // Transfer destination not found
+#define BANK_SAME_ACCOUNT -4
+#define BANK_LOCK_FAILED -5
+#define BANK_INSUFFICIENT_FUNDS -6
+#define BANK_DEST_INACTIVE -7
+#define BANK_NOT_RECORDED -8      // The WAL commit failed; nothing changed
+#define BANK_NO_LOAN_ID -9        // The loan ID counter failed
+#define BANK_NOT_ASSIGNED -10     // The loan is assigned to another employee
+#define BANK_NOT_PENDING -11      // The loan's status does not allow the action
+#define BANK_ACCOUNT_MISSING -12  // The loan's customer account is gone
+
+// --- Customer Operations ---
+int bank_deposit(int account_id, money_t amount, money_t* balance);
+int bank_withdraw(int account_id, money_t amount, money_t* balance);
+int bank_transfer(int source_account_id, int dest_account_id, money_t amount, money_t* balance);
+int bank_balance(int account_id, money_t* balance);
+int bank_request_loan(int account_id, money_t amount, int* loan_id);
+
+// --- Loan Work Queues ---
+int bank_list_loans(int status, int employee_id, struct LoanApplication* loans, int max_loans);
+int bank_find_pending_loan(int employee_id, int loan_id, int* record_loan, int* record_acct);
+int bank_decide_loan(int record_loan, int record_acct, struct LoanApplication* loan, int approve);
+int bank_process_loan(int employee_id, int loan_id, int approve);
+int bank_assign_loan(int loan_id, int employee_id);
+
+#endif // BANK_OPS_H
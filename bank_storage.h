@@ -10,25 +10,56 @@
 #define BANK_STORAGE_H
 
 // --- Constants ---
-#define ACCOUNT_DB_FILE "accounts.dat"
+#define ACCOUNT_DB_FILE "accounts.dat"            // Hot account state (struct AccountState)
+#define ACCOUNT_PROFILE_FILE "account_profiles.dat" // Cold account fields (struct AccountProfile)
 #define STAFF_DB_FILE "staff.dat"
+#define ACCOUNT_BTREE_FILE "accounts.btree"       // B+tree over accounts.dat, rebuilt if stale
+#define STAFF_BTREE_FILE "staff.btree"
 #define LOAN_DB_FILE "loans.dat"
-#define TRANSACTION_DB_FILE "transactions.dat"
+#define TRANSACTION_LOG_DIR "txnlog"            // Segmented transaction log
+#define TRANSACTION_DB_FILE "transactions.dat"    // Legacy single-file log, migrated on startup
+#define TRANSACTION_INDEX_FILE "transactions.idx"
+#define TRANSACTION_TIME_INDEX_FILE "transactions.tidx" // Sparse time index over the log
 #define FEEDBACK_DB_FILE "feedback.dat"
 #define LOAN_COUNTER_FILE "loan_id.dat"
 #define ADMIN_PASS_FILE "admin_auth.dat"
+#define DATA_FORMAT_FILE "data_format.dat"      // Format version of accounts.dat and loans.dat
+#define DATA_FORMAT_VERSION 3                    // 2: money stored as money_t cents
+                                                 // 3: accounts split into hot and cold files
+
+// --- Money ---
+// Amounts are fixed-point int64 minor units: 12.34 is stored as 1234
+typedef long long money_t;
+#define MONEY_SCALE 100
 
 // --- Data Structures ---
 
-// Represents a single customer account record
+// Represents a single customer account (as handled in memory and in
+// WAL images; also the accounts.dat record layout before format 3)
 struct CustomerAccount {
     int account_id;
     char owner_name[50];
     char access_pin[20];
-    double balance;
+    money_t balance;
     int is_active; // 1 for active, 0 for inactive
 };
 
+// Hot part of an account: one accounts.dat record. 16 bytes, so four
+// records share each 64-byte cache line and none straddles two.
+struct AccountState {
+    int account_id;
+    int is_active;
+    money_t balance;
+};
+
+// Cold part of an account: the account_profiles.dat record with the
+// same record number. Only read at login and by profile edits.
+struct AccountProfile {
+    int account_id;
+    char owner_name[50];
+    char access_pin[20];
+};
+
 // Represents a single staff member (Employee or Manager)
 struct EmployeeRecord {
     int employee_id;
@@ -42,19 +73,73 @@ struct EmployeeRecord {
 struct LoanApplication {
     int loan_id;
     int customer_account_id; // Links to CustomerAccount
-    double amount;
+    money_t amount;
     int status; // 0=Requested, 1=Assigned, 2=Approved, 3=Rejected
     int assigned_to_employee_id; // Links to EmployeeRecord
 };
 
-// For storing transaction history
+// Operation recorded by a Transaction (stored in Transaction.op)
+enum TransactionOp {
+    TXN_OP_UNKNOWN = 0,
+    TXN_OP_DEPOSIT,
+    TXN_OP_WITHDRAWAL,
+    TXN_OP_TRANSFER_OUT,
+    TXN_OP_TRANSFER_IN,
+    TXN_OP_OPENING_BALANCE,
+    TXN_OP_LOAN_APPROVED
+};
+
+// For storing transaction history (format v2, 40 bytes)
 struct Transaction {
+    int account_id;
+    int counterparty_id;          // Other account of a transfer, -1 if none
+    int op;                       // enum TransactionOp
+    int reserved;
+    long long timestamp_us;       // Microseconds since the epoch
+    money_t amount;               // Signed change to the balance
+    money_t resulting_balance;
+};
+
+// Format v1 transaction record (144 bytes), only read by the log converter
+struct TransactionV1 {
     int account_id;
     char timestamp[30];
-    char description[100]; // e.g., "DEPOSIT +500.00"
+    char description[100]; // e.g., "DEPOSIT: +500.00"
     double resulting_balance;
 };
 
+// Sidecar entry for transactions.idx: one per Transaction record (same
+// record number), chaining each account's entries newest -> oldest
+struct TransactionIndexEntry {
+    int account_id;
+    int prev_record; // Previous record for the same account, -1 if none
+};
+
+// Entry of transactions.tidx: one per block of TXN_TIME_BLOCK log
+// records, in log order. Both bounds only grow from block to block, so
+// a time range maps to a run of blocks found by binary search.
+struct TransactionTimeEntry {
+    long long ceiling_us; // Latest timestamp in this block or any earlier one
+    long long floor_us;   // Earliest timestamp in this block or any later one
+};
+
+// Header at the start of every transaction log segment
+// (txnlog/seg_NNNNNN.dat); Transaction records follow it
+struct TxnSegmentHeader {
+    unsigned int magic;
+    int version;
+    int segment;              // Segment number, also in the file name
+    int sealed;               // 1 once full; a sealed segment is never written again
+    long long first_record;   // Global record number of the first record
+    int record_count;
+    int min_account_id;       // Account range present (only meaningful if record_count > 0)
+    int max_account_id;
+    int reserved0;
+    long long first_time;     // Epoch seconds the first/last batch was written
+    long long last_time;      // (first_time is 0 for migrated records)
+    int reserved[2];
+};
+
 // For storing user feedback
 struct FeedbackEntry {
     char feedback_text[256];
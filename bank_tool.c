@@ -0,0 +1,214 @@
+/*
+ * ========================================
+ * bank_tool.c
+ * =Description: Offline maintenance tool for the
+ * Banking Management System's data files.
+ * - convert-log: rewrites a legacy transactions.dat
+ *   and any version-1 log segments in the compact
+ *   v2 record format (the server also does this on
+ *   start; the tool lets it run ahead of time)
+ * - totals: bank-wide deposit and loan totals
+ * - import: bulk-loads customer accounts from a CSV
+ *   or binary file and reports the load throughput
+ * - transactions: lists the log entries made between
+ *   two dates, for one account or all of them
+ * Run convert-log and import only while the server is
+ * stopped.
+ *
+ * =Compile command:
+ * gcc bank_tool.c utils.c storage.c record_index.c btree.c account_store.c account_import.c txn_log.c txn_index.c loan_index.c journal.c wal.c ledger.c uring.c txn_time_index.c -o bank_tool -pthread
+ *
+ * =Usage:
+ * ./bank_tool convert-log|totals [DATA_DIR]
+ * ./bank_tool import FILE [DATA_DIR]
+ * ./bank_tool transactions FROM TO ACCOUNT_ID|all [DATA_DIR]
+ * ========================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+
+#include "bank_storage.h"
+#include "txn_log.h"
+#include "ledger.h"
+#include "txn_index.h"
+#include "txn_time_index.h"
+#include "wal.h"
+#include "account_import.h"
+#include "utils.h"
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s convert-log|totals [DATA_DIR]\n"
+                    "       %s import FILE [DATA_DIR]\n"
+                    "       %s transactions FROM TO ACCOUNT_ID|all [DATA_DIR]\n"
+                    "FROM and TO are YYYY-MM-DD[ HH:MM[:SS]] (local time, inclusive)\n", program, program, program);
+}
+
+/**
+ * @brief Converts the transaction log in the current directory to v2.
+ */
+static int convert_log(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long converted = txn_log_upgrade();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (converted == -1) {
+        perror("convert-log failed");
+        return 1;
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (converted == 0) {
+        printf("%s/ is already in record format v2\n", TRANSACTION_LOG_DIR);
+        return 0;
+    }
+    printf("Converted %ld records to format v2 in %.2f s (%.0f records/s), %zu -> %zu bytes each\n",
+           converted, seconds, seconds > 0 ? converted / seconds : 0.0,
+           sizeof(struct TransactionV1), sizeof(struct Transaction));
+    return 0;
+}
+
+/**
+ * @brief Prints deposit and loan totals for the current directory.
+ */
+static int print_totals(void) {
+    if (ledger_data_format() != DATA_FORMAT_VERSION) {
+        fprintf(stderr, "%s and %s are in an older format; start the server once to upgrade them\n",
+                ACCOUNT_DB_FILE, LOAN_DB_FILE);
+        return 1;
+    }
+
+    struct timespec start, end;
+    struct LedgerTotals totals;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = ledger_compute_totals(&totals);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (rc == -1) {
+        perror("totals failed");
+        return 1;
+    }
+
+    static const char* const status_names[LEDGER_LOAN_STATUSES] = {"Requested", "Assigned", "Approved", "Rejected"};
+    printf("Deposits:          " MONEY_FMT " across %ld accounts\n", MONEY_ARGS(totals.total_deposits), totals.accounts);
+    printf("Loans outstanding: " MONEY_FMT "\n", MONEY_ARGS(totals.loans_outstanding));
+    for (int s = 0; s < LEDGER_LOAN_STATUSES; s++) {
+        printf("  %-10s %8ld  " MONEY_FMT "\n", status_names[s], totals.loan_count[s], MONEY_ARGS(totals.loan_total[s]));
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Scanned %ld records in %.3f ms (%s kernel)\n", totals.accounts + totals.loans, seconds * 1e3,
+           ledger_kernel_name());
+    return 0;
+}
+
+/**
+ * @brief Brings the data files to a consistent state, exactly as server
+ * startup does, and opens the log indexes.
+ */
+static int recover_data_files(const char* command) {
+    if (txn_log_init() == -1 || account_import_recover() == -1 || wal_recover() == -1 ||
+        ledger_upgrade_data_files() == -1) {
+        fprintf(stderr, "%s: the data files could not be recovered; start the server once and retry\n", command);
+        return -1;
+    }
+    txn_index_init();
+    txn_time_index_init();
+    return 0;
+}
+
+static int print_transaction(const struct Transaction* entry, void* ctx) {
+    (void)ctx;
+    char line[200];
+    format_transaction(entry, line, sizeof(line));
+    printf("Acct %-8d %s\n", entry->account_id, line);
+    return 0;
+}
+
+/**
+ * @brief Prints the log entries made between two dates, oldest first.
+ */
+static int list_transactions(const char* from, const char* to, const char* account) {
+    long long from_us, to_us;
+    if (parse_time_bound(from, 0, &from_us) == -1 || parse_time_bound(to, 1, &to_us) == -1 || from_us > to_us) {
+        fprintf(stderr, "transactions: invalid date range '%s' to '%s'\n", from, to);
+        return 2;
+    }
+    int account_id = (strcmp(account, "all") == 0) ? TXN_ALL_ACCOUNTS : atoi(account);
+    if (account_id != TXN_ALL_ACCOUNTS && account_id <= 0) {
+        fprintf(stderr, "transactions: invalid account '%s'\n", account);
+        return 2;
+    }
+    if (recover_data_files("transactions") == -1) return 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int found = txn_time_index_scan(account_id, from_us, to_us, print_transaction, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (found == -1) {
+        perror("transactions failed");
+        return 1;
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%d transaction(s) of %ld in the log, %.3f ms\n", found, txn_log_record_count(), seconds * 1e3);
+    return 0;
+}
+
+/**
+ * @brief Bulk-loads accounts into the current directory.
+ */
+static int import_accounts(const char* path) {
+    if (recover_data_files("import") == -1) return 1;
+
+    struct ImportReport report;
+    int rc = account_import_file(path, account_import_format(path), &report);
+    if (rc == IMPORT_UNREADABLE) {
+        perror(path);
+        return 1;
+    }
+    if (rc == -1) {
+        fprintf(stderr, "import failed; the partial load is rolled back on the next start\n");
+        return 1;
+    }
+
+    char summary[256];
+    account_import_summary(&report, summary, sizeof(summary));
+    printf("%s\n", summary);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 5 && strcmp(argv[1], "transactions") == 0) {
+        if (argc > 6) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (argc == 6 && chdir(argv[5]) == -1) {
+            perror(argv[5]);
+            return 1;
+        }
+        return list_transactions(argv[2], argv[3], argv[4]);
+    }
+
+    int import = (argc >= 3 && strcmp(argv[1], "import") == 0);
+    if (argc < 2 || argc > 3 + import ||
+        (!import && strcmp(argv[1], "convert-log") != 0 && strcmp(argv[1], "totals") != 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // The input is named relative to where the tool was started
+    char input[PATH_MAX];
+    if (import && realpath(argv[2], input) == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    if (argc == 3 + import && chdir(argv[2 + import]) == -1) {
+        perror(argv[2 + import]);
+        return 1;
+    }
+    if (import) return import_accounts(input);
+    return (strcmp(argv[1], "totals") == 0) ? print_totals() : convert_log();
+}
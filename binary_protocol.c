@@ -0,0 +1,381 @@
+/*
+ * ========================================
+ * binary_protocol.c
+ * =Description: Implementation of the binary
+ * protocol (see binary_protocol.h for the wire
+ * format).
+ *
+ * Requests are read through the session's input ring
+ * and responses are queued with queue_output(), so a
+ * burst of pipelined requests costs one read() and
+ * its responses go out in one write() when the session
+ * next waits for input. The operations themselves are
+ * the ones behind the text menus (bank_ops.h).
+ * ========================================
+ */
+
+#include "binary_protocol.h"
+#include "bank_ops.h"
+#include "server_logic.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <semaphore.h>
+
+#define ROLE_NONE 0
+#define ROLE_CUSTOMER 1
+#define ROLE_EMPLOYEE 2
+#define ROLE_MANAGER 3
+
+#define SECRET_MAX 49 // Longest PIN or password the records hold
+
+// State of one binary connection
+struct BinarySession {
+    int socket_fd;
+    int role;       // ROLE_NONE until a login succeeds
+    int user_id;    // Account or employee ID
+    sem_t* session_sem;
+};
+
+// A request body being decoded, or a response body being built
+struct Frame {
+    unsigned char* data;
+    unsigned int len;  // Bytes decoded so far / bytes written
+    unsigned int size; // Body length / capacity
+    int bad;           // A field ran past the end
+};
+
+// --- Little-Endian Encoding ---
+
+static void put_u16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned long v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static unsigned int get_u16(const unsigned char* p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static unsigned long get_u32(const unsigned char* p) {
+    unsigned long v = 0;
+    for (int i = 0; i < 4; i++) v |= (unsigned long)p[i] << (8 * i);
+    return v;
+}
+
+static const unsigned char* take_field(struct Frame* frame, unsigned int len) {
+    if (frame->bad || frame->size - frame->len < len) {
+        frame->bad = 1;
+        return NULL;
+    }
+    frame->len += len;
+    return frame->data + frame->len - len;
+}
+
+static unsigned int take_u16(struct Frame* frame) {
+    const unsigned char* p = take_field(frame, 2);
+    return (p != NULL) ? get_u16(p) : 0;
+}
+
+static int take_i32(struct Frame* frame) {
+    const unsigned char* p = take_field(frame, 4);
+    return (p != NULL) ? (int)(unsigned int)get_u32(p) : 0;
+}
+
+static long long take_i64(struct Frame* frame) {
+    const unsigned char* p = take_field(frame, 8);
+    if (p == NULL) return 0;
+    return (long long)((unsigned long long)get_u32(p) | ((unsigned long long)get_u32(p + 4) << 32));
+}
+
+static unsigned char* add_field(struct Frame* frame, unsigned int len) {
+    if (frame->bad || frame->size - frame->len < len) {
+        frame->bad = 1;
+        return NULL;
+    }
+    frame->len += len;
+    return frame->data + frame->len - len;
+}
+
+static void add_u16(struct Frame* frame, unsigned int v) {
+    unsigned char* p = add_field(frame, 2);
+    if (p != NULL) put_u16(p, v);
+}
+
+static void add_i32(struct Frame* frame, int v) {
+    unsigned char* p = add_field(frame, 4);
+    if (p != NULL) put_u32(p, (unsigned long)(unsigned int)v);
+}
+
+static void add_i64(struct Frame* frame, long long v) {
+    unsigned char* p = add_field(frame, 8);
+    if (p == NULL) return;
+    put_u32(p, (unsigned long)((unsigned long long)v & 0xFFFFFFFFUL));
+    put_u32(p + 4, (unsigned long)((unsigned long long)v >> 32));
+}
+
+/**
+ * @brief True if the whole request body was decoded, no more and no less.
+ */
+static int body_complete(const struct Frame* frame) {
+    return !frame->bad && frame->len == frame->size;
+}
+
+static int valid_amount(money_t amount) {
+    return amount > 0 && amount <= MONEY_MAX_INPUT;
+}
+
+// --- Status Mapping ---
+
+static int status_of(int result) {
+    switch (result) {
+        case BANK_OK: return BINARY_OK;
+        case BANK_NOT_FOUND: return BINARY_NOT_FOUND;
+        case BANK_DEST_NOT_FOUND: return BINARY_DEST_NOT_FOUND;
+        case BANK_SAME_ACCOUNT: return BINARY_SAME_ACCOUNT;
+        case BANK_LOCK_FAILED: return BINARY_LOCK_FAILED;
+        case BANK_INSUFFICIENT_FUNDS: return BINARY_INSUFFICIENT_FUNDS;
+        case BANK_DEST_INACTIVE: return BINARY_DEST_INACTIVE;
+        case BANK_NOT_ASSIGNED: return BINARY_NOT_ASSIGNED;
+        case BANK_NOT_PENDING: return BINARY_NOT_PENDING;
+        default: return BINARY_SERVER_ERROR;
+    }
+}
+
+// --- Login ---
+
+/**
+ * @brief Takes the account's (or employee's) session lock and checks the
+ * secret, as the text login does.
+ */
+static int binary_login(struct BinarySession* session, int role, int id, const char* secret) {
+    sem_t* sem;
+    if (session->role != ROLE_NONE) return BINARY_ALREADY_LOGGED_IN;
+    if (id <= 0) return BINARY_LOGIN_FAILED;
+
+    int locked = acquire_session_lock(id, &sem);
+    if (locked != 0) return (locked == 1) ? BINARY_ALREADY_LOGGED_IN : BINARY_SERVER_ERROR;
+
+    int ok = (role == ROLE_CUSTOMER) ? login_customer(session->socket_fd, id, secret)
+                                     : login_staff(session->socket_fd, id, secret, (role == ROLE_EMPLOYEE) ? 1 : 0);
+    if (!ok) {
+        release_session_lock(id, sem);
+        return BINARY_LOGIN_FAILED;
+    }
+    session->role = role;
+    session->user_id = id;
+    session->session_sem = sem;
+    watch_session_disconnect();
+    return BINARY_OK;
+}
+
+static void binary_logout(struct BinarySession* session) {
+    if (session->role == ROLE_NONE) return;
+    release_session_lock(session->user_id, session->session_sem);
+    session->role = ROLE_NONE;
+    session->user_id = -1;
+    session->session_sem = NULL;
+}
+
+// --- Requests ---
+
+static int history_response(int account_id, unsigned int max_entries, struct Frame* out) {
+    struct Transaction entries[BINARY_LIST_MAX]; // Newest first
+    if (max_entries > BINARY_LIST_MAX) max_entries = BINARY_LIST_MAX;
+
+    int count = storage_recent_transactions(account_id, entries, (int)max_entries);
+    if (count == -1) return BINARY_SERVER_ERROR;
+
+    add_u16(out, (unsigned int)count);
+    for (int i = 0; i < count; i++) {
+        add_i64(out, entries[i].timestamp_us);
+        add_i32(out, entries[i].op);
+        add_i32(out, entries[i].counterparty_id);
+        add_i64(out, entries[i].amount);
+        add_i64(out, entries[i].resulting_balance);
+    }
+    return BINARY_OK;
+}
+
+static int loan_list_response(int status, int employee_id, struct Frame* out) {
+    struct LoanApplication loans[BINARY_LIST_MAX];
+    int count = bank_list_loans(status, employee_id, loans, BINARY_LIST_MAX);
+    if (count < 0) return BINARY_SERVER_ERROR;
+
+    add_u16(out, (unsigned int)count);
+    for (int i = 0; i < count; i++) {
+        add_i32(out, loans[i].loan_id);
+        add_i32(out, loans[i].customer_account_id);
+        add_i64(out, loans[i].amount);
+    }
+    return BINARY_OK;
+}
+
+/**
+ * @brief Decodes one request body, runs it, and writes the response body.
+ * @return The response status.
+ */
+static int dispatch(struct BinarySession* session, unsigned int opcode, struct Frame* in, struct Frame* out) {
+    int role = session->role, id = session->user_id;
+    money_t amount, balance;
+    int result;
+
+    switch (opcode) {
+        case BINARY_OP_PING:
+            return body_complete(in) ? BINARY_OK : BINARY_BAD_REQUEST;
+
+        case BINARY_OP_LOGIN_CUSTOMER:
+        case BINARY_OP_LOGIN_EMPLOYEE:
+        case BINARY_OP_LOGIN_MANAGER: {
+            char secret[SECRET_MAX + 1];
+            int user_id = take_i32(in);
+            unsigned int secret_len = in->size - in->len;
+            if (in->bad || secret_len > SECRET_MAX) return BINARY_BAD_REQUEST;
+            memcpy(secret, take_field(in, secret_len), secret_len);
+            secret[secret_len] = '\0';
+            if (memchr(secret, '\0', secret_len) != NULL) return BINARY_BAD_REQUEST;
+            int login_role = (opcode == BINARY_OP_LOGIN_CUSTOMER) ? ROLE_CUSTOMER
+                           : (opcode == BINARY_OP_LOGIN_EMPLOYEE) ? ROLE_EMPLOYEE : ROLE_MANAGER;
+            return binary_login(session, login_role, user_id, secret);
+        }
+
+        case BINARY_OP_LOGOUT:
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            if (role == ROLE_NONE) return BINARY_NOT_AUTHORIZED;
+            binary_logout(session);
+            return BINARY_OK;
+
+        case BINARY_OP_DEPOSIT:
+        case BINARY_OP_WITHDRAW:
+            amount = take_i64(in);
+            if (role != ROLE_CUSTOMER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in) || !valid_amount(amount)) return BINARY_BAD_REQUEST;
+            result = (opcode == BINARY_OP_DEPOSIT) ? bank_deposit(id, amount, &balance)
+                                                   : bank_withdraw(id, amount, &balance);
+            if (result == BANK_OK || result == BANK_INSUFFICIENT_FUNDS) add_i64(out, balance);
+            return status_of(result);
+
+        case BINARY_OP_TRANSFER: {
+            int dest_account_id = take_i32(in);
+            amount = take_i64(in);
+            if (role != ROLE_CUSTOMER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in) || !valid_amount(amount)) return BINARY_BAD_REQUEST;
+            result = bank_transfer(id, dest_account_id, amount, &balance);
+            if (result == BANK_OK || result == BANK_INSUFFICIENT_FUNDS) add_i64(out, balance);
+            return status_of(result);
+        }
+
+        case BINARY_OP_BALANCE:
+            if (role != ROLE_CUSTOMER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            result = bank_balance(id, &balance);
+            if (result == BANK_OK) add_i64(out, balance);
+            return status_of(result);
+
+        case BINARY_OP_HISTORY: {
+            int account_id = take_i32(in);
+            unsigned int max_entries = take_u16(in);
+            if (role != ROLE_CUSTOMER && role != ROLE_EMPLOYEE) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            if (role == ROLE_CUSTOMER) {
+                if (account_id != 0 && account_id != id) return BINARY_NOT_AUTHORIZED;
+                account_id = id;
+            }
+            return history_response(account_id, max_entries, out);
+        }
+
+        case BINARY_OP_LOAN_REQUEST: {
+            int loan_id;
+            amount = take_i64(in);
+            if (role != ROLE_CUSTOMER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in) || !valid_amount(amount)) return BINARY_BAD_REQUEST;
+            result = bank_request_loan(id, amount, &loan_id);
+            if (result == BANK_OK) add_i32(out, loan_id);
+            return status_of(result);
+        }
+
+        case BINARY_OP_LOAN_LIST_ASSIGNED:
+            if (role != ROLE_EMPLOYEE) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            return loan_list_response(1, id, out); // 1 = Assigned
+
+        case BINARY_OP_LOAN_DECIDE: {
+            int loan_id = take_i32(in);
+            const unsigned char* approve = take_field(in, 1);
+            if (role != ROLE_EMPLOYEE) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in) || *approve > 1) return BINARY_BAD_REQUEST;
+            return status_of(bank_process_loan(id, loan_id, *approve));
+        }
+
+        case BINARY_OP_LOAN_LIST_UNASSIGNED:
+            if (role != ROLE_MANAGER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            return loan_list_response(0, -1, out); // 0 = Requested
+
+        case BINARY_OP_LOAN_ASSIGN: {
+            int loan_id = take_i32(in);
+            int employee_id = take_i32(in);
+            if (role != ROLE_MANAGER) return BINARY_NOT_AUTHORIZED;
+            if (!body_complete(in)) return BINARY_BAD_REQUEST;
+            return status_of(bank_assign_loan(loan_id, employee_id));
+        }
+
+        default:
+            return BINARY_UNKNOWN_OPCODE;
+    }
+}
+
+/**
+ * @brief Queues one response frame; it goes out with the next flush.
+ */
+static int queue_frame(int socket_fd, unsigned int opcode, unsigned int status, unsigned long request_id,
+                       const struct Frame* body) {
+    unsigned char header[BINARY_HEADER_SIZE];
+    unsigned int body_len = (status == BINARY_OK || status == BINARY_INSUFFICIENT_FUNDS) ? body->len : 0;
+    put_u32(header, body_len);
+    put_u16(header + 4, opcode);
+    put_u16(header + 6, status);
+    put_u32(header + 8, request_id);
+    if (queue_output(socket_fd, header, sizeof(header)) == -1) return -1;
+    return (body_len > 0) ? queue_output(socket_fd, body->data, body_len) : 0;
+}
+
+// --- Session ---
+
+/**
+ * @brief Serves binary frames until the client disconnects or breaks the
+ * framing. The next input byte must be BINARY_PROTOCOL_MAGIC.
+ */
+void handle_binary_session(int client_socket) {
+    struct BinarySession session = {client_socket, ROLE_NONE, -1, NULL};
+    unsigned char magic, header[BINARY_HEADER_SIZE];
+    unsigned char request[BINARY_MAX_BODY], response[BINARY_MAX_BODY];
+
+    if (read_exact(client_socket, &magic, 1) <= 0 || magic != BINARY_PROTOCOL_MAGIC) return;
+    printf("Client switched to the binary protocol.\n");
+
+    while (read_exact(client_socket, header, sizeof(header)) == (int)sizeof(header)) {
+        unsigned long body_len = get_u32(header);
+        unsigned int opcode = get_u16(header + 4);
+        unsigned long request_id = get_u32(header + 8);
+        struct Frame in = {request, 0, (unsigned int)body_len, 0};
+        struct Frame out = {response, 0, sizeof(response), 0};
+
+        if (body_len > BINARY_MAX_BODY) {
+            // The rest of the stream cannot be framed any more
+            queue_frame(client_socket, opcode, BINARY_BAD_REQUEST, request_id, &out);
+            break;
+        }
+        if (body_len > 0 && read_exact(client_socket, request, (int)body_len) != (int)body_len) break;
+
+        int status = dispatch(&session, opcode, &in, &out);
+        if (queue_frame(client_socket, opcode, (unsigned int)status, request_id, &out) == -1) break;
+    }
+
+    binary_logout(&session);
+}
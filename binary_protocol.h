@@ -0,0 +1,92 @@
+/*
+ * ========================================
+ * binary_protocol.h
+ * =Description: Length-prefixed binary protocol for
+ * machine clients (e.g. a payment gateway), served on
+ * the same port as the text menus.
+ *
+ * =Handshake: the server greets every connection with
+ * the one-line text main menu. A client that sends
+ * BINARY_PROTOCOL_MAGIC as its first byte switches the
+ * connection to binary frames; it skips the greeting
+ * (through its first '\n') and sends requests.
+ *
+ * =Frames: all integers little-endian. A request:
+ *   u32 body_length  u16 opcode  u16 flags (0)
+ *   u32 request_id   body
+ * and its response:
+ *   u32 body_length  u16 opcode  u16 status
+ *   u32 request_id   body
+ * Requests are answered in order, each echoing the
+ * request's opcode and ID, so a client may pipeline
+ * many requests and match responses by ID. Amounts
+ * are i64 cents; IDs are i32.
+ *
+ * =Bodies (request -> response; "." = empty):
+ *   PING             .                     -> .
+ *   LOGIN_*          i32 id, secret bytes  -> .
+ *   LOGOUT           .                     -> .
+ *   DEPOSIT          i64 amount            -> i64 balance
+ *   WITHDRAW         i64 amount            -> i64 balance
+ *   TRANSFER         i32 dest, i64 amount  -> i64 balance
+ *   BALANCE          .                     -> i64 balance
+ *   HISTORY          i32 account, u16 max  -> u16 n, n x entry
+ *     entry: i64 timestamp_us, i32 op, i32 counterparty,
+ *            i64 amount, i64 resulting_balance (newest first)
+ *   LOAN_REQUEST     i64 amount            -> i32 loan_id
+ *   LOAN_LIST_*      .                     -> u16 n, n x loan
+ *     loan: i32 loan_id, i32 account_id, i64 amount
+ *   LOAN_DECIDE      i32 loan_id, u8 approve -> .
+ *   LOAN_ASSIGN      i32 loan_id, i32 employee_id -> .
+ * WITHDRAW and TRANSFER also return the balance with
+ * BINARY_INSUFFICIENT_FUNDS. Customers may only ask
+ * for their own HISTORY (account 0 = own).
+ * ========================================
+ */
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#define BINARY_PROTOCOL_MAGIC 0xB1 // Never the first byte of a menu choice
+#define BINARY_HEADER_SIZE 12
+#define BINARY_MAX_BODY 4096       // Larger frames end the connection
+#define BINARY_LIST_MAX 64         // Entries per HISTORY or LOAN_LIST_* response
+
+// --- Opcodes ---
+#define BINARY_OP_PING 0x0000
+#define BINARY_OP_LOGIN_CUSTOMER 0x0001
+#define BINARY_OP_LOGIN_EMPLOYEE 0x0002
+#define BINARY_OP_LOGIN_MANAGER 0x0003
+#define BINARY_OP_LOGOUT 0x0004
+#define BINARY_OP_DEPOSIT 0x0010         // Customer
+#define BINARY_OP_WITHDRAW 0x0011        // Customer
+#define BINARY_OP_TRANSFER 0x0012        // Customer
+#define BINARY_OP_BALANCE 0x0013         // Customer
+#define BINARY_OP_HISTORY 0x0014         // Customer or employee
+#define BINARY_OP_LOAN_REQUEST 0x0015    // Customer
+#define BINARY_OP_LOAN_LIST_ASSIGNED 0x0020 // Employee
+#define BINARY_OP_LOAN_DECIDE 0x0021        // Employee
+#define BINARY_OP_LOAN_LIST_UNASSIGNED 0x0030 // Manager
+#define BINARY_OP_LOAN_ASSIGN 0x0031          // Manager
+
+// --- Response Status ---
+#define BINARY_OK 0
+#define BINARY_BAD_REQUEST 1        // Malformed body or invalid amount
+#define BINARY_UNKNOWN_OPCODE 2
+#define BINARY_NOT_AUTHORIZED 3     // Not logged in with a role allowed the operation
+#define BINARY_LOGIN_FAILED 4
+#define BINARY_ALREADY_LOGGED_IN 5  // This connection, or another, holds the session
+#define BINARY_NOT_FOUND 6
+#define BINARY_DEST_NOT_FOUND 7
+#define BINARY_SAME_ACCOUNT 8
+#define BINARY_INSUFFICIENT_FUNDS 9
+#define BINARY_DEST_INACTIVE 10
+#define BINARY_LOCK_FAILED 11
+#define BINARY_NOT_ASSIGNED 12
+#define BINARY_NOT_PENDING 13
+#define BINARY_SERVER_ERROR 14      // Database error; nothing was changed
+
+// --- Session ---
+void handle_binary_session(int client_socket);
+
+#endif // BINARY_PROTOCOL_H
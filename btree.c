@@ -0,0 +1,704 @@
+/*
+ * ========================================
+ * btree.c
+ * =Description: Implementation of the B+tree index.
+ *
+ * Page 0 of the file is a header; every other page is
+ * a node. Leaves hold sorted (key, record) pairs and a
+ * link to their right sibling, so range scans walk the
+ * leaf level. Inner nodes hold separator keys: child i
+ * covers keys below keys[i], the last child the rest.
+ * IDs are never deleted, so nodes only ever split.
+ *
+ * All processes share one buffer pool (CLOCK eviction,
+ * dirty pages written back on eviction or flush). A
+ * robust, process-shared mutex serializes every tree
+ * operation; hot lookups are answered by the hash
+ * index first, so the tree is used for ordered scans
+ * and for lookups the hash index cannot answer.
+ *
+ * Crash safety: the tree is derived from its table. The
+ * header's clean flag is cleared (and synced) before the
+ * first page changes, and set again only once every
+ * dirty page is synced. On open, a tree that is not
+ * clean, or whose key count does not match the table,
+ * is rebuilt by a sorted bulk load.
+ * ========================================
+ */
+
+#include "btree.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define BTREE_MAGIC 0x31525442 // "BTR1"
+#define NO_PAGE 0              // Page 0 is the header, so it never names a node
+#define MAX_HEIGHT 16
+#define MIN_FRAMES 16          // An insert pins up to 4 pages at a time
+#define LOAD_BATCH 64          // Pages per pwrite during a bulk load
+
+#define LEAF_CAPACITY ((BTREE_PAGE_SIZE - 8) / sizeof(struct BTreeEntry))
+#define INNER_CAPACITY ((BTREE_PAGE_SIZE - 12) / 8)
+
+// --- On-Disk Layout ---
+
+struct BTreeHeader {
+    unsigned int magic;
+    unsigned int page_size;
+    unsigned int root;       // NO_PAGE while the tree is empty
+    unsigned int height;     // 1: the root is a leaf
+    unsigned int page_count; // Including the header page
+    unsigned int clean;      // Every page on disk is current
+    long long keys;
+};
+
+struct BTreeEntry {
+    int key;
+    int record;
+};
+
+struct BTreeNode {
+    unsigned short is_leaf;
+    unsigned short count;
+    unsigned int next; // Leaves: right sibling, NO_PAGE for the last one
+    union {
+        struct BTreeEntry entries[LEAF_CAPACITY];
+        struct {
+            unsigned int children[INNER_CAPACITY + 1];
+            int keys[INNER_CAPACITY];
+        } inner;
+    };
+};
+
+_Static_assert(sizeof(struct BTreeNode) <= BTREE_PAGE_SIZE, "B+tree node must fit in a page");
+
+// --- Shared Buffer Pool ---
+
+struct BTreeFrame {
+    unsigned int page;  // NO_PAGE: free
+    int next;           // Next frame in the same hash bucket, -1 at the end
+    int pins;
+    unsigned char dirty;
+    unsigned char referenced;
+};
+
+// Created by the parent before fork
+struct BTreeShared {
+    pthread_mutex_t lock;       // Held for every tree operation
+    struct BTreeHeader header;  // Current header; written to page 0 on flush
+    int degraded;               // A page write failed; the file cannot be trusted
+    int clock_hand;
+};
+
+// Per-process handle (a copy is inherited by every child)
+struct BTree {
+    struct BTreeShared* shared;
+    struct BTreeFrame* frames;
+    int* buckets;
+    char* pages;
+    int frame_count;
+    int bucket_mask;
+    int fd;
+    int table;
+};
+
+struct BTree* g_account_btree = NULL;
+struct BTree* g_staff_btree = NULL;
+
+static struct BTreeNode* frame_node(struct BTree* tree, int frame) {
+    return (struct BTreeNode*)(tree->pages + (size_t)frame * BTREE_PAGE_SIZE);
+}
+
+static int bucket_of(const struct BTree* tree, unsigned int page) {
+    return (int)((page * 2654435761u) & (unsigned int)tree->bucket_mask);
+}
+
+static int find_frame(struct BTree* tree, unsigned int page) {
+    for (int f = tree->buckets[bucket_of(tree, page)]; f != -1; f = tree->frames[f].next) {
+        if (tree->frames[f].page == page) return f;
+    }
+    return -1;
+}
+
+static void unlink_frame(struct BTree* tree, int frame) {
+    int* link = &tree->buckets[bucket_of(tree, tree->frames[frame].page)];
+    while (*link != frame) link = &tree->frames[*link].next;
+    *link = tree->frames[frame].next;
+    tree->frames[frame].page = NO_PAGE;
+}
+
+static int write_frame(struct BTree* tree, int frame) {
+    off_t offset = (off_t)tree->frames[frame].page * BTREE_PAGE_SIZE;
+    if (pwrite(tree->fd, frame_node(tree, frame), BTREE_PAGE_SIZE, offset) != BTREE_PAGE_SIZE) {
+        tree->shared->degraded = 1;
+        return -1;
+    }
+    tree->frames[frame].dirty = 0;
+    return 0;
+}
+
+/**
+ * @brief Frees a frame with the CLOCK algorithm, writing it back if dirty.
+ * @return The frame, or -1 if every frame is pinned or a write failed.
+ */
+static int evict_frame(struct BTree* tree) {
+    for (int step = 0; step < 2 * tree->frame_count; step++) {
+        int f = tree->shared->clock_hand;
+        tree->shared->clock_hand = (f + 1) % tree->frame_count;
+        struct BTreeFrame* frame = &tree->frames[f];
+        if (frame->pins > 0) continue;
+        if (frame->page == NO_PAGE) return f;
+        if (frame->referenced) { frame->referenced = 0; continue; }
+        if (frame->dirty && write_frame(tree, f) == -1) return -1;
+        unlink_frame(tree, f);
+        return f;
+    }
+    return -1;
+}
+
+/**
+ * @brief Pins a page in the pool, reading it unless `fresh` (a newly
+ * allocated page, which starts zeroed). Caller holds the tree lock.
+ */
+static struct BTreeNode* pin_page(struct BTree* tree, unsigned int page, int fresh) {
+    int f = find_frame(tree, page);
+    if (f == -1) {
+        f = evict_frame(tree);
+        if (f == -1) return NULL;
+        struct BTreeNode* node = frame_node(tree, f);
+        if (fresh) {
+            memset(node, 0, BTREE_PAGE_SIZE);
+        } else if (pread(tree->fd, node, BTREE_PAGE_SIZE, (off_t)page * BTREE_PAGE_SIZE) != BTREE_PAGE_SIZE) {
+            return NULL;
+        }
+        int bucket = bucket_of(tree, page);
+        tree->frames[f].page = page;
+        tree->frames[f].next = tree->buckets[bucket];
+        tree->frames[f].dirty = (unsigned char)fresh;
+        tree->buckets[bucket] = f;
+    }
+    tree->frames[f].pins++;
+    tree->frames[f].referenced = 1;
+    return frame_node(tree, f);
+}
+
+static void unpin_page(struct BTree* tree, struct BTreeNode* node, int dirty) {
+    int f = (int)(((char*)node - tree->pages) / BTREE_PAGE_SIZE);
+    tree->frames[f].pins--;
+    if (dirty) tree->frames[f].dirty = 1;
+}
+
+static struct BTreeNode* allocate_page(struct BTree* tree, unsigned int* page) {
+    *page = tree->shared->header.page_count;
+    struct BTreeNode* node = pin_page(tree, *page, 1);
+    if (node != NULL) tree->shared->header.page_count++;
+    return node;
+}
+
+static int write_header(struct BTree* tree) {
+    char page[BTREE_PAGE_SIZE] = {0};
+    memcpy(page, &tree->shared->header, sizeof(tree->shared->header));
+    if (pwrite(tree->fd, page, BTREE_PAGE_SIZE, 0) != BTREE_PAGE_SIZE || fdatasync(tree->fd) == -1) return -1;
+    return 0;
+}
+
+/**
+ * @brief Durably clears the clean flag before the first page changes.
+ */
+static int mark_dirty(struct BTree* tree) {
+    if (!tree->shared->header.clean) return 0;
+    tree->shared->header.clean = 0;
+    if (write_header(tree) == -1) {
+        tree->shared->degraded = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// --- Node Search ---
+
+// First entry with key >= `key`
+static int leaf_lower_bound(const struct BTreeNode* leaf, int key) {
+    int low = 0, high = leaf->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (leaf->entries[mid].key < key) low = mid + 1; else high = mid;
+    }
+    return low;
+}
+
+// Child that covers `key`: the number of separators <= key
+static int inner_child_slot(const struct BTreeNode* node, int key) {
+    int low = 0, high = node->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (node->inner.keys[mid] <= key) low = mid + 1; else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Walks from the root to the leaf covering `key`, recording the
+ * inner pages and child slots on the way (either may be NULL).
+ * @return The leaf page, or NO_PAGE for an empty tree or a read error.
+ */
+static unsigned int descend(struct BTree* tree, int key, unsigned int* path, int* slots) {
+    unsigned int page = tree->shared->header.root;
+    for (unsigned int level = 0; page != NO_PAGE && level + 1 < tree->shared->header.height; level++) {
+        struct BTreeNode* node = pin_page(tree, page, 0);
+        if (node == NULL) return NO_PAGE;
+        int slot = inner_child_slot(node, key);
+        if (path != NULL) { path[level] = page; slots[level] = slot; }
+        page = node->inner.children[slot];
+        unpin_page(tree, node, 0);
+    }
+    return page;
+}
+
+// --- Lookup ---
+
+/**
+ * @brief Returns the record number stored for key, -1 if absent, or
+ * BTREE_UNKNOWN if the tree is unavailable or cannot be read.
+ */
+int btree_find(struct BTree* tree, int key) {
+    if (tree == NULL || lock_shared_mutex(&tree->shared->lock) == -1) return BTREE_UNKNOWN;
+    if (tree->shared->degraded) {
+        pthread_mutex_unlock(&tree->shared->lock);
+        return BTREE_UNKNOWN;
+    }
+
+    int record = -1;
+    if (tree->shared->header.root != NO_PAGE) {
+        unsigned int page = descend(tree, key, NULL, NULL);
+        struct BTreeNode* leaf = (page == NO_PAGE) ? NULL : pin_page(tree, page, 0);
+        if (leaf == NULL) {
+            record = BTREE_UNKNOWN;
+        } else {
+            int pos = leaf_lower_bound(leaf, key);
+            if (pos < leaf->count && leaf->entries[pos].key == key) record = leaf->entries[pos].record;
+            unpin_page(tree, leaf, 0);
+        }
+    }
+    pthread_mutex_unlock(&tree->shared->lock);
+    return record;
+}
+
+/**
+ * @brief Copies the entries with first_key <= key <= last_key, in key
+ * order, up to max_entries. `keys` may be NULL. Continue a long range
+ * from the last key returned plus one.
+ * @return Entries copied, or -1 if the tree is unavailable.
+ */
+int btree_range(struct BTree* tree, int first_key, int last_key, int* keys, int* records, int max_entries) {
+    if (tree == NULL || lock_shared_mutex(&tree->shared->lock) == -1) return -1;
+    if (tree->shared->degraded) {
+        pthread_mutex_unlock(&tree->shared->lock);
+        return -1;
+    }
+
+    int found = 0, rc = 0, done = 0;
+    unsigned int page = descend(tree, first_key, NULL, NULL);
+    int pos = -1; // Lower bound, computed in the first leaf only
+    while (page != NO_PAGE && !done) {
+        struct BTreeNode* leaf = pin_page(tree, page, 0);
+        if (leaf == NULL) { rc = -1; break; }
+        if (pos == -1) pos = leaf_lower_bound(leaf, first_key);
+        for (; pos < leaf->count && !done; pos++) {
+            if (leaf->entries[pos].key > last_key) { done = 1; break; }
+            if (keys != NULL) keys[found] = leaf->entries[pos].key;
+            records[found++] = leaf->entries[pos].record;
+            done = (found == max_entries);
+        }
+        page = leaf->next;
+        pos = 0;
+        unpin_page(tree, leaf, 0);
+    }
+    pthread_mutex_unlock(&tree->shared->lock);
+    return (rc == -1) ? -1 : found;
+}
+
+// --- Insertion ---
+
+/**
+ * @brief Inserts separator `key` with right child `child` at `slot` of
+ * an inner node that has room.
+ */
+static void inner_insert(struct BTreeNode* node, int slot, int key, unsigned int child) {
+    memmove(&node->inner.keys[slot + 1], &node->inner.keys[slot], (node->count - slot) * sizeof(int));
+    memmove(&node->inner.children[slot + 2], &node->inner.children[slot + 1],
+            (node->count - slot) * sizeof(unsigned int));
+    node->inner.keys[slot] = key;
+    node->inner.children[slot + 1] = child;
+    node->count++;
+}
+
+/**
+ * @brief Pushes a split's separator up the recorded path, splitting
+ * full inner nodes and growing a new root if needed.
+ */
+static int promote(struct BTree* tree, unsigned int* path, int* slots, int level, int key, unsigned int child) {
+    for (; level >= 0; level--) {
+        struct BTreeNode* node = pin_page(tree, path[level], 0);
+        if (node == NULL) return -1;
+        if (node->count < INNER_CAPACITY) {
+            inner_insert(node, slots[level], key, child);
+            unpin_page(tree, node, 1);
+            return 0;
+        }
+
+        // Split a full node around its middle key, which moves up
+        int keys[INNER_CAPACITY + 1];
+        unsigned int children[INNER_CAPACITY + 2];
+        int slot = slots[level], total = node->count + 1;
+        memcpy(keys, node->inner.keys, slot * sizeof(int));
+        keys[slot] = key;
+        memcpy(&keys[slot + 1], &node->inner.keys[slot], (node->count - slot) * sizeof(int));
+        memcpy(children, node->inner.children, (slot + 1) * sizeof(unsigned int));
+        children[slot + 1] = child;
+        memcpy(&children[slot + 2], &node->inner.children[slot + 1], (node->count - slot) * sizeof(unsigned int));
+
+        unsigned int right_page;
+        struct BTreeNode* right = allocate_page(tree, &right_page);
+        if (right == NULL) { unpin_page(tree, node, 0); return -1; }
+        int left_count = total / 2;
+        node->count = left_count;
+        memcpy(node->inner.keys, keys, left_count * sizeof(int));
+        memcpy(node->inner.children, children, (left_count + 1) * sizeof(unsigned int));
+        right->count = total - left_count - 1;
+        memcpy(right->inner.keys, &keys[left_count + 1], right->count * sizeof(int));
+        memcpy(right->inner.children, &children[left_count + 1], (right->count + 1) * sizeof(unsigned int));
+        unpin_page(tree, right, 1);
+        unpin_page(tree, node, 1);
+
+        key = keys[left_count];
+        child = right_page;
+    }
+
+    // The root split: a new root over the two halves
+    unsigned int root_page;
+    struct BTreeNode* root = allocate_page(tree, &root_page);
+    if (root == NULL) return -1;
+    root->count = 1;
+    root->inner.keys[0] = key;
+    root->inner.children[0] = tree->shared->header.root;
+    root->inner.children[1] = child;
+    unpin_page(tree, root, 1);
+    tree->shared->header.root = root_page;
+    tree->shared->header.height++;
+    return 0;
+}
+
+static int insert_locked(struct BTree* tree, int key, int record) {
+    if (tree->shared->degraded || mark_dirty(tree) == -1) return -1;
+    struct BTreeHeader* header = &tree->shared->header;
+
+    if (header->root == NO_PAGE) {
+        unsigned int page;
+        struct BTreeNode* leaf = allocate_page(tree, &page);
+        if (leaf == NULL) return -1;
+        leaf->is_leaf = 1;
+        leaf->count = 1;
+        leaf->entries[0] = (struct BTreeEntry){key, record};
+        unpin_page(tree, leaf, 1);
+        header->root = page;
+        header->height = 1;
+        header->keys = 1;
+        return 0;
+    }
+
+    unsigned int path[MAX_HEIGHT];
+    int slots[MAX_HEIGHT];
+    if (header->height > MAX_HEIGHT) return -1;
+    unsigned int leaf_page = descend(tree, key, path, slots);
+    struct BTreeNode* leaf = (leaf_page == NO_PAGE) ? NULL : pin_page(tree, leaf_page, 0);
+    if (leaf == NULL) return -1;
+
+    int pos = leaf_lower_bound(leaf, key);
+    if (pos < leaf->count && leaf->entries[pos].key == key) { // Existing key: repoint it
+        leaf->entries[pos].record = record;
+        unpin_page(tree, leaf, 1);
+        return 0;
+    }
+    header->keys++;
+
+    if (leaf->count < LEAF_CAPACITY) {
+        memmove(&leaf->entries[pos + 1], &leaf->entries[pos], (leaf->count - pos) * sizeof(struct BTreeEntry));
+        leaf->entries[pos] = (struct BTreeEntry){key, record};
+        leaf->count++;
+        unpin_page(tree, leaf, 1);
+        return 0;
+    }
+
+    unsigned int right_page;
+    struct BTreeNode* right = allocate_page(tree, &right_page);
+    if (right == NULL) { unpin_page(tree, leaf, 0); return -1; }
+
+    // New IDs mostly arrive in increasing order: appending to the last
+    // leaf starts a new one instead of leaving two half-full leaves
+    int split = (pos == leaf->count && leaf->next == NO_PAGE) ? leaf->count : leaf->count / 2;
+    right->is_leaf = 1;
+    right->count = leaf->count - split;
+    memcpy(right->entries, &leaf->entries[split], right->count * sizeof(struct BTreeEntry));
+    right->next = leaf->next;
+    leaf->count = split;
+    leaf->next = right_page;
+
+    struct BTreeNode* target = (pos < split) ? leaf : right;
+    int target_pos = (pos < split) ? pos : pos - split;
+    memmove(&target->entries[target_pos + 1], &target->entries[target_pos],
+            (target->count - target_pos) * sizeof(struct BTreeEntry));
+    target->entries[target_pos] = (struct BTreeEntry){key, record};
+    target->count++;
+
+    int separator = right->entries[0].key;
+    unpin_page(tree, right, 1);
+    unpin_page(tree, leaf, 1);
+    return promote(tree, path, slots, (int)header->height - 2, separator, right_page);
+}
+
+/**
+ * @brief Adds (or repoints) key. Callers serialize creators per table,
+ * as for the hash index.
+ * @return 0 on success, -1 if the tree is now degraded (it is rebuilt
+ * on the next start).
+ */
+int btree_insert(struct BTree* tree, int key, int record) {
+    if (tree == NULL || lock_shared_mutex(&tree->shared->lock) == -1) return -1;
+    int rc = insert_locked(tree, key, record);
+    if (rc == -1) tree->shared->degraded = 1;
+    pthread_mutex_unlock(&tree->shared->lock);
+    return rc;
+}
+
+// --- Flush & Rebuild ---
+
+/**
+ * @brief Writes back every dirty page, syncs the file and marks it clean.
+ */
+int btree_flush(struct BTree* tree) {
+    if (tree == NULL || lock_shared_mutex(&tree->shared->lock) == -1) return -1;
+
+    int rc = tree->shared->degraded ? -1 : 0;
+    for (int f = 0; f < tree->frame_count && rc == 0; f++) {
+        if (tree->frames[f].page != NO_PAGE && tree->frames[f].dirty) rc = write_frame(tree, f);
+    }
+    if (rc == 0 && !tree->shared->header.clean) {
+        if (fdatasync(tree->fd) == -1) {
+            rc = -1;
+        } else {
+            tree->shared->header.clean = 1;
+            rc = write_header(tree);
+        }
+    }
+    pthread_mutex_unlock(&tree->shared->lock);
+    return rc;
+}
+
+// Growing array of (key, record) pairs read from the table
+struct EntryList {
+    struct BTreeEntry* entries;
+    long count;
+    long capacity;
+    int failed;
+};
+
+static int collect_entry(int record, const void* data, void* ctx) {
+    struct EntryList* list = ctx;
+    if (list->count == list->capacity) {
+        long capacity = list->capacity ? list->capacity * 2 : 4096;
+        struct BTreeEntry* grown = realloc(list->entries, capacity * sizeof(struct BTreeEntry));
+        if (grown == NULL) { list->failed = 1; return 1; }
+        list->entries = grown;
+        list->capacity = capacity;
+    }
+    memcpy(&list->entries[list->count].key, data, sizeof(int));
+    list->entries[list->count++].record = record;
+    return 0;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const struct BTreeEntry* x = a;
+    const struct BTreeEntry* y = b;
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    return (x->record > y->record) - (x->record < y->record);
+}
+
+/**
+ * @brief Bulk-load writer: stages pages and writes them in batches.
+ */
+struct PageWriter {
+    int fd;
+    char* buffer;
+    int staged;
+    unsigned int first_page; // Page number of buffer[0]
+    int failed;
+};
+
+static struct BTreeNode* next_page(struct PageWriter* writer, unsigned int* page) {
+    if (writer->staged == LOAD_BATCH) {
+        size_t bytes = (size_t)LOAD_BATCH * BTREE_PAGE_SIZE;
+        if (pwrite(writer->fd, writer->buffer, bytes, (off_t)writer->first_page * BTREE_PAGE_SIZE) != (ssize_t)bytes) {
+            writer->failed = 1;
+        }
+        writer->first_page += LOAD_BATCH;
+        writer->staged = 0;
+    }
+    *page = writer->first_page + writer->staged;
+    struct BTreeNode* node = (struct BTreeNode*)(writer->buffer + (size_t)writer->staged++ * BTREE_PAGE_SIZE);
+    memset(node, 0, BTREE_PAGE_SIZE);
+    return node;
+}
+
+static void finish_pages(struct PageWriter* writer) {
+    size_t bytes = (size_t)writer->staged * BTREE_PAGE_SIZE;
+    if (bytes && pwrite(writer->fd, writer->buffer, bytes, (off_t)writer->first_page * BTREE_PAGE_SIZE) != (ssize_t)bytes) {
+        writer->failed = 1;
+    }
+    writer->first_page += writer->staged;
+    writer->staged = 0;
+}
+
+/**
+ * @brief Writes one level above `children` (first keys and pages of the
+ * level below) and replaces them with the new level's nodes.
+ */
+static long build_inner_level(struct PageWriter* writer, int* first_keys, unsigned int* pages, long count) {
+    long built = 0;
+    for (long i = 0; i < count; i += INNER_CAPACITY + 1) {
+        long children = (count - i < (long)INNER_CAPACITY + 1) ? count - i : (long)INNER_CAPACITY + 1;
+        unsigned int page = NO_PAGE;
+        struct BTreeNode* node = next_page(writer, &page);
+        node->count = (unsigned short)(children - 1);
+        for (long c = 0; c < children; c++) {
+            node->inner.children[c] = pages[i + c];
+            if (c > 0) node->inner.keys[c - 1] = first_keys[i + c];
+        }
+        first_keys[built] = first_keys[i];
+        pages[built++] = page;
+    }
+    return built;
+}
+
+/**
+ * @brief Rebuilds the tree from its table: one scan, a sort, then the
+ * pages are written bottom-up with full leaves. Parent only, before fork.
+ */
+int btree_rebuild(struct BTree* tree) {
+    struct EntryList list = {NULL, 0, 0, 0};
+    if (storage_scan(tree->table, collect_entry, &list) == -1 || list.failed) {
+        free(list.entries);
+        return -1;
+    }
+    qsort(list.entries, list.count, sizeof(struct BTreeEntry), compare_entries);
+
+    // Duplicate IDs keep their first record, like the data table's own scans
+    long unique = 0;
+    for (long i = 0; i < list.count; i++) {
+        if (unique == 0 || list.entries[unique - 1].key != list.entries[i].key) list.entries[unique++] = list.entries[i];
+    }
+
+    long leaves = (unique + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+    int* first_keys = malloc((leaves ? leaves : 1) * sizeof(int));
+    unsigned int* pages = malloc((leaves ? leaves : 1) * sizeof(unsigned int));
+    struct PageWriter writer = {tree->fd, malloc((size_t)LOAD_BATCH * BTREE_PAGE_SIZE), 0, 1, 0};
+    if (first_keys == NULL || pages == NULL || writer.buffer == NULL || ftruncate(tree->fd, 0) == -1) writer.failed = 1;
+
+    struct BTreeHeader header = {BTREE_MAGIC, BTREE_PAGE_SIZE, NO_PAGE, 0, 1, 0, unique};
+    if (!writer.failed && leaves > 0) {
+        pages[0] = NO_PAGE;
+        for (long l = 0; l < leaves && !writer.failed; l++) {
+            long first = l * LEAF_CAPACITY;
+            long count = (unique - first < (long)LEAF_CAPACITY) ? unique - first : (long)LEAF_CAPACITY;
+            unsigned int page = NO_PAGE;
+            struct BTreeNode* leaf = next_page(&writer, &page);
+            leaf->is_leaf = 1;
+            leaf->count = (unsigned short)count;
+            leaf->next = (l + 1 < leaves) ? page + 1 : NO_PAGE; // Leaves are written consecutively
+            memcpy(leaf->entries, &list.entries[first], count * sizeof(struct BTreeEntry));
+            first_keys[l] = list.entries[first].key;
+            pages[l] = page;
+        }
+        long level_count = leaves;
+        header.height = 1;
+        while (level_count > 1 && !writer.failed) {
+            level_count = build_inner_level(&writer, first_keys, pages, level_count);
+            header.height++;
+        }
+        if (!writer.failed) header.root = pages[0]; // A failed rebuild leaves the tree degraded
+    }
+    finish_pages(&writer);
+    header.page_count = writer.first_page;
+    free(list.entries);
+    free(first_keys);
+    free(pages);
+    free(writer.buffer);
+
+    // Drop every cached page, then publish the new header
+    for (int f = 0; f < tree->frame_count; f++) {
+        tree->frames[f].page = NO_PAGE;
+        tree->frames[f].pins = 0;
+        tree->frames[f].dirty = 0;
+    }
+    for (int b = 0; b <= tree->bucket_mask; b++) tree->buckets[b] = -1;
+    tree->shared->header = header;
+    tree->shared->degraded = writer.failed;
+    if (writer.failed || fdatasync(tree->fd) == -1) {
+        tree->shared->degraded = 1;
+        return -1;
+    }
+    tree->shared->header.clean = 1;
+    return write_header(tree);
+}
+
+/**
+ * @brief Opens (creating if needed) the tree file for `table` and sets up
+ * its shared buffer pool. A tree that was not closed cleanly, or does not
+ * cover every record of the table, is rebuilt. Run before fork().
+ * @return The tree, or NULL if it is unavailable.
+ */
+struct BTree* btree_open(const char* path, int table, int pool_frames) {
+    if (pool_frames < MIN_FRAMES) pool_frames = MIN_FRAMES;
+    int buckets = 1;
+    while (buckets < 2 * pool_frames) buckets <<= 1;
+
+    struct BTree* tree = malloc(sizeof(struct BTree));
+    size_t pages_offset = (sizeof(struct BTreeShared) + pool_frames * sizeof(struct BTreeFrame) +
+                           buckets * sizeof(int) + BTREE_PAGE_SIZE - 1) / BTREE_PAGE_SIZE * BTREE_PAGE_SIZE;
+    char* region = create_shared_region(pages_offset + (size_t)pool_frames * BTREE_PAGE_SIZE);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (tree == NULL || region == NULL || fd == -1) {
+        free(tree);
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+
+    tree->shared = (struct BTreeShared*)region;
+    tree->frames = (struct BTreeFrame*)(region + sizeof(struct BTreeShared));
+    tree->buckets = (int*)(tree->frames + pool_frames);
+    tree->pages = region + pages_offset;
+    tree->frame_count = pool_frames;
+    tree->bucket_mask = buckets - 1;
+    tree->fd = fd;
+    tree->table = table;
+    init_shared_mutex(&tree->shared->lock);
+    for (int b = 0; b < buckets; b++) tree->buckets[b] = -1;
+
+    struct BTreeHeader header;
+    int trusted = (pread(fd, &header, sizeof(header), 0) == sizeof(header) && header.magic == BTREE_MAGIC &&
+                   header.page_size == BTREE_PAGE_SIZE && header.clean && header.keys == storage_count(table));
+    if (trusted) {
+        tree->shared->header = header;
+    } else if (btree_rebuild(tree) == -1) {
+        close(fd);
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
@@ -0,0 +1,42 @@
+/*
+ * ========================================
+ * btree.h
+ * =Description: Persistent, page-based B+tree that
+ * maps a record ID (account_id, employee_id) to its
+ * record number, in key order.
+ * - 4 KB pages; a node holds ~500 keys, so ten million
+ *   records need a tree of height 3
+ * - Pages are cached in a buffer pool in shared memory,
+ *   created by the parent and used by every child
+ * - Point lookups and ordered range scans
+ * - Derived from the data table: a tree that was not
+ *   shut down cleanly is rebuilt from it on startup
+ * ========================================
+ */
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#define BTREE_PAGE_SIZE 4096
+#define ACCOUNT_BTREE_FRAMES 2048 // Buffer pool pages (8 MB of shared memory)
+#define STAFF_BTREE_FRAMES 64
+#define BTREE_UNKNOWN -2 // btree_find(): the tree is unavailable, only a scan can tell
+
+// Opaque handle; the layout lives in btree.c
+struct BTree;
+
+// --- Tree Lifecycle (parent, before fork) ---
+struct BTree* btree_open(const char* path, int table, int pool_frames);
+int btree_rebuild(struct BTree* tree);
+int btree_flush(struct BTree* tree);
+
+// --- Lookup & Maintenance ---
+int btree_find(struct BTree* tree, int key);
+int btree_insert(struct BTree* tree, int key, int record);
+int btree_range(struct BTree* tree, int first_key, int last_key, int* keys, int* records, int max_entries);
+
+// --- Global Trees (NULL when unavailable) ---
+extern struct BTree* g_account_btree;
+extern struct BTree* g_staff_btree;
+
+#endif // BTREE_H
@@ -6,6 +6,7 @@
  * - Connects to the server
  * - Parses the server's [STATUS]:[Message] protocol
  * - Handles regular and masked input
+ * - Saves files the server sends (statement export)
  *
  * =Compile command:
  * gcc client.c -o client
@@ -29,6 +30,7 @@
 
 // --- Function Prototypes ---
 void main_communication_loop(int server_fd);
+int receive_download(char* header, int server_fd, const char* buffered, int buffered_len);
 void handle_server_response(char* line, int server_fd);
 int parse_server_response(char* response, char* status_out, char* message_out, int buf_size);
 void print_message(const char* msg);
@@ -78,25 +80,38 @@ int main() {
 
 /**
  * @brief The main loop for handling server communication.
- * Reads data and processes it message by message.
+ * Reads data and processes it message by message. A message split
+ * across reads is kept until its newline arrives; a DATA message is
+ * followed by raw file bytes, which are saved instead of parsed.
  */
 void main_communication_loop(int server_fd) {
     char server_buffer[BUFFER_SIZE];
+    int buffered = 0;
     int bytes_read;
-    char* line;
-    char* saveptr = NULL;
 
     // Read in a loop
-    while ((bytes_read = read(server_fd, server_buffer, sizeof(server_buffer) - 1)) > 0) {
-        server_buffer[bytes_read] = '\0'; // Null-terminate the read data
-
-        // Process the buffer, which may contain multiple \n terminated messages
-        line = strtok_r(server_buffer, "\n", &saveptr);
-        
-        while (line != NULL) {
-            handle_server_response(line, server_fd);
-            line = strtok_r(NULL, "\n", &saveptr);
+    while ((bytes_read = read(server_fd, server_buffer + buffered, sizeof(server_buffer) - 1 - buffered)) > 0) {
+        buffered += bytes_read;
+
+        // Process every complete, \n terminated message in the buffer
+        int start = 0;
+        char* newline;
+        while ((newline = memchr(server_buffer + start, '\n', buffered - start)) != NULL) {
+            *newline = '\0';
+            char* line = server_buffer + start;
+            start = (newline - server_buffer) + 1;
+
+            if (strncmp(line, "DATA:", 5) == 0) {
+                start += receive_download(line + 5, server_fd, server_buffer + start, buffered - start);
+            } else if (*line != '\0') {
+                handle_server_response(line, server_fd);
+            }
         }
+
+        // Keep a partial message for the next read
+        buffered -= start;
+        memmove(server_buffer, server_buffer + start, buffered);
+        if (buffered == (int)sizeof(server_buffer) - 1) buffered = 0; // Overlong line: drop it
     }
 
     if (bytes_read <= 0) {
@@ -108,6 +123,49 @@ void main_communication_loop(int server_fd) {
     }
 }
 
+/**
+ * @brief Saves a file sent as "DATA:<name>:<bytes>" into the current
+ * directory. The first bytes may already be in the read buffer.
+ * @return How many bytes of `buffered` belonged to the file.
+ */
+int receive_download(char* header, int server_fd, const char* buffered, int buffered_len) {
+    char* colon = strrchr(header, ':');
+    if (colon == NULL) {
+        printf("Malformed response: DATA:%s\n", header);
+        return 0;
+    }
+    *colon = '\0';
+    long long remaining = atoll(colon + 1);
+
+    // Only ever write into the current directory
+    const char* name = strrchr(header, '/') ? strrchr(header, '/') + 1 : header;
+    if (*name == '\0' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) name = "download.dat";
+
+    FILE* file = fopen(name, "wb");
+    if (file == NULL) perror(name); // Still drain the bytes to stay in sync
+
+    long long total = remaining;
+    int used = (remaining < buffered_len) ? (int)remaining : buffered_len;
+    if (file != NULL) fwrite(buffered, 1, used, file);
+    remaining -= used;
+
+    char chunk[BUFFER_SIZE];
+    while (remaining > 0) {
+        int want = (remaining < (long long)sizeof(chunk)) ? (int)remaining : (int)sizeof(chunk);
+        int n = read(server_fd, chunk, want);
+        if (n <= 0) break;
+        if (file != NULL) fwrite(chunk, 1, n, file);
+        remaining -= n;
+    }
+
+    if (file != NULL) {
+        fclose(file);
+        if (remaining == 0) printf("Saved %lld bytes to %s\n", total, name);
+        else printf("Download of %s was cut short.\n", name);
+    }
+    return used;
+}
+
 /**
  * @brief Handles a single, newline-terminated message from the server.
  */
@@ -0,0 +1,323 @@
+/*
+ * ========================================
+ * command_mode.c
+ * =Description: Implementation of the one-line
+ * command mode (see command_mode.h).
+ *
+ * A command runs the same handler as its menu entry.
+ * Its arguments become a session script: the handler's
+ * read_line() calls return them in order, its prompts
+ * are dropped, and only its last response is sent, so
+ * an operation costs one round trip however many
+ * prompts the menu flow has. Logins take the same
+ * one-session-per-user lock as the menus.
+ * ========================================
+ */
+
+#include "command_mode.h"
+#include "server_logic.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <semaphore.h>
+
+// Roles a command is open to (bit mask)
+#define ROLE_NONE 0
+#define ROLE_CUSTOMER 1
+#define ROLE_EMPLOYEE 2
+#define ROLE_MANAGER 4
+#define ROLE_ADMIN 8
+
+// State of one command-mode connection
+struct CommandSession {
+    int socket_fd;
+    int role;            // ROLE_NONE until a login succeeds
+    int user_id;         // Account or employee ID
+    sem_t* session_sem;  // NULL for the admin, who has no session lock
+    struct SessionScript script;
+};
+
+// One operation; exactly one of run and run_as is set
+struct Command {
+    const char* name;
+    const char* usage;  // Arguments, answering the menu's prompts in order
+    int roles;
+    int args;
+    void (*run)(int client_socket);
+    void (*run_as)(int client_socket, int user_id); // Gets the logged-in ID
+    int logs_out;       // Ends the login afterwards, as the menu does
+};
+
+// --- Menu Entries Without a Handler of Their Own ---
+
+static void view_customer_transactions(int client_socket) {
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    handle_view_transactions(client_socket, atoi(g_read_buffer));
+}
+
+static void modify_customer(int client_socket) {
+    handle_modify_user_details(client_socket, 1);
+}
+
+static void modify_staff(int client_socket) {
+    handle_modify_user_details(client_socket, 2);
+}
+
+static void change_staff_password(int client_socket, int employee_id) {
+    handle_staff_password_change(client_socket, employee_id);
+}
+
+static const struct Command g_commands[] = {
+    // Customer
+    {"DEPOSIT", "<amount>", ROLE_CUSTOMER, 1, NULL, handle_deposit, 0},
+    {"WITHDRAW", "<amount>", ROLE_CUSTOMER, 1, NULL, handle_withdrawal, 0},
+    {"BALANCE", "", ROLE_CUSTOMER, 0, NULL, handle_balance_check, 0},
+    {"TRANSFER", "<dest_account_id> <amount>", ROLE_CUSTOMER, 2, NULL, handle_fund_transfer, 0},
+    {"LOAN", "<amount>", ROLE_CUSTOMER, 1, NULL, handle_loan_request, 0},
+    {"HISTORY", "", ROLE_CUSTOMER, 0, NULL, handle_view_transactions, 0},
+    {"CHANGE_PIN", "<new_pin>", ROLE_CUSTOMER, 1, NULL, handle_customer_password_change, 1},
+    {"FEEDBACK", "<text>", ROLE_CUSTOMER, 1, handle_submit_feedback, NULL, 0},
+    // Employee
+    {"CREATE_CUSTOMER", "<account_id> <name> <pin> <opening_balance>", ROLE_EMPLOYEE, 4, handle_create_customer, NULL, 0},
+    {"MODIFY_CUSTOMER", "<account_id> <new_name>", ROLE_EMPLOYEE | ROLE_ADMIN, 2, modify_customer, NULL, 0},
+    {"PROCESS_LOAN", "<loan_id> <1=approve|2=reject>", ROLE_EMPLOYEE, 2, NULL, handle_process_loan, 0},
+    {"ASSIGNED_LOANS", "", ROLE_EMPLOYEE, 0, NULL, handle_view_assigned_loans, 0},
+    {"CUSTOMER_HISTORY", "<account_id>", ROLE_EMPLOYEE, 1, view_customer_transactions, NULL, 0},
+    {"TRANSACTIONS_BY_DATE", "<account_id|0> <from> <to>", ROLE_EMPLOYEE | ROLE_MANAGER, 3,
+     handle_transactions_by_date, NULL, 0},
+    {"CHANGE_PASSWORD", "<new_password>", ROLE_EMPLOYEE | ROLE_MANAGER, 1, NULL, change_staff_password, 1},
+    // Manager
+    {"SET_ACCOUNT_STATUS", "<account_id> <1=activate|2=deactivate>", ROLE_MANAGER, 2, handle_set_account_status, NULL, 0},
+    {"ASSIGN_LOAN", "<loan_id> <employee_id>", ROLE_MANAGER, 2, handle_assign_loan, NULL, 0},
+    {"REVIEW_FEEDBACK", "", ROLE_MANAGER, 0, handle_review_feedback, NULL, 0},
+    {"BANK_TOTALS", "", ROLE_MANAGER, 0, handle_view_bank_totals, NULL, 0},
+    {"LIST_ACCOUNTS", "<first_account_id> <last_account_id>", ROLE_MANAGER, 2, handle_list_accounts, NULL, 0},
+    // Admin
+    {"CREATE_STAFF", "<employee_id> <first_name> <last_name> <password> <0=manager|1=employee>", ROLE_ADMIN, 5,
+     handle_create_staff, NULL, 0},
+    {"MODIFY_STAFF", "<employee_id> <first_name> <last_name>", ROLE_ADMIN, 3, modify_staff, NULL, 0},
+    {"SET_STAFF_ROLE", "<employee_id> <0=manager|1=employee>", ROLE_ADMIN, 2, handle_update_staff_role, NULL, 0},
+    {"LIST_STAFF", "<first_employee_id>", ROLE_ADMIN, 1, handle_list_staff, NULL, 0},
+    {"IMPORT_ACCOUNTS", "<server_file_path>", ROLE_ADMIN, 1, handle_import_accounts, NULL, 0},
+    {"CHANGE_ADMIN_PASS", "<new_password>", ROLE_ADMIN, 1, handle_change_admin_pass, NULL, 0},
+};
+#define COMMAND_COUNT ((int)(sizeof(g_commands) / sizeof(g_commands[0])))
+
+// --- Parsing ---
+
+/**
+ * @brief Menu choices are digits, so a line starting with a letter is a
+ * command.
+ */
+int is_command_line(const char* line) {
+    return isalpha((unsigned char)line[0]);
+}
+
+/**
+ * @brief Splits a command line in place at spaces; "double quotes" keep
+ * an argument's spaces.
+ * @return Number of words, or -1 if there are too many or a quote is
+ * not closed.
+ */
+static int split_command(char* line, char** words, int max_words) {
+    int count = 0;
+    char* p = line;
+    for (;;) {
+        p += strspn(p, " \t\r");
+        if (*p == '\0') return count;
+        if (count == max_words) return -1;
+        if (*p == '"') {
+            words[count++] = ++p;
+            p = strchr(p, '"');
+            if (p == NULL) return -1;
+        } else {
+            words[count++] = p;
+            p += strcspn(p, " \t\r");
+            if (*p == '\0') return count;
+        }
+        *p++ = '\0';
+    }
+}
+
+static const struct Command* find_command(const char* name) {
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        if (strcasecmp(g_commands[i].name, name) == 0) return &g_commands[i];
+    }
+    return NULL;
+}
+
+// --- Login ---
+
+static void command_logout(struct CommandSession* session) {
+    if (session->session_sem != NULL) release_session_lock(session->user_id, session->session_sem);
+    session->role = ROLE_NONE;
+    session->user_id = -1;
+    session->session_sem = NULL;
+}
+
+/**
+ * @brief LOGIN CUSTOMER|EMPLOYEE|MANAGER <id> <secret> or LOGIN ADMIN
+ * <password>, with the menus' checks and messages.
+ */
+static void command_login(struct CommandSession* session, char** words, int count) {
+    int socket_fd = session->socket_fd;
+    if (session->role != ROLE_NONE) { send_response(socket_fd, "ERROR", "Already logged in. Send LOGOUT first."); return; }
+
+    if (count == 3 && strcasecmp(words[1], "ADMIN") == 0) {
+        if (!login_admin(socket_fd, words[2])) { send_response(socket_fd, "ERROR", "Invalid password."); return; }
+        session->role = ROLE_ADMIN;
+        send_response(socket_fd, "SUCCESS", "Admin login successful.");
+        return;
+    }
+
+    int role = ROLE_NONE;
+    if (count == 4 && strcasecmp(words[1], "CUSTOMER") == 0) role = ROLE_CUSTOMER;
+    else if (count == 4 && strcasecmp(words[1], "EMPLOYEE") == 0) role = ROLE_EMPLOYEE;
+    else if (count == 4 && strcasecmp(words[1], "MANAGER") == 0) role = ROLE_MANAGER;
+    if (role == ROLE_NONE) {
+        send_response(socket_fd, "ERROR", "Usage: LOGIN CUSTOMER|EMPLOYEE|MANAGER <id> <secret>, or LOGIN ADMIN <password>");
+        return;
+    }
+
+    const char* failed = (role == ROLE_CUSTOMER) ? "Invalid ID, PIN, or inactive account." : "Invalid ID, password, or role.";
+    int id = atoi(words[2]);
+    if (id <= 0) { send_response(socket_fd, "ERROR", failed); return; }
+
+    sem_t* sem;
+    int locked = acquire_session_lock(id, &sem);
+    if (locked == -1) { send_response(socket_fd, "ERROR", "Server lock error."); return; }
+    if (locked == 1) {
+        send_response(socket_fd, "ERROR", (role == ROLE_CUSTOMER) ? "This account is already logged in elsewhere."
+                                                                  : "This ID is already logged in elsewhere.");
+        return;
+    }
+
+    int ok = (role == ROLE_CUSTOMER) ? login_customer(socket_fd, id, words[3])
+                                     : login_staff(socket_fd, id, words[3], (role == ROLE_EMPLOYEE) ? 1 : 0);
+    if (!ok) {
+        release_session_lock(id, sem);
+        send_response(socket_fd, "ERROR", failed);
+        return;
+    }
+    session->role = role;
+    session->user_id = id;
+    session->session_sem = sem;
+    send_response(socket_fd, "SUCCESS", "Login successful.");
+    watch_session_disconnect();
+}
+
+// --- Commands ---
+
+static void send_help(struct CommandSession* session) {
+    bzero(g_write_buffer, sizeof(g_write_buffer));
+    if (session->role == ROLE_NONE) {
+        strcat(g_write_buffer, "Commands:\\nLOGIN CUSTOMER|EMPLOYEE|MANAGER <id> <secret>\\nLOGIN ADMIN <password>\\n");
+    } else {
+        strcat(g_write_buffer, "Commands:\\n");
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            if (!(g_commands[i].roles & session->role)) continue;
+            char line[120];
+            snprintf(line, sizeof(line), "%s %s\\n", g_commands[i].name, g_commands[i].usage);
+            if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 40) strcat(g_write_buffer, line);
+        }
+        strcat(g_write_buffer, "LOGOUT\\n");
+    }
+    strcat(g_write_buffer, "HELP\\nEXIT");
+    send_response(session->socket_fd, "SUCCESS", g_write_buffer);
+}
+
+/**
+ * @brief Runs an operation's handler with its prompts answered from the
+ * arguments, then sends the handler's last response.
+ */
+static void run_command(struct CommandSession* session, const struct Command* command, char** args, int count) {
+    int socket_fd = session->socket_fd;
+    if (!(command->roles & session->role)) {
+        send_response(socket_fd, "ERROR", "Not available for this login. Send HELP for the list.");
+        return;
+    }
+    if (count != command->args) {
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Usage: %s %s", command->name, command->usage);
+        send_response(socket_fd, "ERROR", g_write_buffer);
+        return;
+    }
+
+    struct SessionScript* script = &session->script;
+    script->args = args;
+    script->count = count;
+    script->next = 0;
+    script->starved = 0;
+    script->reply_status = NULL;
+    set_session_script(script);
+    if (command->run != NULL) command->run(socket_fd);
+    else command->run_as(socket_fd, session->user_id);
+    set_session_script(NULL);
+
+    if (script->reply_status != NULL) send_response(socket_fd, script->reply_status, script->reply);
+    else send_response(socket_fd, "ERROR", script->starved ? "Missing arguments." : "Operation failed.");
+    if (command->logs_out) command_logout(session);
+}
+
+/**
+ * @brief Runs one command line.
+ * @return 0 to keep going, 1 once the client has sent EXIT.
+ */
+static int execute_line(struct CommandSession* session, char* line) {
+    char* words[COMMAND_MAX_ARGS + 1];
+    int count = split_command(line, words, COMMAND_MAX_ARGS + 1);
+    int socket_fd = session->socket_fd;
+
+    if (count == -1) { send_response(socket_fd, "ERROR", "Malformed command."); return 0; }
+    if (count == 0) return 0;
+
+    if (strcasecmp(words[0], "LOGIN") == 0) {
+        command_login(session, words, count);
+    } else if (strcasecmp(words[0], "LOGOUT") == 0) {
+        if (session->role == ROLE_NONE) { send_response(socket_fd, "ERROR", "Not logged in."); return 0; }
+        command_logout(session);
+        send_response(socket_fd, "SUCCESS", "Logged out successfully.");
+    } else if (strcasecmp(words[0], "EXIT") == 0) {
+        command_logout(session);
+        send_response(socket_fd, "LOGOUT", "Goodbye.");
+        return 1;
+    } else if (strcasecmp(words[0], "HELP") == 0) {
+        send_help(session);
+    } else {
+        const struct Command* command = find_command(words[0]);
+        if (command == NULL) send_response(socket_fd, "ERROR", "Unknown command. Send HELP for the list.");
+        else run_command(session, command, words + 1, count - 1);
+    }
+    return 0;
+}
+
+// --- Session ---
+
+/**
+ * @brief Serves command lines, starting with `first_line` (read at the
+ * main menu), until EXIT or disconnect. Replies go out when the session
+ * next waits for input, so pipelined commands share one write().
+ */
+void handle_command_session(int client_socket, const char* first_line) {
+    struct CommandSession session;
+    char line[1024];
+    memset(&session, 0, sizeof(session));
+    session.socket_fd = client_socket;
+    session.user_id = -1;
+
+    printf("Client switched to command mode.\n");
+    snprintf(line, sizeof(line), "%s", first_line);
+    int done = execute_line(&session, line);
+    while (!done) {
+        int len = read_line(client_socket, line, sizeof(line));
+        // A blank line also reads as 0; only a closed connection has no input after it
+        if (len < 0 || (len == 0 && peek_input(client_socket) == -1)) break;
+        done = execute_line(&session, line);
+    }
+
+    command_logout(&session);
+    free(session.script.reply);
+}
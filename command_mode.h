@@ -0,0 +1,33 @@
+/*
+ * ========================================
+ * command_mode.h
+ * =Description: One-line command mode for automated
+ * clients. Instead of walking the menus, a client
+ * sends one line per operation, e.g.
+ *   LOGIN CUSTOMER 101 1111
+ *   TRANSFER 102 50.00
+ * and gets exactly one [STATUS]:[Message] line back.
+ * - A main-menu line that starts with a letter (menu
+ *   choices are digits) switches the connection to
+ *   command mode; no menus or prompts are sent after it
+ * - Arguments are separated by spaces; an argument
+ *   with spaces is written in double quotes
+ * - Each command runs the menu's own handler, with its
+ *   prompts answered from the arguments in order
+ * - HELP lists the commands of the current login
+ * - Statement export stays menu-only: its DATA reply
+ *   carries the file, which would break the one-line
+ *   reply per command
+ * ========================================
+ */
+
+#ifndef COMMAND_MODE_H
+#define COMMAND_MODE_H
+
+#define COMMAND_MAX_ARGS 8
+
+// --- Session ---
+int is_command_line(const char* line);
+void handle_command_session(int client_socket, const char* first_line);
+
+#endif // COMMAND_MODE_H
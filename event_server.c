@@ -0,0 +1,340 @@
+/*
+ * ========================================
+ * event_server.c
+ * =Description: Implementation of the event-driven
+ * server mode.
+ *
+ * A worker alternates between its scheduler context
+ * and its sessions. Socket I/O is nonblocking; on
+ * EAGAIN send_response()/read_line() call the wait
+ * hook, which arms a one-shot epoll watch and switches
+ * back to the scheduler. epoll_wait() later hands the
+ * session back and it retries where it left off.
+ * Shared locks held across prompts are taken with
+ * trylock and the yield hook, since their holder may
+ * be parked on the same thread.
+ * ========================================
+ */
+
+#include "event_server.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define SESSION_STACK_SIZE (256 * 1024)
+#define EVENT_BATCH 64
+#define YIELD_RETRY_MS 1 // Poll interval while only lock waiters are runnable
+#define STOP_CHECK_MS 1000 // A stoppable worker looks at its flag at least this often
+
+// One client connection
+struct Session {
+    ucontext_t context;
+    int socket_fd;
+    int watched;          // socket_fd is in the worker's epoll set
+    int finished;
+    char* stack;          // Guard page, then SESSION_STACK_SIZE bytes
+    struct SessionBuffers buffers;
+    struct Session* next; // Run queue link
+};
+
+struct Worker {
+    pthread_t thread;
+    int epoll_fd;
+    int listen_fd;                 // -1 once the worker stops accepting
+    long accepted;
+    long max_sessions;             // Stop accepting after this many (0: never)
+    int live;                      // Sessions not yet ended
+    volatile sig_atomic_t* running; // Stop accepting once it drops to 0 (NULL: never)
+    void (*retire)(void);          // Called when the worker stops accepting
+    ucontext_t scheduler;
+    struct Session* current;       // NULL while the scheduler runs
+    struct Session* ready_head;
+    struct Session* ready_tail;
+    int ready_io;                  // Queued sessions include ones with work to do
+};
+
+static void (*g_serve)(int client_socket) = NULL;
+static __thread struct Worker* t_worker = NULL;
+
+// --- Run Queue ---
+
+static void make_ready(struct Worker* worker, struct Session* session, int has_io) {
+    session->next = NULL;
+    if (worker->ready_tail != NULL) worker->ready_tail->next = session;
+    else worker->ready_head = session;
+    worker->ready_tail = session;
+    if (has_io) worker->ready_io = 1;
+}
+
+/**
+ * @brief Switches from the running session back to its scheduler.
+ */
+static void suspend_session(void) {
+    struct Worker* worker = t_worker;
+    swapcontext(&worker->current->context, &worker->scheduler);
+}
+
+// --- Session Hooks ---
+
+static void session_wait(int socket_fd, int writable) {
+    struct Worker* worker = t_worker;
+    struct Session* session = (worker != NULL) ? worker->current : NULL;
+    struct epoll_event event = {(writable ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT, {.ptr = session}};
+    if (session == NULL || session->socket_fd != socket_fd) {
+        // Not a session's own socket: block the thread, as a forked session would
+        struct epoll_event ignored;
+        int fd = epoll_create1(EPOLL_CLOEXEC);
+        if (fd == -1) return;
+        event.events &= ~EPOLLONESHOT;
+        if (epoll_ctl(fd, EPOLL_CTL_ADD, socket_fd, &event) == 0) epoll_wait(fd, &ignored, 1, -1);
+        close(fd);
+        return;
+    }
+
+    int op = session->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(worker->epoll_fd, op, socket_fd, &event) == -1) {
+        return; // The retried call fails again and ends the session
+    }
+    session->watched = 1;
+    suspend_session();
+}
+
+static void session_yield(void) {
+    struct Worker* worker = t_worker;
+    if (worker == NULL || worker->current == NULL) {
+        sched_yield();
+        return;
+    }
+    make_ready(worker, worker->current, 0);
+    suspend_session();
+}
+
+static void session_end(int socket_fd) {
+    t_worker->current->finished = 1;
+    suspend_session(); // Never resumed
+}
+
+static const struct SessionHooks g_event_hooks = {session_wait, session_yield, session_end};
+
+// --- Sessions ---
+
+static void session_main(void) {
+    struct Session* session = t_worker->current;
+    g_serve(session->socket_fd);
+    end_client_session(session->socket_fd); // Flushes, then comes back through session_end()
+}
+
+/**
+ * @brief Points a fresh context at session_main() on its own stack.
+ */
+static void prepare_context(ucontext_t* context, char* stack) {
+    getcontext(context);
+    context->uc_stack.ss_sp = stack;
+    context->uc_stack.ss_size = SESSION_STACK_SIZE;
+    context->uc_link = NULL;
+    makecontext(context, session_main, 0);
+}
+
+static struct Session* create_session(int socket_fd) {
+    struct Session* session = calloc(1, sizeof(*session));
+    if (session == NULL) return NULL;
+
+    long page = sysconf(_SC_PAGESIZE);
+    session->stack = mmap(NULL, SESSION_STACK_SIZE + page, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (session->stack == MAP_FAILED) {
+        free(session);
+        return NULL;
+    }
+    mprotect(session->stack, page, PROT_NONE); // An overflow faults instead of corrupting the heap
+    prepare_context(&session->context, session->stack + page);
+    session->socket_fd = socket_fd;
+    return session;
+}
+
+static void destroy_session(struct Worker* worker, struct Session* session) {
+    worker->live--;
+    close(session->socket_fd); // Also drops it from the epoll set
+    munmap(session->stack, SESSION_STACK_SIZE + sysconf(_SC_PAGESIZE));
+    free(session);
+}
+
+/**
+ * @brief Runs a session until it parks, yields, or ends.
+ */
+static void resume_session(struct Worker* worker, struct Session* session) {
+    worker->current = session;
+    g_session_buffers = &session->buffers;
+    swapcontext(&worker->scheduler, &session->context);
+    worker->current = NULL;
+    if (session->finished) destroy_session(worker, session);
+}
+
+static void start_session(struct Worker* worker, int client_fd) {
+    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+
+    struct Session* session = create_session(client_fd);
+    if (session == NULL) {
+        perror("event server: session allocation failed");
+        close(client_fd);
+        return;
+    }
+    worker->live++;
+    make_ready(worker, session, 1);
+}
+
+/**
+ * @brief Drops the worker's listener. Connections still queued on it
+ * stay with whoever else holds the socket.
+ */
+static void stop_accepting(struct Worker* worker) {
+    if (worker->retire != NULL) worker->retire();
+    // Explicitly: the epoll entry lives as long as any process holds the socket
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, worker->listen_fd, NULL);
+    close(worker->listen_fd);
+    worker->listen_fd = -1;
+}
+
+/**
+ * @brief Accepts every pending connection; each starts as a new session.
+ */
+static void accept_sessions(struct Worker* worker) {
+    while (worker->listen_fd != -1) {
+        int client_fd = accept(worker->listen_fd, NULL, NULL);
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("event server: accept failed");
+            return;
+        }
+        start_session(worker, client_fd);
+        if (worker->max_sessions > 0 && ++worker->accepted >= worker->max_sessions) stop_accepting(worker);
+    }
+}
+
+// --- Workers ---
+
+static int watch_listener(struct Worker* worker) {
+    struct epoll_event event = {EPOLLIN | EPOLLEXCLUSIVE, {.ptr = NULL}};
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epoll_fd == -1 || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &event) == -1) {
+        perror("event server: epoll setup failed");
+        if (worker->epoll_fd != -1) close(worker->epoll_fd);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief The scheduler. Runs until the worker has stopped accepting and
+ * its last session has ended (a pool thread never stops accepting).
+ */
+static void* worker_main(void* arg) {
+    struct Worker* worker = arg;
+    struct epoll_event events[EVENT_BATCH];
+    t_worker = worker;
+
+    while (worker->listen_fd != -1 || worker->live > 0) {
+        if (worker->running != NULL && !*worker->running && worker->listen_fd != -1) stop_accepting(worker);
+
+        int timeout = worker->ready_io ? 0 : (worker->ready_head != NULL ? YIELD_RETRY_MS : -1);
+        if (timeout == -1 && worker->running != NULL) timeout = STOP_CHECK_MS;
+        int n = epoll_wait(worker->epoll_fd, events, EVENT_BATCH, timeout);
+        if (n == -1 && errno != EINTR) {
+            perror("event server: epoll_wait failed");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) accept_sessions(worker);
+            else make_ready(worker, events[i].data.ptr, 1);
+        }
+
+        // Sessions queued while this batch runs wait for the next pass
+        struct Session* batch = worker->ready_head;
+        worker->ready_head = worker->ready_tail = NULL;
+        worker->ready_io = 0;
+        while (batch != NULL) {
+            struct Session* session = batch;
+            batch = session->next;
+            resume_session(worker, session);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Serves connections on `listen_fd` (already listening and
+ * nonblocking) with a pool of worker threads, and returns once
+ * `*running` drops to 0. The workers are left running: the caller is
+ * expected to exit the process.
+ * @return 0 on shutdown, -1 if the pool could not start.
+ */
+int event_server_run(int listen_fd, int workers, void (*serve)(int client_socket),
+                     volatile sig_atomic_t* running) {
+    if (workers < 1) workers = 1;
+    if (workers > EVENT_MAX_WORKERS) workers = EVENT_MAX_WORKERS;
+    g_serve = serve;
+    set_session_hooks(&g_event_hooks);
+
+    struct Worker* pool = calloc((size_t)workers, sizeof(*pool));
+    if (pool == NULL) return -1;
+
+    // Signals are handled by the calling thread alone
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        struct Worker* worker = &pool[i];
+        worker->listen_fd = listen_fd;
+        if (watch_listener(worker) == -1) break;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            perror("event server: worker thread failed");
+            close(worker->epoll_fd);
+            break;
+        }
+        started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (started == 0) return -1;
+
+    while (*running) pause();
+    return 0;
+}
+
+/**
+ * @brief Serves connections on `listen_fd` (already listening and
+ * nonblocking) on the calling thread alone. The worker stops accepting
+ * after `max_sessions` connections (0: no limit) or once `*running`
+ * drops to 0, calls `retire` (may be NULL), closes its descriptor of
+ * the listener, and returns when its last session has ended. Used by each process of
+ * the pre-forked server.
+ * @return 0 once drained, -1 if the worker could not start.
+ */
+int event_worker_run(int listen_fd, long max_sessions, void (*serve)(int client_socket),
+                     volatile sig_atomic_t* running, void (*retire)(void)) {
+    static struct Worker worker;
+    g_serve = serve;
+    set_session_hooks(&g_event_hooks);
+
+    worker.listen_fd = listen_fd;
+    worker.max_sessions = max_sessions;
+    worker.running = running;
+    worker.retire = retire;
+    if (watch_listener(&worker) == -1) return -1;
+    worker_main(&worker);
+    close(worker.epoll_fd);
+    return 0;
+}
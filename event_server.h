@@ -0,0 +1,35 @@
+/*
+ * ========================================
+ * event_server.h
+ * =Description: Event-driven server mode. A fixed
+ * pool of worker threads serves every connection
+ * instead of one forked process per client.
+ * - Each worker owns an epoll instance; the listening
+ *   socket is in all of them with EPOLLEXCLUSIVE, so
+ *   one worker wakes per incoming connection
+ * - Each session is a coroutine (ucontext) with its
+ *   own stack, pinned to the worker that accepted it
+ * - A session that would block on its socket parks in
+ *   epoll and the worker runs the others meanwhile, so
+ *   the menu handlers stay written as blocking code
+ * - event_worker_run() runs one such scheduler on the
+ *   calling thread; the pre-forked server runs one in
+ *   each of its worker processes
+ * ========================================
+ */
+
+#ifndef EVENT_SERVER_H
+#define EVENT_SERVER_H
+
+#include <signal.h> // For sig_atomic_t
+
+#define EVENT_DEFAULT_WORKERS 8
+#define EVENT_MAX_WORKERS 256
+
+// --- Server ---
+int event_server_run(int listen_fd, int workers, void (*serve)(int client_socket),
+                     volatile sig_atomic_t* running);
+int event_worker_run(int listen_fd, long max_sessions, void (*serve)(int client_socket),
+                     volatile sig_atomic_t* running, void (*retire)(void));
+
+#endif // EVENT_SERVER_H
@@ -0,0 +1,340 @@
+/*
+ * ========================================
+ * journal.c
+ * =Description: Implementation of the group-commit
+ * journal (leader/follower, no extra process).
+ *
+ * Sequence numbers:
+ * - next_seq:    next record to be queued
+ * - durable_seq: every record below it was written,
+ *                or its batch failed
+ * Ring slot for seq s is s % capacity. A leader copies
+ * [durable_seq, next_seq) out of the ring, drops the
+ * lock for the I/O and advances durable_seq afterwards.
+ * A failed batch is flagged in its slots, and a slot is
+ * not reused until its appender has read the flag, so
+ * every appender gets its own batch's result however
+ * many batches complete before it wakes.
+ * Records are written with pwrite at fixed offsets, so
+ * a new leader can safely redo a batch whose leader
+ * died mid-flush.
+ * ========================================
+ */
+
+#include "journal.h"
+#include "uring.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define LEADER_CHECK_US 100000 // Followers re-check a silent leader this often
+
+// Per-slot bookkeeping for the record queued there
+struct JournalSlot {
+    pid_t owner;  // Process that queued the record
+    int failed;   // Its batch failed and the appender has not been told yet
+};
+
+// Shared state, followed by the ring buffer
+struct Journal {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // Batch filled, batch durable, or ring space freed
+    struct JournalConfig config;
+    journal_commit_fn on_commit;
+    journal_write_fn write;     // NULL: pwrite to fd
+    int fd;                     // Opened by the parent, inherited by children (-1 with a writer)
+    size_t record_size;
+    int capacity;
+    long next_seq;
+    long durable_seq;
+    long next_record;           // Record number the next batch starts at
+    pid_t leader_pid;           // 0 when no flush is running
+    struct JournalSlot slots[JOURNAL_RING_CAPACITY];
+    char ring[];
+};
+
+struct Journal* g_transaction_journal = NULL;
+struct Journal* g_wal_journal = NULL;
+
+// Per-thread scratch buffer for the leader's batch copy, sized for the
+// largest journal this thread has led (the journals' records differ)
+static __thread char* g_batch_buffer = NULL;
+static __thread size_t g_batch_capacity = 0;
+
+/**
+ * @brief Allocates the journal in shared memory. Batches are handed to
+ * `write` (which owns placement and syncing) instead of a single file.
+ */
+struct Journal* journal_create_with_writer(size_t record_size, long next_record,
+                                           const struct JournalConfig* config,
+                                           journal_write_fn write, journal_commit_fn on_commit) {
+    struct Journal* journal = create_shared_region(sizeof(struct Journal) + JOURNAL_RING_CAPACITY * record_size);
+    if (journal == NULL) return NULL;
+
+    init_shared_mutex(&journal->lock);
+    init_shared_cond(&journal->cond);
+    journal->config = *config;
+    if (journal->config.batch_size < 1) journal->config.batch_size = 1;
+    if (journal->config.batch_size > JOURNAL_RING_CAPACITY) journal->config.batch_size = JOURNAL_RING_CAPACITY;
+    journal->on_commit = on_commit;
+    journal->write = write;
+    journal->fd = -1;
+    journal->record_size = record_size;
+    journal->capacity = JOURNAL_RING_CAPACITY;
+    journal->next_record = next_record;
+    return journal;
+}
+
+/**
+ * @brief Allocates the journal in shared memory and opens its file.
+ * Records already in the file are kept; new ones are appended after them.
+ */
+struct Journal* journal_create(const char* path, size_t record_size,
+                               const struct JournalConfig* config, journal_commit_fn on_commit) {
+    int fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("journal: open failed");
+        return NULL;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    struct Journal* journal = journal_create_with_writer(record_size, st.st_size / (off_t)record_size,
+                                                         config, NULL, on_commit);
+    if (journal == NULL) {
+        close(fd);
+        return NULL;
+    }
+    journal->fd = fd;
+    return journal;
+}
+
+/**
+ * @brief Returns 1 if the current leader process no longer exists.
+ */
+static int leader_is_dead(const struct Journal* journal) {
+    return journal->leader_pid != 0 && kill(journal->leader_pid, 0) == -1 && errno == ESRCH;
+}
+
+/**
+ * @brief Returns 1 while the slot for `seq` holds a failed record its
+ * appender has not picked up. Clears the flag if that appender has died.
+ */
+static int slot_unreported(struct Journal* journal, long seq) {
+    struct JournalSlot* slot = &journal->slots[seq % journal->capacity];
+    if (slot->failed && kill(slot->owner, 0) == -1 && errno == ESRCH) slot->failed = 0;
+    return slot->failed;
+}
+
+/**
+ * @brief Flags every record of the batch [start, end) as not written.
+ */
+static void mark_failed(struct Journal* journal, long start, long end) {
+    for (long seq = start; seq < end; seq++) {
+        journal->slots[seq % journal->capacity].failed = 1;
+    }
+}
+
+/**
+ * @brief Writes a batch at `first_record` (+ sync) and runs the commit
+ * hook. Called without the lock.
+ * @return 1 on success, 0 on failure.
+ */
+static int write_batch(struct Journal* journal, long first_record, const void* records, int count) {
+    int ok;
+    if (journal->write != NULL) {
+        ok = (journal->write(first_record, records, count, journal->config.sync_on_commit) == 0);
+    } else {
+        // The write and its fdatasync go to the kernel as one linked submission
+        size_t bytes = (size_t)count * journal->record_size;
+        struct UringOp ops[2] = {
+            {URING_WRITE, journal->fd, (void*)records, bytes, (off_t)first_record * journal->record_size, 1, 0},
+            {URING_FDATASYNC, journal->fd, NULL, 0, 0, 0, 0},
+        };
+        ok = (uring_run(ops, journal->config.sync_on_commit ? 2 : 1) == 0);
+    }
+    if (ok && journal->on_commit != NULL) {
+        journal->on_commit(first_record, records, count);
+    }
+    if (!ok) perror("journal: batch write failed");
+    return ok;
+}
+
+/**
+ * @brief Writes everything queued as one batch. Called with the lock
+ * held; drops it for the duration of the I/O. Always advances
+ * durable_seq to the end of the batch, flagging it if it failed.
+ */
+static void flush_batch(struct Journal* journal) {
+    // Optionally let the batch fill before writing it
+    if (journal->config.flush_interval_us > 0 &&
+        journal->next_seq - journal->durable_seq < journal->config.batch_size) {
+        wait_shared_cond(&journal->cond, &journal->lock, journal->config.flush_interval_us);
+    }
+
+    long start = journal->durable_seq;
+    long end = journal->next_seq;
+    int count = (int)(end - start);
+    if (count == 0) return;
+
+    size_t needed = (size_t)journal->capacity * journal->record_size;
+    if (g_batch_capacity < needed) {
+        char* grown = realloc(g_batch_buffer, needed);
+        if (grown == NULL) {
+            // Fail the batch rather than leave it queued for a retry that fails the same way
+            perror("journal: batch buffer allocation failed");
+            mark_failed(journal, start, end);
+            journal->durable_seq = end;
+            return;
+        }
+        g_batch_buffer = grown;
+        g_batch_capacity = needed;
+    }
+
+    // Copy out of the ring, handling wrap-around
+    int first_slot = (int)(start % journal->capacity);
+    int head_count = (first_slot + count <= journal->capacity) ? count : journal->capacity - first_slot;
+    memcpy(g_batch_buffer, journal->ring + first_slot * journal->record_size, head_count * journal->record_size);
+    memcpy(g_batch_buffer + head_count * journal->record_size, journal->ring, (count - head_count) * journal->record_size);
+
+    long first_record = journal->next_record;
+    pthread_mutex_unlock(&journal->lock);
+
+    int ok = write_batch(journal, first_record, g_batch_buffer, count);
+
+    lock_shared_mutex(&journal->lock);
+    if (ok) {
+        journal->next_record += count;
+    } else {
+        mark_failed(journal, start, end);
+    }
+    journal->durable_seq = end;
+}
+
+/**
+ * @brief Queues one record and blocks until it is durable.
+ * @return 0 once the record is on file, -1 if it could not be written.
+ */
+int journal_append(struct Journal* journal, const void* record) {
+    if (lock_shared_mutex(&journal->lock) == -1) return -1;
+
+    // Wait for ring space, and for the next slot's previous appender to
+    // pick up a failure flagged there
+    for (;;) {
+        if (leader_is_dead(journal)) journal->leader_pid = 0;
+        if (journal->next_seq - journal->durable_seq >= journal->capacity) {
+            if (journal->leader_pid == 0) break; // Become leader below and drain
+        } else if (!slot_unreported(journal, journal->next_seq)) {
+            break;
+        }
+        wait_shared_cond(&journal->cond, &journal->lock, LEADER_CHECK_US);
+    }
+
+    long my_seq = journal->next_seq;
+    if (my_seq - journal->durable_seq < journal->capacity) {
+        journal->slots[my_seq % journal->capacity].owner = getpid();
+        memcpy(journal->ring + (my_seq % journal->capacity) * journal->record_size, record, journal->record_size);
+        journal->next_seq++;
+        if (journal->next_seq - journal->durable_seq >= journal->config.batch_size) {
+            pthread_cond_broadcast(&journal->cond); // Wake a leader waiting for the batch to fill
+        }
+    } else {
+        my_seq = -1; // Ring full: drain as leader first, then retry
+    }
+
+    while (my_seq == -1 || journal->durable_seq <= my_seq) {
+        if (leader_is_dead(journal)) journal->leader_pid = 0;
+
+        if (journal->leader_pid == 0) {
+            journal->leader_pid = getpid();
+            flush_batch(journal);
+            journal->leader_pid = 0;
+            pthread_cond_broadcast(&journal->cond);
+            if (my_seq == -1) {
+                pthread_mutex_unlock(&journal->lock);
+                return journal_append(journal, record);
+            }
+        } else {
+            wait_shared_cond(&journal->cond, &journal->lock, LEADER_CHECK_US);
+        }
+    }
+
+    struct JournalSlot* slot = &journal->slots[my_seq % journal->capacity];
+    int rc = 0;
+    if (slot->failed) {
+        rc = -1;
+        slot->failed = 0;
+        pthread_cond_broadcast(&journal->cond); // The slot can be reused now
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return rc;
+}
+
+/**
+ * @brief Writes `count` records as one contiguous batch and returns once
+ * they are durable. The caller becomes leader, drains whatever is
+ * queued ahead of it, then writes the batch straight from its buffer
+ * (it does not pass through the ring). Used for bulk loads.
+ * @return 0 once the batch is on file, -1 if it could not be written.
+ */
+int journal_append_batch(struct Journal* journal, const void* records, int count) {
+    if (lock_shared_mutex(&journal->lock) == -1) return -1;
+
+    for (;;) {
+        if (leader_is_dead(journal)) journal->leader_pid = 0;
+        if (journal->leader_pid == 0) break;
+        wait_shared_cond(&journal->cond, &journal->lock, LEADER_CHECK_US);
+    }
+    journal->leader_pid = getpid();
+    while (journal->durable_seq != journal->next_seq) {
+        flush_batch(journal);
+    }
+
+    long first_record = journal->next_record;
+    pthread_mutex_unlock(&journal->lock);
+
+    int ok = write_batch(journal, first_record, records, count);
+
+    lock_shared_mutex(&journal->lock);
+    if (ok) journal->next_record += count;
+    journal->leader_pid = 0;
+    pthread_cond_broadcast(&journal->cond);
+    pthread_mutex_unlock(&journal->lock);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Returns the number of records written to the journal file.
+ */
+long journal_record_count(struct Journal* journal) {
+    if (lock_shared_mutex(&journal->lock) == -1) return -1;
+    long count = journal->next_record;
+    pthread_mutex_unlock(&journal->lock);
+    return count;
+}
+
+/**
+ * @brief Empties the journal file so the next batch starts at record 0.
+ * Only valid while no append is queued or in flight.
+ * @return 0 on success, -1 if records are still pending or I/O failed.
+ */
+int journal_reset(struct Journal* journal) {
+    if (lock_shared_mutex(&journal->lock) == -1) return -1;
+
+    int rc = -1;
+    if (journal->fd != -1 && journal->durable_seq == journal->next_seq &&
+        ftruncate(journal->fd, 0) == 0 && fdatasync(journal->fd) == 0) {
+        journal->next_record = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return rc;
+}
@@ -0,0 +1,60 @@
+/*
+ * ========================================
+ * journal.h
+ * =Description: Group-commit journal for append-only
+ * files of fixed-size records (e.g. wal.log, or the
+ * segmented transaction log through a write hook).
+ * Sessions in every child queue records in shared
+ * memory; whichever caller finds no flush running
+ * becomes the leader and writes the whole batch with
+ * a single pwrite (plus one fdatasync), then wakes
+ * everyone whose record it made durable.
+ * ========================================
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+
+// --- Defaults ---
+#define JOURNAL_RING_CAPACITY 1024       // Queued records before appenders wait
+#define JOURNAL_DEFAULT_INTERVAL_US 0    // Leader does not wait for a batch to fill
+#define JOURNAL_DEFAULT_BATCH_SIZE 64    // Queued records that end the wait early
+
+// Flush tuning, chosen at server startup
+struct JournalConfig {
+    long flush_interval_us; // How long a leader waits for more records
+    int batch_size;         // Flush immediately once this many are queued
+    int sync_on_commit;     // fdatasync each batch before acknowledging
+};
+
+// Called by the leader after a batch is on file (before acknowledging)
+typedef void (*journal_commit_fn)(long first_record, const void* records, int count);
+
+// Optional replacement for the built-in pwrite (+ fdatasync) of a batch
+typedef int (*journal_write_fn)(long first_record, const void* records, int count, int sync);
+
+// Opaque handle; the shared layout lives in journal.c
+struct Journal;
+
+// --- Journal Lifecycle (parent, before fork) ---
+struct Journal* journal_create(const char* path, size_t record_size,
+                               const struct JournalConfig* config, journal_commit_fn on_commit);
+struct Journal* journal_create_with_writer(size_t record_size, long next_record,
+                                           const struct JournalConfig* config,
+                                           journal_write_fn write, journal_commit_fn on_commit);
+
+// --- Appending ---
+int journal_append(struct Journal* journal, const void* record);
+int journal_append_batch(struct Journal* journal, const void* records, int count);
+
+// --- Maintenance (callers must have stopped all appenders) ---
+long journal_record_count(struct Journal* journal);
+int journal_reset(struct Journal* journal);
+
+// --- Shared Journal Instances (created in server.c) ---
+extern struct Journal* g_transaction_journal;
+extern struct Journal* g_wal_journal;
+
+#endif // JOURNAL_H
@@ -0,0 +1,423 @@
+/*
+ * ========================================
+ * ledger.c
+ * =Description: Implementation of the bank-wide
+ * money operations.
+ *
+ * Aggregation maps each data file read-only and makes
+ * one sequential pass over it. Balances and loan
+ * amounts are aligned int64 fields summed with integer
+ * adds (exact, unlike the old doubles). accounts.dat
+ * holds only 16-byte AccountState records, so the AVX2
+ * kernel reads two per plain load; loan amounts are
+ * gathered four records per step. CPUs
+ * without AVX2, or builds with -DLEDGER_NO_SIMD, use
+ * the scalar loop. No record locks are taken: totals
+ * can be one in-flight operation off while sessions
+ * are writing, which is fine for a report.
+ * ========================================
+ */
+
+#include "ledger.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if !defined(LEDGER_NO_SIMD) && defined(__x86_64__) && defined(__GNUC__)
+#define LEDGER_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#define CONVERT_BATCH 1024
+#define STAGED_SUFFIX ".cents" // Converted copies waiting for the format switch
+
+// --- Data Format ---
+
+static void sync_dir(const char* dir) {
+    int fd = open(dir, O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static off_t file_size(const char* path) {
+    struct stat st;
+    return (stat(path, &st) == 0) ? st.st_size : 0;
+}
+
+/**
+ * @brief Returns the format version of the account and loan files.
+ * Data files without a format file predate money_t (version 1).
+ */
+int ledger_data_format(void) {
+    int fd = open(DATA_FORMAT_FILE, O_RDONLY);
+    if (fd == -1) {
+        if (errno != ENOENT) return -1;
+        return (file_size(ACCOUNT_DB_FILE) > 0 || file_size(LOAN_DB_FILE) > 0) ? 1 : DATA_FORMAT_VERSION;
+    }
+    int version = -1;
+    if (read(fd, &version, sizeof(version)) != sizeof(version)) version = -1;
+    close(fd);
+    return version;
+}
+
+/**
+ * @brief Atomically records the data format version.
+ */
+static int write_data_format(int version) {
+    const char* temp_path = DATA_FORMAT_FILE ".tmp";
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return -1;
+    int ok = write(fd, &version, sizeof(version)) == sizeof(version) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temp_path, DATA_FORMAT_FILE) == -1) return -1;
+    sync_dir(".");
+    return 0;
+}
+
+/**
+ * @brief Writes `path`.cents: a copy of `path` whose int64 field at
+ * `field_offset` is converted from a double to cents.
+ */
+static int convert_money_field(const char* path, size_t record_size, size_t field_offset) {
+    char temp_path[64];
+    snprintf(temp_path, sizeof(temp_path), "%s" STAGED_SUFFIX, path);
+    int in_fd = open(path, O_RDONLY);
+    if (in_fd == -1) return (errno == ENOENT) ? 0 : -1;
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char* batch = malloc(CONVERT_BATCH * record_size);
+    int ok = (fd != -1 && batch != NULL);
+
+    for (off_t offset = 0; ok; ) {
+        ssize_t got = pread(in_fd, batch, CONVERT_BATCH * record_size, offset);
+        if (got <= 0) {
+            ok = (got == 0);
+            break;
+        }
+        size_t records = (size_t)got / record_size;
+        for (size_t i = 0; i < records; i++) {
+            double value;
+            money_t cents;
+            memcpy(&value, batch + i * record_size + field_offset, sizeof(value));
+            cents = money_to_cents(value);
+            memcpy(batch + i * record_size + field_offset, &cents, sizeof(cents));
+        }
+        ok = pwrite(fd, batch, got, offset) == got; // A torn trailing record is copied as is
+        offset += got;
+    }
+    ok = ok && fsync(fd) == 0;
+    free(batch);
+    close(in_fd);
+    if (fd != -1) close(fd);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Writes accounts.dat.cents and account_profiles.dat.cents: the
+ * hot and cold halves of every record of a pre-format-3 accounts.dat.
+ * Version-1 balances are converted from double to cents on the way.
+ * A torn trailing record cannot be split and is dropped.
+ */
+static int split_account_file(int format) {
+    int in_fd = open(ACCOUNT_DB_FILE, O_RDONLY);
+    if (in_fd == -1) return (errno == ENOENT) ? 0 : -1;
+    int state_fd = open(ACCOUNT_DB_FILE STAGED_SUFFIX, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int profile_fd = open(ACCOUNT_PROFILE_FILE STAGED_SUFFIX, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    struct CustomerAccount* batch = malloc(CONVERT_BATCH * sizeof(*batch));
+    struct AccountState* states = malloc(CONVERT_BATCH * sizeof(*states));
+    struct AccountProfile* profiles = malloc(CONVERT_BATCH * sizeof(*profiles));
+    int ok = (state_fd != -1 && profile_fd != -1 && batch != NULL && states != NULL && profiles != NULL);
+
+    for (off_t done = 0; ok; ) {
+        ssize_t got = pread(in_fd, batch, CONVERT_BATCH * sizeof(*batch), done * (off_t)sizeof(*batch));
+        size_t records = (got > 0) ? (size_t)got / sizeof(*batch) : 0;
+        if (records == 0) {
+            ok = (got >= 0);
+            break;
+        }
+        for (size_t i = 0; i < records; i++) {
+            if (format == 1) {
+                double value;
+                memcpy(&value, &batch[i].balance, sizeof(value));
+                batch[i].balance = money_to_cents(value);
+            }
+            split_account(&batch[i], &states[i], &profiles[i]);
+        }
+        ok = pwrite(state_fd, states, records * sizeof(*states), done * (off_t)sizeof(*states)) ==
+                 (ssize_t)(records * sizeof(*states)) &&
+             pwrite(profile_fd, profiles, records * sizeof(*profiles), done * (off_t)sizeof(*profiles)) ==
+                 (ssize_t)(records * sizeof(*profiles));
+        done += records;
+    }
+    ok = ok && fsync(state_fd) == 0 && fsync(profile_fd) == 0;
+    free(batch);
+    free(states);
+    free(profiles);
+    close(in_fd);
+    if (state_fd != -1) close(state_fd);
+    if (profile_fd != -1) close(profile_fd);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Moves converted files into place (after the format file has
+ * been switched, so a crash in between is finished on the next start).
+ */
+static int install_converted(const char* path) {
+    char temp_path[64];
+    snprintf(temp_path, sizeof(temp_path), "%s" STAGED_SUFFIX, path);
+    if (rename(temp_path, path) == -1 && errno != ENOENT) return -1;
+    return 0;
+}
+
+static int install_all_converted(void) {
+    if (install_converted(ACCOUNT_DB_FILE) == -1 || install_converted(ACCOUNT_PROFILE_FILE) == -1 ||
+        install_converted(LOAN_DB_FILE) == -1) {
+        return -1;
+    }
+    sync_dir(".");
+    return 0;
+}
+
+/**
+ * @brief Upgrades the data files to the current format:
+ * - version 1 (double amounts): amounts become money_t cents
+ * - version 1 and 2: accounts.dat is split into AccountState records
+ *   and account_profiles.dat
+ * Converted copies are written first, then the format file is switched
+ * and the copies renamed over the originals. Must run after WAL
+ * recovery (replayed images are in the files' old format).
+ * @return 0 on success (or nothing to do), -1 on failure.
+ */
+int ledger_upgrade_data_files(void) {
+    int format = ledger_data_format();
+    if (format == -1 || format > DATA_FORMAT_VERSION) {
+        fprintf(stderr, "ledger: unknown data format in %s\n", DATA_FORMAT_FILE);
+        return -1;
+    }
+
+    if (access(DATA_FORMAT_FILE, F_OK) == 0) {
+        // Finish renames a crash may have interrupted after the last switch
+        if (install_all_converted() == -1) return -1;
+        if (format == DATA_FORMAT_VERSION) return 0;
+    }
+
+    if (format < DATA_FORMAT_VERSION) {
+        if (split_account_file(format) == -1 ||
+            (format == 1 && convert_money_field(LOAN_DB_FILE, sizeof(struct LoanApplication),
+                                                offsetof(struct LoanApplication, amount)) == -1)) {
+            perror("ledger: converting data files failed");
+            unlink(ACCOUNT_DB_FILE STAGED_SUFFIX);
+            unlink(ACCOUNT_PROFILE_FILE STAGED_SUFFIX);
+            unlink(LOAN_DB_FILE STAGED_SUFFIX);
+            return -1;
+        }
+    }
+
+    if (write_data_format(DATA_FORMAT_VERSION) == -1 || install_all_converted() == -1) {
+        perror("ledger: switching data format failed");
+        return -1;
+    }
+    if (format == 1) printf("Converted %s and %s amounts to cents\n", ACCOUNT_DB_FILE, LOAN_DB_FILE);
+    if (format < DATA_FORMAT_VERSION) {
+        printf("Split %s into hot %s and cold %s records\n", ACCOUNT_DB_FILE, ACCOUNT_DB_FILE, ACCOUNT_PROFILE_FILE);
+    }
+    return 0;
+}
+
+// --- Aggregation Kernels ---
+
+static money_t sum_accounts_scalar(const struct AccountState* accounts, long count) {
+    money_t total = 0;
+    for (long i = 0; i < count; i++) total += accounts[i].balance;
+    return total;
+}
+
+static void sum_loans_scalar(const struct LoanApplication* loans, long count, struct LedgerTotals* totals) {
+    for (long i = 0; i < count; i++) {
+        int status = loans[i].status;
+        if (loans[i].loan_id == 0) continue; // Unused record
+        if (status < 0 || status >= LEDGER_LOAN_STATUSES) continue;
+        totals->loan_count[status]++;
+        totals->loan_total[status] += loans[i].amount;
+    }
+}
+
+#ifdef LEDGER_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static long long horizontal_sum(__m256i v) {
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/**
+ * @brief Sums balances with plain loads: each 32-byte load covers two
+ * AccountState records, whose balances are its odd 64-bit lanes.
+ */
+__attribute__((target("avx2")))
+static money_t sum_accounts_avx2(const struct AccountState* accounts, long count) {
+    const __m256i balance_lanes = _mm256_setr_epi64x(0, -1, 0, -1);
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+
+    long i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i pair0 = _mm256_loadu_si256((const __m256i*)&accounts[i]);
+        __m256i pair1 = _mm256_loadu_si256((const __m256i*)&accounts[i + 2]);
+        sum0 = _mm256_add_epi64(sum0, _mm256_and_si256(pair0, balance_lanes));
+        sum1 = _mm256_add_epi64(sum1, _mm256_and_si256(pair1, balance_lanes));
+    }
+    return horizontal_sum(_mm256_add_epi64(sum0, sum1)) + sum_accounts_scalar(accounts + i, count - i);
+}
+
+/**
+ * @brief Per-status loan totals: gathers four amounts and statuses, then
+ * adds each amount into its status lane with compare masks. Unused
+ * records (loan_id 0) get status -1, which matches no lane.
+ */
+__attribute__((target("avx2")))
+static void sum_loans_avx2(const struct LoanApplication* loans, long count, struct LedgerTotals* totals) {
+    const long long stride = sizeof(struct LoanApplication);
+    const long long* amounts = (const long long*)&loans[0].amount;
+    const int* statuses = &loans[0].status;
+    const int* ids = &loans[0].loan_id;
+    __m256i offsets = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    const __m256i step = _mm256_set1_epi64x(4 * stride);
+    __m256i sums[LEDGER_LOAN_STATUSES], counts[LEDGER_LOAN_STATUSES], status_ids[LEDGER_LOAN_STATUSES];
+    for (int s = 0; s < LEDGER_LOAN_STATUSES; s++) {
+        sums[s] = counts[s] = _mm256_setzero_si256();
+        status_ids[s] = _mm256_set1_epi64x(s);
+    }
+
+    long i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i amount = _mm256_i64gather_epi64(amounts, offsets, 1);
+        __m256i status = _mm256_cvtepi32_epi64(_mm256_i64gather_epi32(statuses, offsets, 1));
+        __m256i id = _mm256_cvtepi32_epi64(_mm256_i64gather_epi32(ids, offsets, 1));
+        status = _mm256_or_si256(status, _mm256_cmpeq_epi64(id, _mm256_setzero_si256()));
+        for (int s = 0; s < LEDGER_LOAN_STATUSES; s++) {
+            __m256i match = _mm256_cmpeq_epi64(status, status_ids[s]); // All ones where equal
+            sums[s] = _mm256_add_epi64(sums[s], _mm256_and_si256(match, amount));
+            counts[s] = _mm256_sub_epi64(counts[s], match);
+        }
+        offsets = _mm256_add_epi64(offsets, step);
+    }
+    for (int s = 0; s < LEDGER_LOAN_STATUSES; s++) {
+        totals->loan_total[s] += horizontal_sum(sums[s]);
+        totals->loan_count[s] += horizontal_sum(counts[s]);
+    }
+    sum_loans_scalar(loans + i, count - i, totals);
+}
+
+static int have_avx2(void) {
+    static int cached = -1;
+    if (cached == -1) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+
+#endif // LEDGER_HAVE_AVX2
+
+/**
+ * @brief Names the kernel ledger_compute_totals() uses on this CPU.
+ */
+const char* ledger_kernel_name(void) {
+#ifdef LEDGER_HAVE_AVX2
+    if (have_avx2()) return "avx2";
+#endif
+    return "scalar";
+}
+
+// --- Aggregation ---
+
+/**
+ * @brief Maps a data file read-only for one sequential pass.
+ * @return The mapping (NULL for an empty or missing file), or MAP_FAILED.
+ */
+static void* map_data_file(const char* path, size_t record_size, long* count, size_t* map_size) {
+    *count = 0;
+    *map_size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return (errno == ENOENT) ? NULL : MAP_FAILED;
+
+    struct stat st;
+    void* map = NULL;
+    if (fstat(fd, &st) == -1) {
+        map = MAP_FAILED;
+    } else if (st.st_size >= (off_t)record_size) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            *count = (long)(st.st_size / record_size);
+            *map_size = st.st_size;
+        }
+    }
+    close(fd);
+    return map;
+}
+
+/**
+ * @brief Returns every record of a table: the storage engine's own view
+ * when it keeps one (MMAP, MEMORY), else a private read-only mapping
+ * that the caller releases with munmap(*map, *map_size).
+ */
+static const void* table_records(int table, const char* path, long* count, void** map, size_t* map_size) {
+    *map = NULL;
+    *map_size = 0;
+    if (storage_engine() != STORAGE_FILE) {
+        const void* records = storage_records(table, count);
+        if (records != NULL) return records;
+    }
+    *map = map_data_file(path, storage_record_size(table), count, map_size);
+    return *map;
+}
+
+/**
+ * @brief Computes deposit and loan totals in one pass over each table.
+ * @return 0 on success, -1 on failure.
+ */
+int ledger_compute_totals(struct LedgerTotals* totals) {
+    memset(totals, 0, sizeof(*totals));
+
+    long account_count, loan_count;
+    void *account_map, *loan_map;
+    size_t account_map_size, loan_map_size;
+    const struct AccountState* accounts =
+        table_records(STORAGE_ACCOUNTS, ACCOUNT_DB_FILE, &account_count, &account_map, &account_map_size);
+    if (accounts == MAP_FAILED) return -1;
+    const struct LoanApplication* loans =
+        table_records(STORAGE_LOANS, LOAN_DB_FILE, &loan_count, &loan_map, &loan_map_size);
+    if (loans == MAP_FAILED) {
+        if (account_map != NULL) munmap(account_map, account_map_size);
+        return -1;
+    }
+
+    int simd = 0;
+#ifdef LEDGER_HAVE_AVX2
+    simd = have_avx2();
+    if (simd && accounts != NULL) totals->total_deposits = sum_accounts_avx2(accounts, account_count);
+    if (simd && loans != NULL) sum_loans_avx2(loans, loan_count, totals);
+#endif
+    if (!simd && accounts != NULL) totals->total_deposits = sum_accounts_scalar(accounts, account_count);
+    if (!simd && loans != NULL) sum_loans_scalar(loans, loan_count, totals);
+    totals->accounts = account_count;
+    totals->loans = loan_count;
+    totals->loans_outstanding = totals->loan_total[LEDGER_LOAN_APPROVED];
+
+    if (account_map != NULL) munmap(account_map, account_map_size);
+    if (loan_map != NULL) munmap(loan_map, loan_map_size);
+    return 0;
+}
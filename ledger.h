@@ -0,0 +1,40 @@
+/*
+ * ========================================
+ * ledger.h
+ * =Description: Bank-wide money operations over
+ * accounts.dat and loans.dat.
+ * - One-pass aggregation of deposits and loan
+ *   totals (AVX2 kernel with a scalar fallback)
+ * - Upgrade of older data files: floating-point
+ *   amounts to money_t cents, single-file accounts
+ *   to hot/cold records
+ * ========================================
+ */
+
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include "bank_storage.h"
+
+#define LEDGER_LOAN_STATUSES 4 // Requested, Assigned, Approved, Rejected
+#define LEDGER_LOAN_APPROVED 2
+
+// Totals over both data files
+struct LedgerTotals {
+    long accounts;
+    money_t total_deposits;     // Sum of every account balance
+    long loans;
+    money_t loans_outstanding;  // Approved loans (credited and not repaid)
+    long loan_count[LEDGER_LOAN_STATUSES];
+    money_t loan_total[LEDGER_LOAN_STATUSES];
+};
+
+// --- Data Format (parent, after WAL recovery, before any index is built) ---
+int ledger_data_format(void);
+int ledger_upgrade_data_files(void);
+
+// --- Aggregation ---
+int ledger_compute_totals(struct LedgerTotals* totals);
+const char* ledger_kernel_name(void);
+
+#endif // LEDGER_H
@@ -0,0 +1,329 @@
+/*
+ * ========================================
+ * loan_index.c
+ * =Description: Implementation of the loan index
+ * and the per-status / per-employee work queues.
+ *
+ * Each queue is a doubly-linked list threaded through
+ * a node array indexed by loan record number, so moving
+ * a loan between queues is O(1). A single robust,
+ * process-shared mutex guards the lists; it is only
+ * held for pointer updates or to copy a listing.
+ *
+ * New loans take their ID and record number from
+ * shared counters with an atomic fetch-add. IDs are
+ * persisted to loan_id.dat in reserved batches, so a
+ * restart resumes past every ID that may have been
+ * handed out (leaving a gap) and never reuses one.
+ * ========================================
+ */
+
+#include "loan_index.h"
+#include "record_index.h"
+#include "bank_storage.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define UNASSIGNED_QUEUE 0
+#define NO_QUEUE -1
+
+// List links for one loan record
+struct LoanQueueNode {
+    int prev;
+    int next;
+    int queue; // NO_QUEUE when approved/rejected
+};
+
+// Shared state, created by the parent before fork
+struct LoanQueues {
+    pthread_mutex_t lock;
+    int queue_count;  // Queues handed out so far (0 = unassigned)
+    int degraded;     // A record or queue did not fit; callers must scan
+    int heads[LOAN_MAX_QUEUES];
+    int tails[LOAN_MAX_QUEUES];
+    // Allocators for new loans
+    int next_loan_id;             // fetch-add; may run past reserved_end
+    int reserved_end;             // IDs below this are persisted as used
+    pthread_mutex_t reserve_lock; // Serializes loan_id.dat writes
+    long next_record;             // fetch-add; next free loans.dat record
+    struct LoanQueueNode nodes[LOAN_INDEX_CAPACITY];
+};
+
+static struct LoanQueues* g_loan_queues = NULL;
+static struct RecordIndex* g_loan_id_index = NULL;        // loan_id -> record
+static struct RecordIndex* g_employee_queue_index = NULL; // employee_id -> queue
+
+// --- List Primitives (caller holds the lock) ---
+
+static void queue_unlink(int record) {
+    struct LoanQueueNode* node = &g_loan_queues->nodes[record];
+    if (node->queue == NO_QUEUE) return;
+
+    if (node->prev != -1) g_loan_queues->nodes[node->prev].next = node->next;
+    else g_loan_queues->heads[node->queue] = node->next;
+    if (node->next != -1) g_loan_queues->nodes[node->next].prev = node->prev;
+    else g_loan_queues->tails[node->queue] = node->prev;
+
+    node->prev = node->next = -1;
+    node->queue = NO_QUEUE;
+}
+
+static void queue_append(int queue, int record) {
+    struct LoanQueueNode* node = &g_loan_queues->nodes[record];
+    node->queue = queue;
+    node->next = -1;
+    node->prev = g_loan_queues->tails[queue];
+    if (node->prev != -1) g_loan_queues->nodes[node->prev].next = record;
+    else g_loan_queues->heads[queue] = record;
+    g_loan_queues->tails[queue] = record;
+}
+
+/**
+ * @brief Returns the queue for an employee, creating it if needed.
+ */
+static int employee_queue(int employee_id, int create) {
+    int queue = record_index_lookup(g_employee_queue_index, employee_id);
+    if (queue != -1 || !create) return queue;
+
+    if (g_loan_queues->queue_count >= LOAN_MAX_QUEUES) return -1;
+    queue = g_loan_queues->queue_count++;
+    g_loan_queues->heads[queue] = g_loan_queues->tails[queue] = -1;
+    record_index_insert(g_employee_queue_index, employee_id, queue);
+    return queue;
+}
+
+/**
+ * @brief Places a record in the queue matching its status (lock held).
+ */
+static int place_record(int record, int status, int employee_id) {
+    if (record < 0 || record >= LOAN_INDEX_CAPACITY) {
+        g_loan_queues->degraded = 1;
+        return -1;
+    }
+
+    queue_unlink(record);
+    if (status == 0) {
+        queue_append(UNASSIGNED_QUEUE, record);
+    } else if (status == 1) {
+        int queue = employee_queue(employee_id, 1);
+        if (queue == -1) { g_loan_queues->degraded = 1; return -1; }
+        queue_append(queue, record);
+    }
+    return 0;
+}
+
+// --- ID Counter File ---
+
+/**
+ * @brief Reads the next unused ID from loan_id.dat (1 if none yet).
+ */
+static int read_stored_loan_id(void) {
+    struct IDCounter counter;
+    if (storage_engine() == STORAGE_MEMORY) return 1;
+    int fd = open(LOAN_COUNTER_FILE, O_RDONLY);
+    if (fd == -1) return 1;
+    ssize_t n = pread(fd, &counter, sizeof(counter), 0);
+    close(fd);
+    return (n == sizeof(counter) && counter.next_loan_id > 0) ? counter.next_loan_id : 1;
+}
+
+/**
+ * @brief Durably records that IDs below next_loan_id may be in use.
+ */
+static int store_loan_id(int next_loan_id) {
+    struct IDCounter counter = {next_loan_id};
+    if (storage_engine() == STORAGE_MEMORY) return 0; // Nothing outlives the process
+    int fd = open(LOAN_COUNTER_FILE, O_WRONLY | O_CREAT, 0644);
+    if (fd == -1) return -1;
+    int rc = (pwrite(fd, &counter, sizeof(counter), 0) == sizeof(counter) && fdatasync(fd) == 0) ? 0 : -1;
+    close(fd);
+    return rc;
+}
+
+/**
+ * @brief Allocates an ID through loan_id.dat under a file lock (no shared state).
+ */
+static int allocate_id_from_file(void) {
+    struct IDCounter counter;
+    int fd = open(LOAN_COUNTER_FILE, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return -1;
+
+    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
+    fcntl(fd, F_SETLKW, &lock);
+    if (pread(fd, &counter, sizeof(counter), 0) != sizeof(counter) || counter.next_loan_id <= 0) {
+        counter.next_loan_id = 1;
+    }
+    int loan_id = counter.next_loan_id++;
+    if (pwrite(fd, &counter, sizeof(counter), 0) != sizeof(counter)) loan_id = -1;
+    lock.l_type = F_UNLCK;
+    fcntl(fd, F_SETLK, &lock);
+    close(fd);
+    return loan_id;
+}
+
+// --- Lifecycle ---
+
+// Progress of the startup scan over the loans table
+struct LoanScan {
+    int next_loan_id;
+    long records;
+};
+
+static int index_loan(int record, const void* data, void* ctx) {
+    const struct LoanApplication* loan = data;
+    struct LoanScan* scan = ctx;
+    if (loan->loan_id != 0) { // 0: slot reserved by a request that never committed
+        if (record_index_insert(g_loan_id_index, loan->loan_id, record) == -1) {
+            g_loan_queues->degraded = 1;
+        }
+        place_record(record, loan->status, loan->assigned_to_employee_id);
+        if (loan->loan_id >= scan->next_loan_id) scan->next_loan_id = loan->loan_id + 1;
+    }
+    scan->records = record + 1;
+    return 0;
+}
+
+/**
+ * @brief Builds the index and queues from the loans table. Run before fork().
+ */
+int loan_index_init(void) {
+    g_loan_queues = create_shared_region(sizeof(struct LoanQueues));
+    g_loan_id_index = record_index_create(LOAN_INDEX_CAPACITY);
+    g_employee_queue_index = record_index_create(LOAN_MAX_QUEUES);
+    if (g_loan_queues == NULL || g_loan_id_index == NULL || g_employee_queue_index == NULL) {
+        g_loan_queues = NULL;
+        return -1;
+    }
+
+    init_shared_mutex(&g_loan_queues->lock);
+    for (int i = 0; i < LOAN_INDEX_CAPACITY; i++) {
+        g_loan_queues->nodes[i].prev = g_loan_queues->nodes[i].next = -1;
+        g_loan_queues->nodes[i].queue = NO_QUEUE;
+    }
+    g_loan_queues->heads[UNASSIGNED_QUEUE] = g_loan_queues->tails[UNASSIGNED_QUEUE] = -1;
+    g_loan_queues->queue_count = 1;
+    init_shared_mutex(&g_loan_queues->reserve_lock);
+
+    struct LoanScan scan = {read_stored_loan_id(), 0};
+    if (storage_scan(STORAGE_LOANS, index_loan, &scan) == -1) { g_loan_queues = NULL; return -1; }
+
+    // Nothing is reserved yet: the first allocation persists a batch
+    g_loan_queues->next_loan_id = scan.next_loan_id;
+    g_loan_queues->reserved_end = scan.next_loan_id;
+    g_loan_queues->next_record = scan.records;
+    return 0;
+}
+
+// --- Allocation ---
+
+/**
+ * @brief Hands out a new, never-used loan ID.
+ *
+ * Lock-free except once per LOAN_ID_RESERVE_BATCH IDs, when the
+ * process that crosses the reserved end persists the next batch.
+ * @return The ID, or -1 if loan_id.dat could not be written.
+ */
+int loan_index_allocate_id(void) {
+    if (g_loan_queues == NULL) return allocate_id_from_file();
+
+    int loan_id = __atomic_fetch_add(&g_loan_queues->next_loan_id, 1, __ATOMIC_RELAXED);
+    if (loan_id < __atomic_load_n(&g_loan_queues->reserved_end, __ATOMIC_ACQUIRE)) return loan_id;
+
+    if (lock_shared_mutex(&g_loan_queues->reserve_lock) == -1) return -1;
+    int rc = 0;
+    if (loan_id >= g_loan_queues->reserved_end) {
+        int end = loan_id + LOAN_ID_RESERVE_BATCH;
+        rc = store_loan_id(end);
+        if (rc == 0) __atomic_store_n(&g_loan_queues->reserved_end, end, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&g_loan_queues->reserve_lock);
+    return (rc == 0) ? loan_id : -1;
+}
+
+/**
+ * @brief Claims the next loans.dat record number for a new loan.
+ *
+ * If the request fails before its WAL commit, the record stays a
+ * zero-filled hole (loan_id 0) once a later record is written.
+ * @return The record number, or -1 if the caller must lock the file
+ * and append instead.
+ */
+int loan_index_reserve_record(void) {
+    if (g_loan_queues == NULL) return -1;
+    long record = __atomic_fetch_add(&g_loan_queues->next_record, 1, __ATOMIC_RELAXED);
+    return (record > INT_MAX) ? -1 : (int)record;
+}
+
+// --- Lookup ---
+
+/**
+ * @brief Returns the record number of loan_id, -1 if absent, or -2 if
+ * the index cannot answer and the caller must scan loans.dat.
+ */
+int loan_index_find(int loan_id) {
+    if (g_loan_id_index == NULL) return RECORD_INDEX_UNKNOWN;
+    return record_index_find(g_loan_id_index, loan_id);
+}
+
+// --- Maintenance ---
+
+/**
+ * @brief Registers a newly written loan.
+ */
+int loan_index_add(int loan_id, int record, int status, int employee_id) {
+    if (g_loan_queues == NULL) return -1;
+    if (record_index_lock(g_loan_id_index) == -1) return -1;
+    record_index_insert(g_loan_id_index, loan_id, record);
+    record_index_unlock(g_loan_id_index);
+    return loan_index_update(record, status, employee_id);
+}
+
+/**
+ * @brief Moves a loan to the queue for its new status.
+ */
+int loan_index_update(int record, int status, int employee_id) {
+    if (g_loan_queues == NULL) return -1;
+    if (lock_shared_mutex(&g_loan_queues->lock) == -1) return -1;
+    int rc = place_record(record, status, employee_id);
+    pthread_mutex_unlock(&g_loan_queues->lock);
+    return rc;
+}
+
+// --- Listings ---
+
+/**
+ * @brief Copies up to max_records record numbers from one queue.
+ * @return Count copied, or -1 if the queues are unavailable.
+ */
+static int copy_queue(int queue, int* records, int max_records) {
+    int count = 0;
+    for (int record = g_loan_queues->heads[queue]; record != -1 && count < max_records;
+         record = g_loan_queues->nodes[record].next) {
+        records[count++] = record;
+    }
+    return count;
+}
+
+int loan_index_list_unassigned(int* records, int max_records) {
+    if (g_loan_queues == NULL || g_loan_queues->degraded) return -1;
+    if (lock_shared_mutex(&g_loan_queues->lock) == -1) return -1;
+    int count = copy_queue(UNASSIGNED_QUEUE, records, max_records);
+    pthread_mutex_unlock(&g_loan_queues->lock);
+    return count;
+}
+
+int loan_index_list_assigned(int employee_id, int* records, int max_records) {
+    if (g_loan_queues == NULL || g_loan_queues->degraded) return -1;
+    if (lock_shared_mutex(&g_loan_queues->lock) == -1) return -1;
+    int queue = employee_queue(employee_id, 0);
+    int count = (queue == -1) ? 0 : copy_queue(queue, records, max_records);
+    pthread_mutex_unlock(&g_loan_queues->lock);
+    return count;
+}
@@ -0,0 +1,42 @@
+/*
+ * ========================================
+ * loan_index.h
+ * =Description: Shared-memory index over loans.dat.
+ * - loan_id -> record number
+ * - Work queues: one list of Requested (status 0)
+ *   loans and one list of Assigned (status 1) loans
+ *   per employee
+ * Approved/rejected loans leave every queue, so the
+ * listing views cost time proportional to their
+ * results, not to the loan history.
+ * - Lock-free loan ID and record allocation
+ * ========================================
+ */
+
+#ifndef LOAN_INDEX_H
+#define LOAN_INDEX_H
+
+// --- Constants ---
+#define LOAN_INDEX_CAPACITY (1 << 20) // Loan records addressable by the queues
+#define LOAN_MAX_QUEUES 65536         // Unassigned queue + one per employee
+#define LOAN_ID_RESERVE_BATCH 1024    // IDs persisted to loan_id.dat per write
+
+// --- Index Lifecycle ---
+int loan_index_init(void);
+
+// --- Allocation (new loans) ---
+int loan_index_allocate_id(void);
+int loan_index_reserve_record(void);
+
+// --- Lookup ---
+int loan_index_find(int loan_id);
+
+// --- Queue Maintenance (call after the record is written) ---
+int loan_index_add(int loan_id, int record, int status, int employee_id);
+int loan_index_update(int record, int status, int employee_id);
+
+// --- Queue Listings ---
+int loan_index_list_unassigned(int* records, int max_records);
+int loan_index_list_assigned(int employee_id, int* records, int max_records);
+
+#endif // LOAN_INDEX_H
@@ -0,0 +1,243 @@
+/*
+ * ========================================
+ * prefork_server.c
+ * =Description: Implementation of the pre-forked
+ * server mode.
+ *
+ * The parent opens one listener per worker slot at
+ * startup, so a port that cannot be bound is reported
+ * at once, and keeps them open for the server's life.
+ * Closing a SO_REUSEPORT listener resets the
+ * connections the kernel has already hashed into its
+ * queue, so a recycled worker only drops its copy and
+ * the replacement inherits the same socket; the queue
+ * simply waits the few milliseconds in between.
+ * A worker that reaches its session quota writes its
+ * slot number to the retire pipe; the parent forks
+ * the replacement at once, while the old worker
+ * drains. A worker that dies without retiring is
+ * noticed by a liveness check and replaced too.
+ * ========================================
+ */
+
+#include "prefork_server.h"
+#include "event_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define SLOT_CHECK_MS 1000 // Liveness check interval; also throttles restarts of a crashing slot
+#define CPU_MASK_WORDS 16  // Affinity masks cover 1024 CPUs
+
+// One worker position; its process changes as workers are recycled
+struct WorkerSlot {
+    int listen_fd;    // Held by the parent; lent to each worker of the slot
+    pid_t pid;        // 0: needs a worker
+    time_t started;   // When the current (or last) worker was forked
+};
+
+// --- Worker Process State ---
+static int g_slot = -1;
+static int g_retire_fd = -1;
+static volatile sig_atomic_t g_worker_running = 1;
+
+// --- CPU Affinity ---
+
+/**
+ * @brief Pins the calling process to the `index`-th CPU it may run on
+ * (modulo their count). Raw syscalls, as with io_uring, so no
+ * _GNU_SOURCE is needed for the CPU_SET macros.
+ */
+static void pin_to_cpu(int index) {
+    unsigned long allowed[CPU_MASK_WORDS] = {0};
+    long bytes = syscall(__NR_sched_getaffinity, 0, sizeof(allowed), allowed);
+    if (bytes <= 0) return;
+
+    int bits = (int)(sizeof(allowed) * 8), count = 0;
+    for (int cpu = 0; cpu < bits; cpu++) {
+        if (allowed[cpu / 64] & (1UL << (cpu % 64))) count++;
+    }
+    if (count == 0) return;
+
+    int wanted = index % count;
+    for (int cpu = 0; cpu < bits; cpu++) {
+        if (!(allowed[cpu / 64] & (1UL << (cpu % 64)))) continue;
+        if (wanted-- == 0) {
+            unsigned long mask[CPU_MASK_WORDS] = {0};
+            mask[cpu / 64] = 1UL << (cpu % 64);
+            syscall(__NR_sched_setaffinity, 0, sizeof(mask), mask);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief One worker per CPU the server may run on.
+ */
+int prefork_default_workers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) return 1;
+    return (cpus > PREFORK_MAX_WORKERS) ? PREFORK_MAX_WORKERS : (int)cpus;
+}
+
+// --- Listeners ---
+
+/**
+ * @brief Opens a nonblocking SO_REUSEPORT listener on `port`. Every
+ * slot has one; the kernel balances new connections across them.
+ */
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+
+    int opt = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1 ||
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// --- Worker Processes ---
+
+static void stop_worker(int signum) {
+    g_worker_running = 0;
+}
+
+/**
+ * @brief Tells the parent this worker has stopped accepting, so it can
+ * start the replacement while the sessions left here finish.
+ */
+static void retire_worker(void) {
+    if (g_retire_fd == -1 || !g_worker_running) return; // Shutting down: no replacement wanted
+    if (write(g_retire_fd, &g_slot, sizeof(g_slot)) == -1) perror("prefork: retire notice failed");
+    close(g_retire_fd);
+    g_retire_fd = -1;
+}
+
+static void run_worker(int slot, int listen_fd, int retire_fd, long recycle_after,
+                       void (*serve)(int client_socket), pid_t parent) {
+    // However the parent ends, its workers must stop taking connections
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != parent) exit(0);
+
+    g_slot = slot;
+    g_retire_fd = retire_fd;
+    signal(SIGINT, stop_worker);  // Ctrl+C reaches the whole process group
+    signal(SIGTERM, stop_worker); // Sent by the parent on shutdown
+    signal(SIGCHLD, SIG_DFL);
+    pin_to_cpu(slot);
+
+    if (event_worker_run(listen_fd, recycle_after, serve, &g_worker_running, retire_worker) == -1) exit(1);
+    exit(0);
+}
+
+/**
+ * @brief Forks a worker for `slot` that accepts on the slot's listener.
+ * @return 0 on success, -1 if the fork failed.
+ */
+static int spawn_worker(struct WorkerSlot* slots, int workers, int slot, int retire_pipe[2], long recycle_after,
+                        void (*serve)(int client_socket)) {
+    slots[slot].started = time(NULL);
+
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(retire_pipe[0]);
+        for (int i = 0; i < workers; i++) {
+            if (i != slot) close(slots[i].listen_fd);
+        }
+        run_worker(slot, slots[slot].listen_fd, retire_pipe[1], recycle_after, serve, parent);
+    }
+    if (pid < 0) {
+        perror("prefork: fork failed");
+        return -1;
+    }
+    slots[slot].pid = pid;
+    return 0;
+}
+
+/**
+ * @brief Starts `workers` worker processes, keeps the set complete until
+ * `*running` drops to 0, then tells them to stop accepting (they finish
+ * their open sessions on their own) and returns.
+ * Children are reaped by the caller's SIGCHLD handler.
+ * @return 0 on shutdown, -1 if the first workers could not start.
+ */
+int prefork_server_run(int port, int workers, long recycle_after, void (*serve)(int client_socket),
+                       volatile sig_atomic_t* running) {
+    if (workers < 1) workers = 1;
+    if (workers > PREFORK_MAX_WORKERS) workers = PREFORK_MAX_WORKERS;
+
+    int retire_pipe[2];
+    if (pipe(retire_pipe) == -1) return -1;
+    fcntl(retire_pipe[0], F_SETFL, fcntl(retire_pipe[0], F_GETFL) | O_NONBLOCK);
+
+    struct WorkerSlot* slots = calloc((size_t)workers, sizeof(*slots));
+    if (slots == NULL) return -1;
+    int opened = 0, spawned = 0;
+    while (opened < workers && (slots[opened].listen_fd = open_listener(port)) != -1) opened++;
+    if (opened < workers) perror("prefork: listener failed");
+    while (opened == workers && spawned < workers &&
+           spawn_worker(slots, workers, spawned, retire_pipe, recycle_after, serve) == 0) {
+        spawned++;
+    }
+    if (spawned < workers) {
+        for (int i = 0; i < spawned; i++) kill(slots[i].pid, SIGTERM);
+        for (int i = 0; i < opened; i++) close(slots[i].listen_fd);
+        free(slots);
+        return -1;
+    }
+
+    while (*running) {
+        struct pollfd ready = {retire_pipe[0], POLLIN, 0};
+        poll(&ready, 1, SLOT_CHECK_MS); // SIGCHLD and SIGINT cut it short
+
+        int slot;
+        while (read(retire_pipe[0], &slot, sizeof(slot)) == sizeof(slot)) {
+            if (slot < 0 || slot >= workers) continue;
+            slots[slot].pid = 0; // Draining; no longer this slot's worker
+            slots[slot].started = 0;
+        }
+
+        time_t now = time(NULL);
+        for (int i = 0; i < workers && *running; i++) {
+            if (slots[i].pid != 0 && kill(slots[i].pid, 0) == -1 && errno == ESRCH) {
+                fprintf(stderr, "prefork: worker %d exited unexpectedly, restarting it.\n", i);
+                slots[i].pid = 0;
+            }
+            // A worker that keeps crashing is restarted at most once per check
+            if (slots[i].pid == 0 && now > slots[i].started) {
+                spawn_worker(slots, workers, i, retire_pipe, recycle_after, serve);
+            }
+        }
+    }
+
+    // --- Shutdown ---
+    for (int i = 0; i < workers; i++) {
+        if (slots[i].pid != 0) kill(slots[i].pid, SIGTERM);
+        close(slots[i].listen_fd);
+    }
+    close(retire_pipe[0]);
+    close(retire_pipe[1]);
+    free(slots);
+    return 0;
+}
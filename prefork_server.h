@@ -0,0 +1,31 @@
+/*
+ * ========================================
+ * prefork_server.h
+ * =Description: Pre-forked server mode. The parent
+ * starts a fixed set of long-lived worker processes
+ * up front instead of forking once per connection.
+ * - Each worker owns its own SO_REUSEPORT listener on
+ *   the server port, so the kernel spreads incoming
+ *   connections across the workers' accept queues
+ * - Each worker is pinned to one CPU and serves many
+ *   sessions at once with the event scheduler
+ * - A worker that has accepted its quota of sessions
+ *   is replaced by a fresh one, then finishes the
+ *   sessions it still has and exits
+ * ========================================
+ */
+
+#ifndef PREFORK_SERVER_H
+#define PREFORK_SERVER_H
+
+#include <signal.h> // For sig_atomic_t
+
+#define PREFORK_MAX_WORKERS 256
+#define PREFORK_DEFAULT_RECYCLE 10000 // Sessions per worker before it is replaced
+
+// --- Server ---
+int prefork_default_workers(void);
+int prefork_server_run(int port, int workers, long recycle_after, void (*serve)(int client_socket),
+                       volatile sig_atomic_t* running);
+
+#endif // PREFORK_SERVER_H
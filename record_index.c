@@ -0,0 +1,254 @@
+/*
+ * ========================================
+ * record_index.c
+ * =Description: Implementation of the shared-memory
+ * record index (open addressing, linear probing).
+ *
+ * Concurrency model:
+ * - Readers never lock. A slot becomes visible only
+ *   when its record number is published with a
+ *   release store, after the key is in place.
+ * - Writers must be serialized by the caller, normally
+ *   with the index's own writer lock, which creators
+ *   hold across check, append and insert.
+ * - Entries are never removed, so probing stays valid.
+ *
+ * Every key also goes into a Bloom filter (16 bits
+ * per slot, 4 probes), even when the table is full.
+ * Once the table is degraded, a filter miss still
+ * proves a key absent, so most lookups of new IDs
+ * skip the file scan.
+ * ========================================
+ */
+
+#include "record_index.h"
+#include "storage.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// One hash slot. record_plus_one == 0 marks an empty slot.
+struct RecordIndexSlot {
+    int key;
+    int record_plus_one;
+};
+
+#define BLOOM_BITS_PER_SLOT 16
+#define BLOOM_PROBES 4
+
+// Header placed at the start of the shared mapping
+struct RecordIndex {
+    pthread_mutex_t writer_lock; // Serializes inserts (and the creates around them)
+    int capacity;   // Always a power of two
+    int mask;
+    int shift;      // 32 - log2(capacity), for taking the high hash bits
+    int count;      // Number of occupied slots
+    int degraded;   // 1 if an insert was dropped; lookup misses are then not authoritative
+    uint64_t bloom_mask;         // Bloom filter size in bits, minus one
+    struct RecordIndexSlot slots[]; // Followed by the Bloom filter words
+};
+
+struct RecordIndex* g_account_index = NULL;
+struct RecordIndex* g_staff_index = NULL;
+
+/**
+ * @brief Fibonacci hash of a 32-bit key into the slot range.
+ */
+static inline int index_hash(const struct RecordIndex* index, int key) {
+    return (int)(((uint32_t)key * 2654435761u) >> index->shift);
+}
+
+// --- Bloom Filter ---
+
+static uint64_t* bloom_words(const struct RecordIndex* index) {
+    return (uint64_t*)(index->slots + index->capacity);
+}
+
+/**
+ * @brief Two independent hashes of a key (splitmix64 finalizer); probe i
+ * uses bit h1 + i * h2.
+ */
+static void bloom_hashes(int key, uint64_t* h1, uint64_t* h2) {
+    uint64_t z = (uint32_t)key + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    *h1 = z & 0xffffffffu;
+    *h2 = (z >> 32) | 1; // Odd, so the probes hit distinct bits
+}
+
+static void bloom_add(struct RecordIndex* index, int key) {
+    uint64_t h1, h2;
+    bloom_hashes(key, &h1, &h2);
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        uint64_t bit = (h1 + i * h2) & index->bloom_mask;
+        __atomic_fetch_or(&bloom_words(index)[bit >> 6], 1ull << (bit & 63), __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Returns 0 if key was never inserted, 1 if it may have been.
+ */
+int record_index_may_contain(const struct RecordIndex* index, int key) {
+    uint64_t h1, h2;
+    bloom_hashes(key, &h1, &h2);
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        uint64_t bit = (h1 + i * h2) & index->bloom_mask;
+        uint64_t word = __atomic_load_n(&bloom_words(index)[bit >> 6], __ATOMIC_ACQUIRE);
+        if (!(word & (1ull << (bit & 63)))) return 0;
+    }
+    return 1;
+}
+
+// --- Index Lifecycle ---
+
+/**
+ * @brief Allocates an empty index in anonymous shared memory.
+ * Must be called by the parent before fork() so children inherit it.
+ */
+struct RecordIndex* record_index_create(int capacity) {
+    int rounded = 2, bits = 1;
+    while (rounded < capacity) { rounded <<= 1; bits++; }
+
+    size_t bloom_bits = (size_t)rounded * BLOOM_BITS_PER_SLOT;
+    size_t bytes = sizeof(struct RecordIndex) + (size_t)rounded * sizeof(struct RecordIndexSlot) + bloom_bits / 8;
+    struct RecordIndex* index = create_shared_region(bytes);
+    if (index == NULL) return NULL;
+
+    // Shared regions are zero-filled, so every slot and filter bit starts empty
+    init_shared_mutex(&index->writer_lock);
+    index->capacity = rounded;
+    index->mask = rounded - 1;
+    index->shift = 32 - bits;
+    index->bloom_mask = bloom_bits - 1;
+    return index;
+}
+
+static int index_record(int record_number, const void* data, void* ctx) {
+    int key;
+    memcpy(&key, data, sizeof(key));
+    record_index_insert(ctx, key, record_number);
+    return 0;
+}
+
+/**
+ * @brief Populates the index from a storage table.
+ * The record ID must be the first int of every record.
+ */
+int record_index_build(struct RecordIndex* index, int table) {
+    if (storage_scan(table, index_record, index) == -1) {
+        index->degraded = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// --- Lookup & Maintenance ---
+
+/**
+ * @brief Returns the record number stored for key, or -1 if absent.
+ */
+int record_index_lookup(const struct RecordIndex* index, int key) {
+    int pos = index_hash(index, key);
+
+    for (int probes = 0; probes < index->capacity; probes++) {
+        const struct RecordIndexSlot* slot = &index->slots[pos];
+        int record_plus_one = __atomic_load_n(&slot->record_plus_one, __ATOMIC_ACQUIRE);
+        if (record_plus_one == 0) {
+            return -1; // Empty slot ends the probe chain
+        }
+        if (slot->key == key) {
+            return record_plus_one - 1;
+        }
+        pos = (pos + 1) & index->mask;
+    }
+    return -1;
+}
+
+/**
+ * @brief Adds key -> record_number. An existing key keeps its first
+ * record number, matching the old linear scan semantics.
+ * @return 0 on success, -1 if the index is full (it is then degraded).
+ */
+int record_index_insert(struct RecordIndex* index, int key, int record_number) {
+    bloom_add(index, key);
+
+    // Keep the load factor at or below 3/4 so probe chains stay short
+    if (index->count >= index->capacity - index->capacity / 4) {
+        if (record_index_lookup(index, key) != -1) return 0;
+        __atomic_store_n(&index->degraded, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    int pos = index_hash(index, key);
+    for (;;) {
+        struct RecordIndexSlot* slot = &index->slots[pos];
+        if (slot->record_plus_one == 0) {
+            slot->key = key;
+            __atomic_store_n(&slot->record_plus_one, record_number + 1, __ATOMIC_RELEASE);
+            index->count++;
+            return 0;
+        }
+        if (slot->key == key) {
+            return 0;
+        }
+        pos = (pos + 1) & index->mask;
+    }
+}
+
+/**
+ * @brief Adds or replaces key -> record_number (e.g. a chain head that
+ * moves forward on every append). Same writer rules as insert.
+ * @return 0 on success, -1 if the index is full (it is then degraded).
+ */
+int record_index_set(struct RecordIndex* index, int key, int record_number) {
+    int pos = index_hash(index, key);
+
+    for (int probes = 0; probes < index->capacity; probes++) {
+        struct RecordIndexSlot* slot = &index->slots[pos];
+        if (slot->record_plus_one == 0) break;
+        if (slot->key == key) {
+            __atomic_store_n(&slot->record_plus_one, record_number + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+        pos = (pos + 1) & index->mask;
+    }
+    return record_index_insert(index, key, record_number);
+}
+
+/**
+ * @brief Returns 1 if a miss can no longer be trusted and callers
+ * must fall back to scanning the data file.
+ */
+int record_index_is_degraded(const struct RecordIndex* index) {
+    return __atomic_load_n(&index->degraded, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Looks a key up, consulting the Bloom filter when the table
+ * itself can no longer prove a miss.
+ * @return The record number, -1 if absent, or RECORD_INDEX_UNKNOWN if
+ * only a scan of the data file can tell.
+ */
+int record_index_find(const struct RecordIndex* index, int key) {
+    int record_number = record_index_lookup(index, key);
+    if (record_number != -1 || !record_index_is_degraded(index)) return record_number;
+    return record_index_may_contain(index, key) ? RECORD_INDEX_UNKNOWN : -1;
+}
+
+/**
+ * @brief Takes the writer lock. Creators hold it from the duplicate
+ * check until the new record is inserted, instead of locking the file.
+ */
+int record_index_lock(struct RecordIndex* index) {
+    return lock_shared_mutex(&index->writer_lock);
+}
+
+void record_index_unlock(struct RecordIndex* index) {
+    pthread_mutex_unlock(&index->writer_lock);
+}
@@ -0,0 +1,48 @@
+/*
+ * ========================================
+ * record_index.h
+ * =Description: Shared-memory hash index that maps
+ * a record ID to its record number inside a
+ * storage table (e.g. accounts).
+ * - Built once by the parent server at startup
+ * - Inherited by every forked child (MAP_SHARED)
+ * - Lookups are lock-free and need no syscalls
+ * - A Bloom filter keeps misses cheap even after
+ *   the table has filled up
+ * ========================================
+ */
+
+#ifndef RECORD_INDEX_H
+#define RECORD_INDEX_H
+
+#include <sys/types.h>  // For size_t
+
+// --- Constants ---
+#define ACCOUNT_INDEX_CAPACITY (1 << 21) // Hash slots (~20 MB of shared memory with the filter)
+#define STAFF_INDEX_CAPACITY (1 << 16)
+#define RECORD_INDEX_UNKNOWN -2          // record_index_find(): only a file scan can tell
+
+// Opaque handle; the layout lives in record_index.c
+struct RecordIndex;
+
+// --- Index Lifecycle ---
+struct RecordIndex* record_index_create(int capacity);
+int record_index_build(struct RecordIndex* index, int table);
+
+// --- Lookup & Maintenance ---
+int record_index_lookup(const struct RecordIndex* index, int key);
+int record_index_find(const struct RecordIndex* index, int key);
+int record_index_may_contain(const struct RecordIndex* index, int key);
+int record_index_insert(struct RecordIndex* index, int key, int record_number);
+int record_index_set(struct RecordIndex* index, int key, int record_number);
+int record_index_is_degraded(const struct RecordIndex* index);
+
+// --- Writer Serialization ---
+int record_index_lock(struct RecordIndex* index);
+void record_index_unlock(struct RecordIndex* index);
+
+// --- Shared Index Instances (created in server.c) ---
+extern struct RecordIndex* g_account_index;
+extern struct RecordIndex* g_staff_index;
+
+#endif // RECORD_INDEX_H
@@ -4,11 +4,23 @@
  * =Description: The main server file for the
  * Banking Management System.
  * - Listens for connections
- * - Forks a child process for each client
- * - Routes clients to the correct logic handler
+ * - Forks a child process for each client, or with
+ *   --mode=epoll serves all of them from a pool of
+ *   worker threads (see event_server.h), or with
+ *   --mode=prefork from long-lived worker processes
+ *   (see prefork_server.h)
+ * - Routes clients to the correct logic handler, to
+ *   one-line command mode (see command_mode.h), or to
+ *   the binary protocol (see binary_protocol.h)
  *
  * =Compile command:
- * gcc server.c server_logic.c utils.c -o server -pthread
+ * gcc server.c server_logic.c utils.c storage.c record_index.c btree.c account_store.c account_import.c txn_log.c txn_index.c loan_index.c journal.c wal.c ledger.c uring.c txn_time_index.c statement.c event_server.c prefork_server.c bank_ops.c binary_protocol.c command_mode.c -o server -pthread
+ *
+ * =Usage:
+ * ./server [--storage=file|mmap|memory] [--msync=none|async|sync]
+ *          [--journal-interval=USEC] [--journal-batch=N] [--journal-nosync]
+ *          [--checkpoint-interval=SEC] [--io=sync|uring]
+ *          [--mode=fork|epoll|prefork] [--workers=N] [--recycle-after=N]
  * ========================================
  */
 
@@ -25,34 +37,85 @@
 #include <arpa/inet.h>
 #include <time.h>
 #include <fcntl.h>
+#include <getopt.h>
 
 #include "server_logic.h"
 #include "utils.h"
+#include "bank_storage.h"
+#include "storage.h"
+#include "record_index.h"
+#include "btree.h"
+#include "txn_log.h"
+#include "txn_index.h"
+#include "txn_time_index.h"
+#include "loan_index.h"
+#include "journal.h"
+#include "wal.h"
+#include "ledger.h"
+#include "account_import.h"
+#include "uring.h"
+#include "event_server.h"
+#include "prefork_server.h"
+#include "binary_protocol.h"
+#include "command_mode.h"
 
 #define SERVER_PORT 8080
 
-// --- Global Buffers ---
-char g_read_buffer[1024];
-char g_write_buffer[1024];
+// --- Connection Handling Modes ---
+#define SERVER_MODE_FORK 0  // One child process per client
+#define SERVER_MODE_EPOLL 1 // Worker threads multiplexing clients with epoll
+#define SERVER_MODE_PREFORK 2 // Long-lived worker processes, one listener each
+
+// Startup configuration chosen on the command line
+struct ServerOptions {
+    int storage_engine;
+    int sync_policy;
+    struct JournalConfig journal;
+    int checkpoint_interval_sec;
+    int io_uring;
+    int mode;
+    int workers;        // 0: the mode's default
+    long recycle_after; // Prefork: sessions per worker process (0: never recycle)
+};
 
 // --- Function Prototypes ---
 void handle_client_connection(int client_socket);
 void sigint_handler(int signum);
 void sigchld_handler(int signum);
+static void parse_server_options(int argc, char* argv[], struct ServerOptions* options);
+static void init_shared_storage(const struct ServerOptions* options);
+static void run_event_server(int server_fd, const struct ServerOptions* options);
+static void run_prefork_server(const struct ServerOptions* options);
 
 // --- Globals for Graceful Shutdown ---
 static volatile sig_atomic_t g_server_running = 1;
 static volatile int g_server_fd = -1;
 
-int main() {
+int main(int argc, char* argv[]) {
     int server_fd, client_fd;
     struct sockaddr_in server_addr, client_addr;
     socklen_t client_len;
+    struct ServerOptions options = {
+        STORAGE_FILE, STORAGE_SYNC_NONE,
+        {JOURNAL_DEFAULT_INTERVAL_US, JOURNAL_DEFAULT_BATCH_SIZE, 1},
+        WAL_DEFAULT_CHECKPOINT_SEC, 0,
+        SERVER_MODE_FORK, 0, PREFORK_DEFAULT_RECYCLE
+    };
+
+    parse_server_options(argc, argv, &options);
 
     signal(SIGINT, sigint_handler);
     signal(SIGCHLD, sigchld_handler);
     signal(SIGPIPE, SIG_IGN); 
 
+    // Before the socket exists, so the WAL checkpointer does not inherit it
+    init_shared_storage(&options);
+
+    if (options.mode == SERVER_MODE_PREFORK) {
+        run_prefork_server(&options); // Each worker opens its own listener
+        return 0;
+    }
+
     server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd == -1) {
         perror("Socket creation failed");
@@ -77,13 +140,19 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 10) == -1) {
+    if (listen(server_fd, (options.mode == SERVER_MODE_EPOLL) ? SOMAXCONN : 10) == -1) {
         perror("Listen failed");
         close(server_fd);
         exit(EXIT_FAILURE);
     }
 
-    printf("Server listening on port %d...\n", SERVER_PORT);
+    if (options.mode == SERVER_MODE_EPOLL) {
+        run_event_server(server_fd, &options);
+        return 0;
+    }
+
+    printf("Server listening on port %d (%s storage%s)...\n", SERVER_PORT, storage_engine_name(),
+           uring_enabled() ? ", io_uring" : "");
 
     // --- Accept Loop ---
     while (g_server_running) {
@@ -115,8 +184,7 @@ int main() {
             handle_client_connection(client_fd);
 
             printf("Client %s disconnected. Child %d exiting.\n", client_ip, getpid());
-            close(client_fd);
-            exit(0);
+            end_client_session(client_fd);
         } else {
             // --- Parent Process ---
             close(client_fd); // Parent doesn't need the client socket
@@ -124,10 +192,213 @@ int main() {
     }
 
     // --- Shutdown ---
+    // A clean tree is reused on the next start instead of being rebuilt
+    btree_flush(g_account_btree);
+    btree_flush(g_staff_btree);
     printf("\nServer shutdown complete.\n");
     return 0;
 }
 
+/**
+ * @brief Serves every client from a pool of worker threads (--mode=epoll)
+ * until SIGINT. Sessions share this process, so the storage engine
+ * switches to locks that exclude threads as well as processes.
+ */
+static void run_event_server(int server_fd, const struct ServerOptions* options) {
+    if (storage_init_threads() == -1) {
+        fprintf(stderr, "Fatal: storage could not be prepared for threaded sessions.\n");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+
+    int workers = (options->workers > 0) ? options->workers : EVENT_DEFAULT_WORKERS;
+    printf("Server listening on port %d (%s storage%s, epoll, %d workers)...\n", SERVER_PORT,
+           storage_engine_name(), uring_enabled() ? ", io_uring" : "", workers);
+    if (event_server_run(server_fd, workers, handle_client_connection, &g_server_running) == -1) {
+        fprintf(stderr, "Fatal: event server could not start.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // --- Shutdown ---
+    btree_flush(g_account_btree);
+    btree_flush(g_staff_btree);
+    printf("\nServer shutdown complete.\n");
+}
+
+/**
+ * @brief Serves clients from pre-forked worker processes (--mode=prefork)
+ * until SIGINT. Each worker multiplexes its sessions like an epoll
+ * worker thread, so the engine needs the same locks.
+ */
+static void run_prefork_server(const struct ServerOptions* options) {
+    if (storage_init_threads() == -1) {
+        fprintf(stderr, "Fatal: storage could not be prepared for multiplexed sessions.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int workers = (options->workers > 0) ? options->workers : prefork_default_workers();
+    printf("Server listening on port %d (%s storage%s, prefork, %d workers)...\n", SERVER_PORT,
+           storage_engine_name(), uring_enabled() ? ", io_uring" : "", workers);
+    fflush(stdout); // Not duplicated into the workers' buffers
+    if (prefork_server_run(SERVER_PORT, workers, options->recycle_after, handle_client_connection,
+                           &g_server_running) == -1) {
+        fprintf(stderr, "Fatal: worker processes could not start on port %d.\n", SERVER_PORT);
+        exit(EXIT_FAILURE);
+    }
+
+    // --- Shutdown ---
+    btree_flush(g_account_btree);
+    btree_flush(g_staff_btree);
+    printf("\nServer shutdown complete.\n");
+}
+
+/**
+ * @brief Parses command-line options (storage engine, journal tuning, I/O path).
+ */
+static void parse_server_options(int argc, char* argv[], struct ServerOptions* options) {
+    static const struct option long_options[] = {
+        {"storage", required_argument, NULL, 's'},
+        {"msync", required_argument, NULL, 'y'},
+        {"journal-interval", required_argument, NULL, 'i'},
+        {"journal-batch", required_argument, NULL, 'b'},
+        {"journal-nosync", no_argument, NULL, 'n'},
+        {"checkpoint-interval", required_argument, NULL, 'c'},
+        {"io", required_argument, NULL, 'u'},
+        {"mode", required_argument, NULL, 'm'},
+        {"workers", required_argument, NULL, 'w'},
+        {"recycle-after", required_argument, NULL, 'r'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:y:i:b:nc:u:m:w:r:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                if (strcmp(optarg, "file") == 0) options->storage_engine = STORAGE_FILE;
+                else if (strcmp(optarg, "mmap") == 0) options->storage_engine = STORAGE_MMAP;
+                else if (strcmp(optarg, "memory") == 0) options->storage_engine = STORAGE_MEMORY;
+                else goto usage;
+                break;
+            case 'y':
+                if (strcmp(optarg, "none") == 0) options->sync_policy = STORAGE_SYNC_NONE;
+                else if (strcmp(optarg, "async") == 0) options->sync_policy = STORAGE_SYNC_ASYNC;
+                else if (strcmp(optarg, "sync") == 0) options->sync_policy = STORAGE_SYNC_SYNC;
+                else goto usage;
+                break;
+            case 'i': options->journal.flush_interval_us = atol(optarg); break;
+            case 'b': options->journal.batch_size = atoi(optarg); break;
+            case 'n': options->journal.sync_on_commit = 0; break;
+            case 'c': options->checkpoint_interval_sec = atoi(optarg); break;
+            case 'u':
+                if (strcmp(optarg, "sync") == 0) options->io_uring = 0;
+                else if (strcmp(optarg, "uring") == 0) options->io_uring = 1;
+                else goto usage;
+                break;
+            case 'm':
+                if (strcmp(optarg, "fork") == 0) options->mode = SERVER_MODE_FORK;
+                else if (strcmp(optarg, "epoll") == 0) options->mode = SERVER_MODE_EPOLL;
+                else if (strcmp(optarg, "prefork") == 0) options->mode = SERVER_MODE_PREFORK;
+                else goto usage;
+                break;
+            case 'w':
+                options->workers = atoi(optarg);
+                if (options->workers < 1 || options->workers > EVENT_MAX_WORKERS) goto usage;
+                break;
+            case 'r':
+                options->recycle_after = atol(optarg);
+                if (options->recycle_after < 0) goto usage;
+                break;
+            default:
+                goto usage;
+        }
+    }
+    return;
+
+usage:
+    fprintf(stderr, "Usage: %s [--storage=file|mmap|memory] [--msync=none|async|sync]\n"
+                    "       [--journal-interval=USEC] [--journal-batch=N] [--journal-nosync]\n"
+                    "       [--checkpoint-interval=SEC] [--io=sync|uring]\n"
+                    "       [--mode=fork|epoll|prefork] [--workers=N] [--recycle-after=N]\n", argv[0]);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Selects the storage engine and builds every shared index and
+ * journal. Runs before the first fork so that all children inherit the
+ * same shared memory. The MEMORY engine starts empty and keeps nothing
+ * on disk, so it skips recovery, the WAL and the transaction log files.
+ */
+static void init_shared_storage(const struct ServerOptions* options) {
+    int in_memory = (options->storage_engine == STORAGE_MEMORY);
+    int wal_ready = 0;
+    if (uring_init(options->io_uring) == -1) {
+        fprintf(stderr, "Warning: io_uring unavailable, using synchronous I/O.\n");
+    }
+    if (!in_memory) {
+        if (txn_log_init() == -1) {
+            fprintf(stderr, "Warning: transaction log unavailable, history will not be recorded.\n");
+        }
+        // A bulk load that never finished is undone before anything reads the tables
+        if (account_import_recover() == -1) {
+            fprintf(stderr, "Fatal: an unfinished bulk load could not be rolled back.\n");
+            exit(EXIT_FAILURE);
+        }
+        // Replay next: every index below is built from the recovered files
+        wal_ready = (wal_recover() == 0);
+        // Everything below reads the current format; old files must be upgraded first,
+        // and only once their WAL has been replayed in the old layout
+        if ((!wal_ready && ledger_data_format() < DATA_FORMAT_VERSION) || ledger_upgrade_data_files() == -1) {
+            fprintf(stderr, "Fatal: %s and %s could not be upgraded to the current format.\n", ACCOUNT_DB_FILE, LOAN_DB_FILE);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (storage_init(options->storage_engine, options->sync_policy) == -1) {
+        if (in_memory) {
+            fprintf(stderr, "Fatal: in-memory storage could not be allocated.\n");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stderr, "Warning: mmap storage unavailable, using the file engine.\n");
+    }
+
+    g_account_index = record_index_create(ACCOUNT_INDEX_CAPACITY);
+    if (g_account_index == NULL || record_index_build(g_account_index, STORAGE_ACCOUNTS) == -1) {
+        fprintf(stderr, "Warning: account index unavailable, falling back to table scans.\n");
+    }
+    g_staff_index = record_index_create(STAFF_INDEX_CAPACITY);
+    if (g_staff_index == NULL || record_index_build(g_staff_index, STORAGE_STAFF) == -1) {
+        fprintf(stderr, "Warning: staff index unavailable, falling back to table scans.\n");
+    }
+
+    if (!in_memory) {
+        // Ordered indexes live in files of their own, so the MEMORY engine has none
+        g_account_btree = btree_open(ACCOUNT_BTREE_FILE, STORAGE_ACCOUNTS, ACCOUNT_BTREE_FRAMES);
+        g_staff_btree = btree_open(STAFF_BTREE_FILE, STORAGE_STAFF, STAFF_BTREE_FRAMES);
+        if (g_account_btree == NULL || g_staff_btree == NULL) {
+            fprintf(stderr, "Warning: B+tree index unavailable, range listings will scan and sort.\n");
+        }
+        txn_index_init();
+        if (txn_time_index_init() == -1) {
+            fprintf(stderr, "Warning: transaction time index unavailable, date-range queries will scan the log.\n");
+        }
+        if (!wal_ready || wal_init(&options->journal, options->checkpoint_interval_sec) == -1) {
+            fprintf(stderr, "Warning: WAL unavailable, updates will not be write-ahead logged.\n");
+        }
+
+        // With a WAL the log entries are already durable in it; checkpoints fsync the log
+        struct JournalConfig log_config = options->journal;
+        if (g_wal_journal != NULL) log_config.sync_on_commit = 0;
+        g_transaction_journal = journal_create_with_writer(sizeof(struct Transaction), txn_log_record_count(),
+                                                           &log_config, txn_log_write, txn_index_commit_batch);
+        if (g_transaction_journal == NULL) {
+            fprintf(stderr, "Warning: transaction journal unavailable, logging without group commit.\n");
+        }
+    }
+    if (loan_index_init() == -1) {
+        fprintf(stderr, "Warning: loan index unavailable, loan views will scan the loans table.\n");
+    }
+}
+
 /**
  * @brief Handles the main menu and routing for a connected client.
  */
@@ -149,11 +420,23 @@ void handle_client_connection(int client_socket) {
             break;
         }
 
+        // Machine clients announce the binary protocol with its first byte
+        if (peek_input(client_socket) == BINARY_PROTOCOL_MAGIC) {
+            handle_binary_session(client_socket);
+            break;
+        }
+
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) {
             printf("Client disconnected from main menu.\n");
             break;
         }
 
+        // Automated clients skip the menus with one-line commands
+        if (is_command_line(g_read_buffer)) {
+            handle_command_session(client_socket, g_read_buffer);
+            break;
+        }
+
         choice = atoi(g_read_buffer);
 
         switch (choice) {
@@ -9,6 +9,17 @@
 #include "server_logic.h"
 #include "bank_storage.h"
 #include "utils.h"
+#include "account_store.h"
+#include "storage.h"
+#include "record_index.h"
+#include "btree.h"
+#include "loan_index.h"
+#include "wal.h"
+#include "ledger.h"
+#include "account_import.h"
+#include "txn_time_index.h"
+#include "statement.h"
+#include "bank_ops.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,9 +30,15 @@
 #include <errno.h>
 #include <signal.h>
 #include <semaphore.h> 
+#include <limits.h>
 
 // --- Global buffers are defined in server.c ---
 
+// Loans listed per queue view; more would not fit in g_write_buffer anyway
+#define LOAN_VIEW_MAX 32
+// Accounts or staff listed per ID-ordered view
+#define ID_LIST_MAX 16
+
 
 // =======================================
 // CUSTOMER ROLE
@@ -31,7 +48,6 @@
 void handle_customer_session(int client_socket) {
     int logged_in_id = -1;
     sem_t* session_sem = NULL;
-    char sem_name[50];
     
     // --- Login Loop ---
     while (logged_in_id == -1) {
@@ -43,28 +59,20 @@ void handle_customer_session(int client_socket) {
         if (send_response(client_socket, "PROMPT_MASKED", "Enter PIN: ") <= 0) return;
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         
-        session_sem = create_session_lock(account_id, sem_name, sizeof(sem_name));
-        if (session_sem == NULL) {
-            send_response(client_socket, "ERROR", "Server session error. Try again.");
+        int locked = acquire_session_lock(account_id, &session_sem);
+        if (locked == 1) {
+            send_response(client_socket, "ERROR", "This account is already logged in elsewhere.");
             continue;
         }
-
-        if (sem_trywait(session_sem) == -1) {
-            if (errno == EAGAIN) {
-                send_response(client_socket, "ERROR", "This account is already logged in elsewhere.");
-            } else {
-                perror("sem_trywait");
-                send_response(client_socket, "ERROR", "Server lock error.");
-            }
-            sem_close(session_sem);
+        if (locked == -1) {
+            send_response(client_socket, "ERROR", "Server session error. Try again.");
             continue;
         }
         
         if (login_customer(client_socket, account_id, g_read_buffer)) {
             logged_in_id = account_id;
             send_response(client_socket, "SUCCESS", "Login successful.");
-            signal(SIGINT, handle_unexpected_disconnect);
-            signal(SIGPIPE, handle_unexpected_disconnect);
+            watch_session_disconnect();
         } else {
             // Use release_session_lock for a FAILED login
             release_session_lock(account_id, session_sem);
@@ -74,15 +82,15 @@ void handle_customer_session(int client_socket) {
 
     // --- Main Menu Loop ---
     int choice = 0;
-    while (choice != 9 && choice != 10) {
+    while (choice != 10 && choice != 11) {
         const char* menu =
             "Customer Menu:\\n"
             "1. Deposit Money\\n2. Withdraw Money\\n3. View Balance\\n"
             "4. Transfer Funds\\n5. Apply for Loan\\n6. View Transaction History\\n"
-            "7. Change PIN\\n8. Submit Feedback\\n9. Logout\\n10. Exit\\nChoice: ";
+            "7. Change PIN\\n8. Submit Feedback\\n9. Export Full Statement\\n10. Logout\\n11. Exit\\nChoice: ";
         
-        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 10; break; }
-        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 10; break; }
+        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 11; break; }
+        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 11; break; }
         choice = atoi(g_read_buffer);
 
         switch (choice) {
@@ -94,22 +102,22 @@ void handle_customer_session(int client_socket) {
             case 6: handle_view_transactions(client_socket, logged_in_id); break;
             case 7: 
                 handle_customer_password_change(client_socket, logged_in_id);
-                choice = 9; // Force logout
+                choice = 10; // Force logout
                 break;
             case 8: handle_submit_feedback(client_socket); break;
-            case 9: printf("Customer %d selected logout.\n", logged_in_id); break;
-            case 10: printf("Customer %d selected exit.\n", logged_in_id); break;
+            case 9: handle_export_statement(client_socket, logged_in_id); break;
+            case 10: printf("Customer %d selected logout.\n", logged_in_id); break;
+            case 11: printf("Customer %d selected exit.\n", logged_in_id); break;
             default: send_response(client_socket, "ERROR", "Invalid choice.");
         }
     }
 
     // --- Cleanup ---
-    if (choice == 10) { // Exit
+    if (choice == 11) { // Exit
         // Send logout message, which tells client to exit
         handle_session_logout(client_socket, logged_in_id, session_sem);
-        close(client_socket);
-        exit(0); // Terminate the child process
-    } else { // Logout (choice 9) or password change
+        end_client_session(client_socket);
+    } else { // Logout (choice 10) or password change
         // Just release the lock, don't send logout message
         release_session_lock(logged_in_id, session_sem);
         // Now the function will return to handle_client_connection,
@@ -121,156 +129,108 @@ void handle_customer_session(int client_socket) {
 
 int login_customer(int client_socket, int account_id, const char* pin) {
     struct CustomerAccount account;
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDONLY);
-    if (db_fd == -1) {
-        if (errno == ENOENT) { // First run, create file
-             db_fd = open(ACCOUNT_DB_FILE, O_WRONLY | O_CREAT, 0644);
-             if (db_fd != -1) close(db_fd);
-        }
-        return 0; // DB error or file just created
-    }
+    if (account_store_open() == -1) return 0; // DB error (file is created on first run)
 
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) {
-        close(db_fd);
-        return 0; // Not found
-    }
-
-    lseek(db_fd, offset, SEEK_SET);
-    read(db_fd, &account, sizeof(account));
-    close(db_fd);
+    int record = account_store_find(account_id);
+    if (record == -1) return 0; // Not found
+    if (account_store_read(record, &account) == -1) return 0;
 
     return (strcmp(account.access_pin, pin) == 0 && account.is_active);
 }
 
 void handle_deposit(int client_socket, int account_id) {
-    struct CustomerAccount account;
-    struct flock lock;
-    double amount;
-    
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
-
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) { send_response(client_socket, "ERROR", "Account not found."); close(db_fd); return; }
-
-    if (send_response(client_socket, "PROMPT", "Enter amount to deposit: ") <= 0) { close(db_fd); return; }
-    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { close(db_fd); return; }
-    amount = atof(g_read_buffer);
-    if (amount <= 0) { send_response(client_socket, "ERROR", "Invalid deposit amount."); close(db_fd); return; }
+    money_t amount, balance;
     
-    memset(&lock, 0, sizeof(lock));
-    lock.l_type = F_WRLCK; lock.l_whence = SEEK_SET; lock.l_start = offset; lock.l_len = sizeof(struct CustomerAccount);
+    if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
 
-    if (fcntl(db_fd, F_SETLKW, &lock) == -1) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); close(db_fd); return; }
+    int record = account_store_find(account_id);
+    if (record == -1) { send_response(client_socket, "ERROR", "Account not found."); return; }
 
-    lseek(db_fd, offset, SEEK_SET); read(db_fd, &account, sizeof(account));
-    account.balance += amount;
-    lseek(db_fd, offset, SEEK_SET); write(db_fd, &account, sizeof(account));
-    lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
-
-    log_transaction(account_id, "DEPOSIT", amount, account.balance);
-    snprintf(g_write_buffer, sizeof(g_write_buffer), "Deposit successful. New balance: %.2f", account.balance);
+    if (send_response(client_socket, "PROMPT", "Enter amount to deposit: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    if (parse_money(g_read_buffer, &amount) == -1 || amount <= 0) { send_response(client_socket, "ERROR", "Invalid deposit amount."); return; }
+    
+    int result = bank_deposit(account_id, amount, &balance);
+    if (result == BANK_LOCK_FAILED) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); return; }
+    if (result == BANK_NOT_FOUND) { send_response(client_socket, "ERROR", "Account not found."); return; }
+    if (result == BANK_NOT_RECORDED) { send_response(client_socket, "ERROR", "Server database error. Deposit not recorded."); return; }
+    if (result != BANK_OK) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    snprintf(g_write_buffer, sizeof(g_write_buffer), "Deposit successful. New balance: " MONEY_FMT, MONEY_ARGS(balance));
     send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
 void handle_withdrawal(int client_socket, int account_id) {
-    struct CustomerAccount account;
-    struct flock lock;
-    double amount;
-    
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    money_t amount, balance;
     
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) { send_response(client_socket, "ERROR", "Account not found."); close(db_fd); return; }
-
-    if (send_response(client_socket, "PROMPT", "Enter amount to withdraw: ") <= 0) { close(db_fd); return; }
-    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { close(db_fd); return; }
-    amount = atof(g_read_buffer);
-    if (amount <= 0) { send_response(client_socket, "ERROR", "Invalid withdrawal amount."); close(db_fd); return; }
+    if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    memset(&lock, 0, sizeof(lock));
-    lock.l_type = F_WRLCK; lock.l_whence = SEEK_SET; lock.l_start = offset; lock.l_len = sizeof(struct CustomerAccount);
-
-    if (fcntl(db_fd, F_SETLKW, &lock) == -1) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); close(db_fd); return; }
+    int record = account_store_find(account_id);
+    if (record == -1) { send_response(client_socket, "ERROR", "Account not found."); return; }
 
-    lseek(db_fd, offset, SEEK_SET); read(db_fd, &account, sizeof(account));
+    if (send_response(client_socket, "PROMPT", "Enter amount to withdraw: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    if (parse_money(g_read_buffer, &amount) == -1 || amount <= 0) { send_response(client_socket, "ERROR", "Invalid withdrawal amount."); return; }
     
-    if (account.balance < amount) {
-        snprintf(g_write_buffer, sizeof(g_write_buffer), "Insufficient funds. Current balance: %.2f", account.balance);
+    int result = bank_withdraw(account_id, amount, &balance);
+    if (result == BANK_INSUFFICIENT_FUNDS) {
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Insufficient funds. Current balance: " MONEY_FMT, MONEY_ARGS(balance));
         send_response(client_socket, "ERROR", g_write_buffer);
+    } else if (result == BANK_LOCK_FAILED) {
+        send_response(client_socket, "ERROR", "Failed to lock account. Try again.");
+    } else if (result == BANK_NOT_FOUND) {
+        send_response(client_socket, "ERROR", "Account not found.");
+    } else if (result == BANK_NOT_RECORDED) {
+        send_response(client_socket, "ERROR", "Server database error. Withdrawal not recorded.");
+    } else if (result != BANK_OK) {
+        send_response(client_socket, "ERROR", "Server database error.");
     } else {
-        account.balance -= amount;
-        lseek(db_fd, offset, SEEK_SET); write(db_fd, &account, sizeof(account));
-        log_transaction(account_id, "WITHDRAWAL", -amount, account.balance);
-        snprintf(g_write_buffer, sizeof(g_write_buffer), "Withdrawal successful. New balance: %.2f", account.balance);
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Withdrawal successful. New balance: " MONEY_FMT, MONEY_ARGS(balance));
         send_response(client_socket, "SUCCESS", g_write_buffer);
     }
-    
-    lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
 }
 
 void handle_balance_check(int client_socket, int account_id) {
-    struct CustomerAccount account;
-    struct flock lock;
-    
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDONLY);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    money_t balance;
     
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) { send_response(client_socket, "ERROR", "Account not found."); close(db_fd); return; }
-    
-    memset(&lock, 0, sizeof(lock));
-    lock.l_type = F_RDLCK; lock.l_whence = SEEK_SET; lock.l_start = offset; lock.l_len = sizeof(struct CustomerAccount);
-
-    if (fcntl(db_fd, F_SETLKW, &lock) == -1) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); close(db_fd); return; }
+    int result = bank_balance(account_id, &balance);
+    if (result == BANK_NOT_FOUND) { send_response(client_socket, "ERROR", "Account not found."); return; }
+    if (result != BANK_OK) { send_response(client_socket, "ERROR", "Server database error."); return; }
 
-    lseek(db_fd, offset, SEEK_SET); read(db_fd, &account, sizeof(account));
-    lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
-
-    snprintf(g_write_buffer, sizeof(g_write_buffer), "Current balance: %.2f", account.balance);
+    snprintf(g_write_buffer, sizeof(g_write_buffer), "Current balance: " MONEY_FMT, MONEY_ARGS(balance));
     send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
 void handle_customer_password_change(int client_socket, int account_id) {
     struct CustomerAccount account;
-    struct flock lock;
     char new_pin[50];
     
     if (send_response(client_socket, "PROMPT_MASKED", "Enter new PIN: ") <= 0) return;
     if (read_line(client_socket, new_pin, sizeof(new_pin)) <= 0) return;
     if (strlen(new_pin) == 0) { send_response(client_socket, "ERROR", "PIN cannot be empty."); return; }
     
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) { send_response(client_socket, "ERROR", "Account not found."); close(db_fd); return; }
+    int record = account_store_find(account_id);
+    if (record == -1) { send_response(client_socket, "ERROR", "Account not found."); return; }
 
-    memset(&lock, 0, sizeof(lock));
-    lock.l_type = F_WRLCK; lock.l_whence = SEEK_SET; lock.l_start = offset; lock.l_len = sizeof(struct CustomerAccount);
-    
-    if (fcntl(db_fd, F_SETLKW, &lock) == -1) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); close(db_fd); return; }
+    if (account_store_lock(record, 1) == -1) { send_response(client_socket, "ERROR", "Failed to lock account. Try again."); return; }
 
-    lseek(db_fd, offset, SEEK_SET); read(db_fd, &account, sizeof(account));
+    account_store_read(record, &account);
     strncpy(account.access_pin, new_pin, sizeof(account.access_pin) - 1);
     account.access_pin[sizeof(account.access_pin) - 1] = '\0';
-    lseek(db_fd, offset, SEEK_SET); write(db_fd, &account, sizeof(account));
-    lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
+    struct WalRecord wal;
+    wal_begin(&wal);
+    wal_add_account(&wal, record, &account, 0);
+    int committed = wal_commit(&wal);
+    account_store_unlock(record);
     
+    if (committed == -1) { send_response(client_socket, "ERROR", "Server database error. PIN not changed."); return; }
     send_response(client_socket, "SUCCESS", "PIN changed successfully. You will be logged out.");
 }
 
 void handle_fund_transfer(int client_socket, int source_account_id) {
-    struct CustomerAccount source_ac, dest_ac;
-    struct flock lock_src, lock_dest;
     int dest_account_id;
-    double amount;
+    money_t amount, balance;
 
     if (send_response(client_socket, "PROMPT", "Enter destination account ID: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
@@ -278,134 +238,66 @@ void handle_fund_transfer(int client_socket, int source_account_id) {
     
     if (send_response(client_socket, "PROMPT", "Enter amount to transfer: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
-    amount = atof(g_read_buffer);
+    int amount_ok = (parse_money(g_read_buffer, &amount) == 0 && amount > 0);
 
     if (source_account_id == dest_account_id) { send_response(client_socket, "ERROR", "Cannot transfer to the same account."); return; }
-    if (amount <= 0) { send_response(client_socket, "ERROR", "Invalid transfer amount."); return; }
+    if (!amount_ok) { send_response(client_socket, "ERROR", "Invalid transfer amount."); return; }
 
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
-    
-    off_t offset_src = find_customer_record_offset(db_fd, source_account_id);
-    off_t offset_dest = find_customer_record_offset(db_fd, dest_account_id);
-
-    if (offset_dest == -1) { send_response(client_socket, "ERROR", "Destination account not found."); close(db_fd); return; }
-
-    memset(&lock_src, 0, sizeof(lock_src));
-    lock_src.l_type = F_WRLCK; lock_src.l_whence = SEEK_SET; lock_src.l_start = offset_src; lock_src.l_len = sizeof(struct CustomerAccount);
-    
-    memset(&lock_dest, 0, sizeof(lock_dest));
-    lock_dest.l_type = F_WRLCK; lock_dest.l_whence = SEEK_SET; lock_dest.l_start = offset_dest; lock_dest.l_len = sizeof(struct CustomerAccount);
-    
-    if (offset_src < offset_dest) { fcntl(db_fd, F_SETLKW, &lock_src); fcntl(db_fd, F_SETLKW, &lock_dest); }
-    else { fcntl(db_fd, F_SETLKW, &lock_dest); fcntl(db_fd, F_SETLKW, &lock_src); }
-
-    lseek(db_fd, offset_src, SEEK_SET); read(db_fd, &source_ac, sizeof(source_ac));
-    lseek(db_fd, offset_dest, SEEK_SET); read(db_fd, &dest_ac, sizeof(dest_ac));
-
-    if (source_ac.balance < amount) {
-        snprintf(g_write_buffer, sizeof(g_write_buffer), "Insufficient funds. Current balance: %.2f", source_ac.balance);
+    int result = bank_transfer(source_account_id, dest_account_id, amount, &balance);
+    if (result == BANK_INSUFFICIENT_FUNDS) {
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Insufficient funds. Current balance: " MONEY_FMT, MONEY_ARGS(balance));
         send_response(client_socket, "ERROR", g_write_buffer);
-    } else if (dest_ac.is_active == 0) {
+    } else if (result == BANK_DEST_NOT_FOUND) {
+        send_response(client_socket, "ERROR", "Destination account not found.");
+    } else if (result == BANK_NOT_FOUND) {
+        send_response(client_socket, "ERROR", "Account not found.");
+    } else if (result == BANK_LOCK_FAILED) {
+        send_response(client_socket, "ERROR", "Failed to lock account. Try again.");
+    } else if (result == BANK_DEST_INACTIVE) {
         send_response(client_socket, "ERROR", "Destination account is inactive.");
+    } else if (result == BANK_NOT_RECORDED) {
+        send_response(client_socket, "ERROR", "Server database error. Transfer not recorded.");
+    } else if (result != BANK_OK) {
+        send_response(client_socket, "ERROR", "Server database error.");
     } else {
-        source_ac.balance -= amount; dest_ac.balance += amount;
-        lseek(db_fd, offset_src, SEEK_SET); write(db_fd, &source_ac, sizeof(source_ac));
-        lseek(db_fd, offset_dest, SEEK_SET); write(db_fd, &dest_ac, sizeof(dest_ac));
-        
-        log_transaction(source_account_id, "TRANSFER_OUT", -amount, source_ac.balance);
-        log_transaction(dest_account_id, "TRANSFER_IN", amount, dest_ac.balance);
-        
-        snprintf(g_write_buffer, sizeof(g_write_buffer), "Transfer successful. New balance: %.2f", source_ac.balance);
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Transfer successful. New balance: " MONEY_FMT, MONEY_ARGS(balance));
         send_response(client_socket, "SUCCESS", g_write_buffer);
     }
-
-    lock_src.l_type = F_UNLCK; lock_dest.l_type = F_UNLCK;
-    fcntl(db_fd, F_SETLK, &lock_src); fcntl(db_fd, F_SETLK, &lock_dest);
-    close(db_fd);
 }
 
 void handle_loan_request(int client_socket, int account_id) {
-    struct LoanApplication loan;
-    struct IDCounter counter;
-    int loan_fd, counter_fd;
-    double amount;
+    money_t amount;
+    int loan_id;
 
     if (send_response(client_socket, "PROMPT", "Enter loan amount: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
-    amount = atof(g_read_buffer);
-    if (amount <= 0) { send_response(client_socket, "ERROR", "Invalid loan amount."); return; }
+    if (parse_money(g_read_buffer, &amount) == -1 || amount <= 0) { send_response(client_socket, "ERROR", "Invalid loan amount."); return; }
 
-    counter_fd = open(LOAN_COUNTER_FILE, O_RDWR | O_CREAT, 0644);
-    if (counter_fd == -1) { send_response(client_socket, "ERROR", "Server counter file error."); return; }
-    
-    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(counter_fd, F_SETLKW, &lock);
-
-    if (read(counter_fd, &counter, sizeof(counter)) <= 0) { counter.next_loan_id = 1; }
-    loan.loan_id = counter.next_loan_id;
-    counter.next_loan_id++;
-    lseek(counter_fd, 0, SEEK_SET); write(counter_fd, &counter, sizeof(counter));
-    lock.l_type = F_UNLCK; fcntl(counter_fd, F_SETLK, &lock);
-    close(counter_fd);
-    
-    loan_fd = open(LOAN_DB_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (loan_fd == -1) { send_response(client_socket, "ERROR", "Server loan database error."); return; }
-    
-    loan.customer_account_id = account_id;
-    loan.amount = amount;
-    loan.status = 0; // 0 = Requested
-    loan.assigned_to_employee_id = -1;
-
-    lock.l_type = F_WRLCK; lock.l_start = 0;
-    fcntl(loan_fd, F_SETLKW, &lock);
-    write(loan_fd, &loan, sizeof(loan));
-    lock.l_type = F_UNLCK; fcntl(loan_fd, F_SETLK, &lock);
-    close(loan_fd);
-
-    snprintf(g_write_buffer, sizeof(g_write_buffer), "Loan request #%d for %.2f submitted.", loan.loan_id, amount);
+    int result = bank_request_loan(account_id, amount, &loan_id);
+    if (result == BANK_NO_LOAN_ID) { send_response(client_socket, "ERROR", "Server counter file error."); return; }
+    if (result != BANK_OK) { send_response(client_socket, "ERROR", "Server loan database error."); return; }
+
+    snprintf(g_write_buffer, sizeof(g_write_buffer), "Loan request #%d for " MONEY_FMT " submitted.", loan_id, MONEY_ARGS(amount));
     send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
 void handle_view_transactions(int client_socket, int account_id) {
-    struct Transaction log_entry;
     const int MAX_LOGS = 10;
-    struct Transaction user_logs[MAX_LOGS];
-    int log_count = 0;
+    struct Transaction user_logs[MAX_LOGS]; // Newest first
     
-    int log_fd = open(TRANSACTION_DB_FILE, O_RDONLY);
-    if (log_fd == -1) {
-        if (errno == ENOENT) { send_response(client_socket, "SUCCESS", "No transactions found."); return; }
-        send_response(client_socket, "ERROR", "Server log database error.");
-        return;
-    }
-    
-    struct flock lock = {F_RDLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(log_fd, F_SETLKW, &lock);
-
-    while (read(log_fd, &log_entry, sizeof(log_entry)) == sizeof(log_entry)) {
-        if (log_entry.account_id == account_id) {
-            user_logs[log_count % MAX_LOGS] = log_entry;
-            log_count++;
-        }
-    }
-    
-    lock.l_type = F_UNLCK; fcntl(log_fd, F_SETLK, &lock);
-    close(log_fd);
-
+    int log_count = storage_recent_transactions(account_id, user_logs, MAX_LOGS);
+    if (log_count == -1) { send_response(client_socket, "ERROR", "Server log database error."); return; }
     if (log_count == 0) { send_response(client_socket, "SUCCESS", "No transactions found."); return; }
 
     bzero(g_write_buffer, sizeof(g_write_buffer));
     strcat(g_write_buffer, "Last Transactions:\\n");
     
-    int start = (log_count < MAX_LOGS) ? 0 : (log_count % MAX_LOGS);
-    int num_to_print = (log_count < MAX_LOGS) ? log_count : MAX_LOGS;
-
-    for (int i = 0; i < num_to_print; i++) {
-        struct Transaction* entry = &user_logs[(start + i) % MAX_LOGS];
+    // Print oldest to newest, as before
+    for (int i = log_count - 1; i >= 0; i--) {
+        struct Transaction* entry = &user_logs[i];
         char line[200];
-        snprintf(line, sizeof(line), "[%s] %s | Balance: %.2f\\n",
-                 entry->timestamp, entry->description, entry->resulting_balance);
+        format_transaction(entry, line, sizeof(line) - 2);
+        strcat(line, "\\n");
         if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 1) {
             strcat(g_write_buffer, line);
         } else {
@@ -415,23 +307,51 @@ void handle_view_transactions(int client_socket, int account_id) {
     send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
+/**
+ * @brief Sends the account's complete history as a CSV or binary file.
+ * The statement is rendered into memory and streamed with sendfile(), so
+ * it is not limited to g_write_buffer; the client saves it to disk.
+ */
+void handle_export_statement(int client_socket, int account_id) {
+    if (send_response(client_socket, "PROMPT", "Statement format (1 = CSV, 2 = Binary): ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    int choice = atoi(g_read_buffer);
+    if (choice != 1 && choice != 2) { send_response(client_socket, "ERROR", "Invalid format."); return; }
+    int format = (choice == 1) ? STATEMENT_CSV : STATEMENT_BINARY;
+
+    struct Statement statement;
+    if (statement_render(account_id, format, &statement) == -1) {
+        send_response(client_socket, "ERROR", "Server log database error.");
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "statement_%d.%s", account_id, format == STATEMENT_CSV ? "csv" : "bin");
+    int rc = statement_send(client_socket, &statement, name);
+    statement_close(&statement);
+    if (rc == -1) return; // The connection is gone; the menu loop ends the session
+
+    snprintf(g_write_buffer, sizeof(g_write_buffer), "Statement exported: %lld transactions, %lld bytes.",
+             statement.entries, statement.size);
+    send_response(client_socket, "SUCCESS", g_write_buffer);
+}
+
 void handle_submit_feedback(int client_socket) {
     if (send_response(client_socket, "PROMPT", "Enter your feedback: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     if (strlen(g_read_buffer) == 0) { send_response(client_socket, "ERROR", "Feedback cannot be empty."); return; }
 
-    int fb_fd = open(FEEDBACK_DB_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fb_fd == -1) { send_response(client_socket, "ERROR", "Server feedback database error."); return; }
-
     struct FeedbackEntry feedback;
     strncpy(feedback.feedback_text, g_read_buffer, sizeof(feedback.feedback_text) - 1);
     feedback.feedback_text[sizeof(feedback.feedback_text) - 1] = '\0';
     
-    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(fb_fd, F_SETLKW, &lock);
-    write(fb_fd, &feedback, sizeof(feedback));
-    lock.l_type = F_UNLCK; fcntl(fb_fd, F_SETLK, &lock);
-    close(fb_fd);
+    if (storage_lock(STORAGE_FEEDBACK, STORAGE_WHOLE_TABLE, 1) == -1) {
+        send_response(client_socket, "ERROR", "Server feedback database error.");
+        return;
+    }
+    int record = storage_append(STORAGE_FEEDBACK, &feedback);
+    storage_unlock(STORAGE_FEEDBACK, STORAGE_WHOLE_TABLE);
+    if (record == -1) { send_response(client_socket, "ERROR", "Server feedback database error."); return; }
 
     send_response(client_socket, "SUCCESS", "Thank you for your feedback!");
 }
@@ -445,7 +365,6 @@ void handle_submit_feedback(int client_socket) {
 void handle_staff_session(int client_socket) {
     int logged_in_id = -1;
     sem_t* session_sem = NULL;
-    char sem_name[50];
     
     // --- Login Loop ---
     while (logged_in_id == -1) {
@@ -457,20 +376,13 @@ void handle_staff_session(int client_socket) {
         if (send_response(client_socket, "PROMPT_MASKED", "Enter password: ") <= 0) return;
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         
-        session_sem = create_session_lock(employee_id, sem_name, sizeof(sem_name));
-        if (session_sem == NULL) {
-            send_response(client_socket, "ERROR", "Server session error. Try again.");
+        int locked = acquire_session_lock(employee_id, &session_sem);
+        if (locked == 1) {
+            send_response(client_socket, "ERROR", "This ID is already logged in elsewhere.");
             continue;
         }
-
-        if (sem_trywait(session_sem) == -1) {
-            if (errno == EAGAIN) {
-                send_response(client_socket, "ERROR", "This ID is already logged in elsewhere.");
-            } else {
-                perror("sem_trywait");
-                send_response(client_socket, "ERROR", "Server lock error.");
-            }
-            sem_close(session_sem);
+        if (locked == -1) {
+            send_response(client_socket, "ERROR", "Server session error. Try again.");
             continue;
         }
         
@@ -478,8 +390,7 @@ void handle_staff_session(int client_socket) {
         if (login_staff(client_socket, employee_id, g_read_buffer, 1)) {
             logged_in_id = employee_id;
             send_response(client_socket, "SUCCESS", "Login successful.");
-            signal(SIGINT, handle_unexpected_disconnect);
-            signal(SIGPIPE, handle_unexpected_disconnect);
+            watch_session_disconnect();
         } else {
             // Use release_session_lock for a FAILED login
             release_session_lock(employee_id, session_sem);
@@ -489,15 +400,15 @@ void handle_staff_session(int client_socket) {
 
     // --- Main Menu Loop ---
     int choice = 0;
-    while (choice != 7 && choice != 8) {
+    while (choice != 8 && choice != 9) {
         const char* menu =
             "Employee Menu:\\n"
             "1. Add New Customer\\n2. Modify Customer Details\\n3. Process Loan Applications\\n"
             "4. View Assigned Loan Applications\\n5. View Customer Transactions\\n"
-            "6. Change Password\\n7. Logout\\n8. Exit\\nChoice: ";
+            "6. Transactions by Date Range\\n7. Change Password\\n8. Logout\\n9. Exit\\nChoice: ";
         
-        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 8; break; }
-        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 8; break; }
+        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 9; break; }
+        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 9; break; }
         choice = atoi(g_read_buffer);
 
         switch (choice) {
@@ -506,27 +417,27 @@ void handle_staff_session(int client_socket) {
             case 3: handle_process_loan(client_socket, logged_in_id); break;
             case 4: handle_view_assigned_loans(client_socket, logged_in_id); break;
             case 5: {
-                if (send_response(client_socket, "PROMPT", "Enter Account ID to view: ") <= 0) { choice = 8; break; }
-                if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 8; break; }
+                if (send_response(client_socket, "PROMPT", "Enter Account ID to view: ") <= 0) { choice = 9; break; }
+                if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 9; break; }
                 handle_view_transactions(client_socket, atoi(g_read_buffer));
                 break;
             }
-            case 6:
+            case 6: handle_transactions_by_date(client_socket); break;
+            case 7:
                 handle_staff_password_change(client_socket, logged_in_id);
-                choice = 7; // Force logout
+                choice = 8; // Force logout
                 break;
-            case 7: printf("Staff %d selected logout.\n", logged_in_id); break;
-            case 8: printf("Staff %d selected exit.\n", logged_in_id); break;
+            case 8: printf("Staff %d selected logout.\n", logged_in_id); break;
+            case 9: printf("Staff %d selected exit.\n", logged_in_id); break;
             default: send_response(client_socket, "ERROR", "Invalid choice.");
         }
     }
 
     // --- Cleanup ---
-    if (choice == 8) { // Exit
+    if (choice == 9) { // Exit
         handle_session_logout(client_socket, logged_in_id, session_sem);
-        close(client_socket);
-        exit(0); 
-    } else { // Logout (choice 7) or password change
+        end_client_session(client_socket);
+    } else { // Logout (choice 8) or password change
         release_session_lock(logged_in_id, session_sem);
     }
 }
@@ -535,30 +446,16 @@ void handle_staff_session(int client_socket) {
 
 int login_staff(int client_socket, int employee_id, const char* pin, int role_required) {
     struct EmployeeRecord staff;
-    int db_fd = open(STAFF_DB_FILE, O_RDONLY);
-    if (db_fd == -1) {
-         if (errno == ENOENT) {
-             db_fd = open(STAFF_DB_FILE, O_WRONLY | O_CREAT, 0644);
-             if (db_fd != -1) close(db_fd);
-         }
-        return 0; // DB error or file just created
-    }
-
-    off_t offset = find_staff_record_offset(db_fd, employee_id);
-    if (offset == -1) {
-        close(db_fd);
-        return 0; // Not found
-    }
+    if (storage_open(STORAGE_STAFF) == -1) return 0; // DB error (file is created on first run)
 
-    lseek(db_fd, offset, SEEK_SET);
-    read(db_fd, &staff, sizeof(staff));
-    close(db_fd);
+    int record = find_staff_record(employee_id);
+    if (record == -1 || storage_get(STORAGE_STAFF, record, &staff) == -1) return 0; // Not found
 
     return (strcmp(staff.login_pass, pin) == 0 && staff.role == role_required);
 }
 
 void handle_create_customer(int client_socket) {
-    struct CustomerAccount new_account, temp_account;
+    struct CustomerAccount new_account;
     
     if (send_response(client_socket, "PROMPT", "Enter new Customer Account ID: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
@@ -574,162 +471,109 @@ void handle_create_customer(int client_socket) {
 
     if (send_response(client_socket, "PROMPT", "Enter Opening Balance: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
-    new_account.balance = atof(g_read_buffer);
-    if (new_account.balance < 0) new_account.balance = 0;
+    if (parse_money(g_read_buffer, &new_account.balance) == -1 || new_account.balance < 0) new_account.balance = 0;
     
     new_account.is_active = 1; // Active by default
     
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR | O_CREAT, 0644);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
-    
-    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(db_fd, F_SETLKW, &lock);
-    
-    int duplicate = 0;
-    lseek(db_fd, 0, SEEK_SET);
-    while (read(db_fd, &temp_account, sizeof(temp_account)) == sizeof(temp_account)) {
-        if (temp_account.account_id == new_account.account_id) {
-            duplicate = 1;
-            break;
-        }
-    }
-    
-    if (duplicate) {
+    struct WalRecord wal;
+    wal_begin(&wal);
+    wal_add_transaction(&wal, new_account.account_id, TXN_OP_OPENING_BALANCE, new_account.balance, -1, new_account.balance);
+    int result = account_store_create(&new_account, &wal);
+    if (result == ACCOUNT_STORE_DUPLICATE) {
         send_response(client_socket, "ERROR", "Account ID already exists.");
+    } else if (result == -1) {
+        send_response(client_socket, "ERROR", "Server database error.");
     } else {
-        lseek(db_fd, 0, SEEK_END);
-        write(db_fd, &new_account, sizeof(new_account));
-        log_transaction(new_account.account_id, "OPENING_BALANCE", new_account.balance, new_account.balance);
         send_response(client_socket, "SUCCESS", "Customer account created successfully.");
     }
-    
-    lock.l_type = F_UNLCK;
-    fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
 }
 
 void handle_process_loan(int client_socket, int employee_id) {
     struct LoanApplication loan;
     struct CustomerAccount account;
-    struct flock lock_loan, lock_acct;
-    int loan_id, choice;
+    int loan_id, choice, record_loan, record_acct;
     
     if (send_response(client_socket, "PROMPT", "Enter Loan ID to process: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     loan_id = atoi(g_read_buffer);
     
-    int loan_fd = open(LOAN_DB_FILE, O_RDWR);
-    int acct_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (loan_fd == -1 || acct_fd == -1) {
-        send_response(client_socket, "ERROR", "Server database error.");
-        if (loan_fd != -1) close(loan_fd);
-        if (acct_fd != -1) close(acct_fd);
+    int result = bank_find_pending_loan(employee_id, loan_id, &record_loan, &record_acct);
+    if (result != BANK_OK) {
+        const char* message = "Server database error.";
+        if (result == BANK_NOT_FOUND) message = "Loan ID not found.";
+        else if (result == BANK_NOT_ASSIGNED) message = "This loan is not assigned to you.";
+        else if (result == BANK_NOT_PENDING) message = "This loan is not pending processing.";
+        else if (result == BANK_ACCOUNT_MISSING) message = "CRITICAL: Customer account for this loan not found.";
+        send_response(client_socket, "ERROR", message);
         return;
     }
     
-    off_t offset_loan = find_loan_record_offset(loan_fd, loan_id);
-    if (offset_loan == -1) {
-        send_response(client_socket, "ERROR", "Loan ID not found.");
-        close(loan_fd); close(acct_fd); return;
-    }
-    
-    lseek(loan_fd, offset_loan, SEEK_SET);
-    read(loan_fd, &loan, sizeof(loan));
-    
-    if (loan.assigned_to_employee_id != employee_id) {
-        send_response(client_socket, "ERROR", "This loan is not assigned to you.");
-        close(loan_fd); close(acct_fd); return;
-    }
-    if (loan.status != 1) { // 1 = Assigned/Pending
-        send_response(client_socket, "ERROR", "This loan is not pending processing.");
-        close(loan_fd); close(acct_fd); return;
-    }
-    
-    off_t offset_acct = find_customer_record_offset(acct_fd, loan.customer_account_id);
-    if (offset_acct == -1) {
-        send_response(client_socket, "ERROR", "CRITICAL: Customer account for this loan not found.");
-        close(loan_fd); close(acct_fd); return;
+    if (storage_lock(STORAGE_LOANS, record_loan, 1) == -1) {
+        send_response(client_socket, "ERROR", "Failed to lock account. Try again.");
+        return;
     }
-    
-    memset(&lock_loan, 0, sizeof(lock_loan));
-    lock_loan.l_type = F_WRLCK; lock_loan.l_whence = SEEK_SET; lock_loan.l_start = offset_loan; lock_loan.l_len = sizeof(struct LoanApplication);
-    
-    memset(&lock_acct, 0, sizeof(lock_acct));
-    lock_acct.l_type = F_WRLCK; lock_acct.l_whence = SEEK_SET; lock_acct.l_start = offset_acct; lock_acct.l_len = sizeof(struct CustomerAccount);
-    
-    fcntl(loan_fd, F_SETLKW, &lock_loan);
-    fcntl(acct_fd, F_SETLKW, &lock_acct);
 
-    lseek(loan_fd, offset_loan, SEEK_SET); read(loan_fd, &loan, sizeof(loan));
-    lseek(acct_fd, offset_acct, SEEK_SET); read(acct_fd, &account, sizeof(account));
+    storage_get(STORAGE_LOANS, record_loan, &loan);
+    account_store_read(record_acct, &account);
     
     if (loan.status != 1) {
         send_response(client_socket, "ERROR", "Loan status changed before processing. Aborting.");
     } else {
         snprintf(g_write_buffer, sizeof(g_write_buffer),
-            "Processing Loan #%d for Acct %d (%s).\\nAmount: %.2f. Balance: %.2f\\n"
+            "Processing Loan #%d for Acct %d (%s).\\nAmount: " MONEY_FMT ". Balance: " MONEY_FMT "\\n"
             "1. Approve\\n2. Reject\\nChoice: ",
-            loan.loan_id, account.account_id, account.owner_name, loan.amount, account.balance);
+            loan.loan_id, account.account_id, account.owner_name, MONEY_ARGS(loan.amount), MONEY_ARGS(account.balance));
         
         if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) goto cleanup_loan_proc;
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) goto cleanup_loan_proc;
         choice = atoi(g_read_buffer);
 
         if (choice == 1) { // Approve
-            account.balance += loan.amount;
-            loan.status = 2; // Approved
-            lseek(acct_fd, offset_acct, SEEK_SET);
-            write(acct_fd, &account, sizeof(account));
-            log_transaction(account.account_id, "LOAN_APPROVED", loan.amount, account.balance);
-            send_response(client_socket, "SUCCESS", "Loan Approved.");
+            result = bank_decide_loan(record_loan, record_acct, &loan, 1);
+            if (result == BANK_OK) {
+                send_response(client_socket, "SUCCESS", "Loan Approved.");
+            } else if (result == BANK_LOCK_FAILED) {
+                send_response(client_socket, "ERROR", "Failed to lock account. Try again.");
+            } else {
+                send_response(client_socket, "ERROR", "Server database error. Loan not approved.");
+            }
         } else if (choice == 2) { // Reject
-            loan.status = 3; // Rejected
-            send_response(client_socket, "SUCCESS", "Loan Rejected.");
+            if (bank_decide_loan(record_loan, record_acct, &loan, 0) == BANK_OK) {
+                send_response(client_socket, "SUCCESS", "Loan Rejected.");
+            } else {
+                send_response(client_socket, "ERROR", "Server database error. Loan not rejected.");
+            }
         } else {
             send_response(client_socket, "ERROR", "Invalid choice. No action taken.");
         }
-        
-        if (choice == 1 || choice == 2) {
-            lseek(loan_fd, offset_loan, SEEK_SET);
-            write(loan_fd, &loan, sizeof(loan));
-        }
     }
     
 cleanup_loan_proc:
-    lock_loan.l_type = F_UNLCK; fcntl(loan_fd, F_SETLK, &lock_loan);
-    lock_acct.l_type = F_UNLCK; fcntl(acct_fd, F_SETLK, &lock_acct);
-    close(loan_fd);
-    close(acct_fd);
+    storage_unlock(STORAGE_LOANS, record_loan);
+}
+
+/**
+ * @brief Appends one "-> Loan #..." listing line per loan to g_write_buffer.
+ */
+static void append_loan_lines(const struct LoanApplication* loans, int count) {
+    for (int i = 0; i < count; i++) {
+        char line[100];
+        snprintf(line, sizeof(line), "-> Loan #%d | Acct: %d | Amount: " MONEY_FMT "\\n",
+                 loans[i].loan_id, loans[i].customer_account_id, MONEY_ARGS(loans[i].amount));
+        if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 50) {
+             strcat(g_write_buffer, line);
+        }
+    }
 }
 
 void handle_view_assigned_loans(int client_socket, int employee_id) {
-    struct LoanApplication loan;
-    int loan_fd = open(LOAN_DB_FILE, O_RDONLY);
-    if (loan_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
-    
-    struct flock lock = {F_RDLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(loan_fd, F_SETLKW, &lock);
+    struct LoanApplication loans[LOAN_VIEW_MAX];
+    int found = bank_list_loans(1, employee_id, loans, LOAN_VIEW_MAX); // 1 = Assigned
+    if (found < 0) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    int found = 0;
     bzero(g_write_buffer, sizeof(g_write_buffer));
     strcat(g_write_buffer, "Assigned Pending Loans:\\n");
-
-    while (read(loan_fd, &loan, sizeof(loan)) == sizeof(loan)) {
-        if (loan.assigned_to_employee_id == employee_id && loan.status == 1) { // 1 = Assigned
-            char line[100];
-            snprintf(line, sizeof(line), "-> Loan #%d | Acct: %d | Amount: %.2f\\n",
-                     loan.loan_id, loan.customer_account_id, loan.amount);
-            
-            if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 50) {
-                 strcat(g_write_buffer, line);
-            }
-            found = 1;
-        }
-    }
-    
-    lock.l_type = F_UNLCK;
-    fcntl(loan_fd, F_SETLK, &lock);
-    close(loan_fd);
+    append_loan_lines(loans, found);
     
     if (!found) {
         send_response(client_socket, "SUCCESS", "No pending loans assigned to you.");
@@ -738,6 +582,71 @@ void handle_view_assigned_loans(int client_socket, int employee_id) {
     }
 }
 
+// Collects date-range matches into g_write_buffer while they fit
+struct RangeListing {
+    int shown;
+    int total;
+    int full;
+};
+
+static int append_range_line(const struct Transaction* entry, void* ctx) {
+    struct RangeListing* listing = ctx;
+    listing->total++;
+    if (listing->full) return 0; // Keep counting
+    
+    char line[220];
+    int used = snprintf(line, sizeof(line), "-> Acct %d ", entry->account_id);
+    format_transaction(entry, line + used, sizeof(line) - used - 2);
+    strcat(line, "\\n");
+    if (strlen(g_write_buffer) + strlen(line) >= sizeof(g_write_buffer) - 60) {
+        listing->full = 1;
+        return 0;
+    }
+    strcat(g_write_buffer, line);
+    listing->shown++;
+    return 0;
+}
+
+/**
+ * @brief Lists the transactions of one account, or of all accounts, made
+ * between two dates (inclusive), oldest first. Uses the time index, so
+ * only the log blocks that can hold matches are read.
+ */
+void handle_transactions_by_date(int client_socket) {
+    long long from_us, to_us;
+    
+    if (send_response(client_socket, "PROMPT", "Enter Account ID (0 for all accounts): ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    int account_id = atoi(g_read_buffer);
+    if (send_response(client_socket, "PROMPT", "From (YYYY-MM-DD [HH:MM[:SS]]): ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    if (parse_time_bound(g_read_buffer, 0, &from_us) == -1) { send_response(client_socket, "ERROR", "Invalid date."); return; }
+    if (send_response(client_socket, "PROMPT", "To (YYYY-MM-DD [HH:MM[:SS]]): ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    if (parse_time_bound(g_read_buffer, 1, &to_us) == -1) { send_response(client_socket, "ERROR", "Invalid date."); return; }
+    if (from_us > to_us) { send_response(client_socket, "ERROR", "The range ends before it starts."); return; }
+    if (account_id < 0) { send_response(client_socket, "ERROR", "Invalid Account ID."); return; }
+    
+    bzero(g_write_buffer, sizeof(g_write_buffer));
+    if (account_id == 0) strcat(g_write_buffer, "Transactions (all accounts):\\n");
+    else snprintf(g_write_buffer, sizeof(g_write_buffer), "Transactions for Acct %d:\\n", account_id);
+    
+    struct RangeListing listing = {0, 0, 0};
+    int rc = storage_transactions_between(account_id == 0 ? TXN_ALL_ACCOUNTS : account_id,
+                                          from_us, to_us, append_range_line, &listing);
+    if (rc == -1) { send_response(client_socket, "ERROR", "Server log database error."); return; }
+    if (listing.total == 0) { send_response(client_socket, "SUCCESS", "No transactions in that range."); return; }
+    
+    char summary[96];
+    if (listing.shown < listing.total) {
+        snprintf(summary, sizeof(summary), "(Showing %d of %d; narrow the range for more.)", listing.shown, listing.total);
+    } else {
+        snprintf(summary, sizeof(summary), "%d transaction(s).", listing.total);
+    }
+    strcat(g_write_buffer, summary);
+    send_response(client_socket, "SUCCESS", g_write_buffer);
+}
+
 
 // =======================================
 // MANAGER ROLE
@@ -747,7 +656,6 @@ void handle_view_assigned_loans(int client_socket, int employee_id) {
 void handle_manager_session(int client_socket) {
     int logged_in_id = -1;
     sem_t* session_sem = NULL;
-    char sem_name[50];
     
     // --- Login Loop ---
     while (logged_in_id == -1) {
@@ -759,20 +667,13 @@ void handle_manager_session(int client_socket) {
         if (send_response(client_socket, "PROMPT_MASKED", "Enter password: ") <= 0) return;
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         
-        session_sem = create_session_lock(employee_id, sem_name, sizeof(sem_name));
-        if (session_sem == NULL) {
-            send_response(client_socket, "ERROR", "Server session error. Try again.");
+        int locked = acquire_session_lock(employee_id, &session_sem);
+        if (locked == 1) {
+            send_response(client_socket, "ERROR", "This ID is already logged in elsewhere.");
             continue;
         }
-
-        if (sem_trywait(session_sem) == -1) {
-            if (errno == EAGAIN) {
-                send_response(client_socket, "ERROR", "This ID is already logged in elsewhere.");
-            } else {
-                perror("sem_trywait");
-                send_response(client_socket, "ERROR", "Server lock error.");
-            }
-            sem_close(session_sem);
+        if (locked == -1) {
+            send_response(client_socket, "ERROR", "Server session error. Try again.");
             continue;
         }
         
@@ -780,8 +681,7 @@ void handle_manager_session(int client_socket) {
         if (login_staff(client_socket, employee_id, g_read_buffer, 0)) {
             logged_in_id = employee_id;
             send_response(client_socket, "SUCCESS", "Login successful.");
-            signal(SIGINT, handle_unexpected_disconnect);
-            signal(SIGPIPE, handle_unexpected_disconnect);
+            watch_session_disconnect();
         } else {
             // Use release_session_lock for a FAILED login
             release_session_lock(employee_id, session_sem);
@@ -791,37 +691,39 @@ void handle_manager_session(int client_socket) {
 
     // --- Main Menu Loop ---
     int choice = 0;
-    while (choice != 5 && choice != 6) {
+    while (choice != 8 && choice != 9) {
         const char* menu =
             "Manager Menu:\\n"
             "1. Activate/Deactivate Customer Accounts\\n2. Assign Loan Applications\\n"
-            "3. Review Customer Feedback\\n4. Change Password\\n"
-            "5. Logout\\n6. Exit\\nChoice: ";
+            "3. Review Customer Feedback\\n4. View Bank Totals\\n5. List Accounts by ID\\n"
+            "6. Transactions by Date Range\\n7. Change Password\\n8. Logout\\n9. Exit\\nChoice: ";
         
-        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 6; break; }
-        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 6; break; }
+        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 9; break; }
+        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 9; break; }
         choice = atoi(g_read_buffer);
 
         switch (choice) {
             case 1: handle_set_account_status(client_socket); break;
             case 2: handle_assign_loan(client_socket); break;
             case 3: handle_review_feedback(client_socket); break;
-            case 4:
+            case 4: handle_view_bank_totals(client_socket); break;
+            case 5: handle_list_accounts(client_socket); break;
+            case 6: handle_transactions_by_date(client_socket); break;
+            case 7:
                 handle_staff_password_change(client_socket, logged_in_id);
-                choice = 5; // Force logout
+                choice = 8; // Force logout
                 break;
-            case 5: printf("Manager %d selected logout.\n", logged_in_id); break;
-            case 6: printf("Manager %d selected exit.\n", logged_in_id); break;
+            case 8: printf("Manager %d selected logout.\n", logged_in_id); break;
+            case 9: printf("Manager %d selected exit.\n", logged_in_id); break;
             default: send_response(client_socket, "ERROR", "Invalid choice.");
         }
     }
 
     // --- Cleanup ---
-    if (choice == 6) { // Exit
+    if (choice == 9) { // Exit
         handle_session_logout(client_socket, logged_in_id, session_sem);
-        close(client_socket);
-        exit(0);
-    } else { // Logout (choice 5) or password change
+        end_client_session(client_socket);
+    } else { // Logout (choice 8) or password change
         release_session_lock(logged_in_id, session_sem);
     }
 }
@@ -836,152 +738,115 @@ void handle_set_account_status(int client_socket) {
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     account_id = atoi(g_read_buffer);
     
-    int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    off_t offset = find_customer_record_offset(db_fd, account_id);
-    if (offset == -1) {
+    int record = account_store_find(account_id);
+    if (record == -1) {
         send_response(client_socket, "ERROR", "Account not found.");
-        close(db_fd); return;
+        return;
     }
     
-    struct flock lock = {F_WRLCK, SEEK_SET, offset, sizeof(struct CustomerAccount), getpid()};
-    fcntl(db_fd, F_SETLKW, &lock);
-    
-    lseek(db_fd, offset, SEEK_SET);
-    read(db_fd, &account, sizeof(account));
+    account_store_read(record, &account);
     
     snprintf(g_write_buffer, sizeof(g_write_buffer),
         "Account %d (%s) is currently: %s\\n"
         "1. Activate\\n2. Deactivate\\nChoice: ",
         account_id, account.owner_name, account.is_active ? "ACTIVE" : "INACTIVE");
     
-    if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) goto cleanup_set_status;
-    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) goto cleanup_set_status;
+    if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     choice = atoi(g_read_buffer);
     
-    if (choice == 1) {
-        account.is_active = 1;
-        lseek(db_fd, offset, SEEK_SET);
-        write(db_fd, &account, sizeof(account));
-        send_response(client_socket, "SUCCESS", "Account activated.");
-    } else if (choice == 2) {
-        account.is_active = 0;
-        lseek(db_fd, offset, SEEK_SET);
-        write(db_fd, &account, sizeof(account));
-        send_response(client_socket, "SUCCESS", "Account deactivated.");
-    } else {
+    if (choice != 1 && choice != 2) {
         send_response(client_socket, "ERROR", "Invalid choice. No action taken.");
+        return;
     }
 
-cleanup_set_status:
-    lock.l_type = F_UNLCK;
-    fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
+    // Lock only for the read-modify-write so balances stay current
+    struct AccountState state;
+    account_store_lock(record, 1);
+    account_store_read_state(record, &state);
+    state.is_active = (choice == 1);
+    struct WalRecord wal;
+    wal_begin(&wal);
+    wal_add_account_state(&wal, record, &state);
+    int committed = wal_commit(&wal);
+    account_store_unlock(record);
+
+    if (committed == -1) { send_response(client_socket, "ERROR", "Server database error. Status not changed."); return; }
+    send_response(client_socket, "SUCCESS", (choice == 1) ? "Account activated." : "Account deactivated.");
 }
 
 void handle_assign_loan(int client_socket) {
-    struct LoanApplication loan;
     int loan_id, employee_id;
     
-    int loan_fd = open(LOAN_DB_FILE, O_RDWR); // RDWR for read then write
-    if (loan_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
-    
-    struct flock lock = {F_RDLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(loan_fd, F_SETLKW, &lock);
-    
-    int found = 0;
-    bzero(g_write_buffer, sizeof(g_write_buffer));
-    strcat(g_write_buffer, "Unassigned Loan Requests (Status 0):\\n");
-
-    while (read(loan_fd, &loan, sizeof(loan)) == sizeof(loan)) {
-        if (loan.status == 0) { // 0 = Requested
-            char line[100];
-            snprintf(line, sizeof(line), "-> Loan #%d | Acct: %d | Amount: %.2f\\n",
-                     loan.loan_id, loan.customer_account_id, loan.amount);
-            if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 50) {
-                 strcat(g_write_buffer, line);
-            }
-            found = 1;
-        }
-    }
-    lock.l_type = F_UNLCK; fcntl(loan_fd, F_SETLK, &lock);
+    struct LoanApplication loans[LOAN_VIEW_MAX];
+    int found = bank_list_loans(0, -1, loans, LOAN_VIEW_MAX); // 0 = Requested
+    if (found < 0) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
     if (!found) {
         send_response(client_socket, "SUCCESS", "No unassigned loans found.");
-        close(loan_fd); return;
+        return;
     }
     
-    if (send_response(client_socket, "SUCCESS", g_write_buffer) <= 0) { close(loan_fd); return; }
+    bzero(g_write_buffer, sizeof(g_write_buffer));
+    strcat(g_write_buffer, "Unassigned Loan Requests (Status 0):\\n");
+    append_loan_lines(loans, found);
+    if (send_response(client_socket, "SUCCESS", g_write_buffer) <= 0) return;
     
-    if (send_response(client_socket, "PROMPT", "Enter Loan ID to assign: ") <= 0) { close(loan_fd); return; }
-    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { close(loan_fd); return; }
+    if (send_response(client_socket, "PROMPT", "Enter Loan ID to assign: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     loan_id = atoi(g_read_buffer);
     
-    if (send_response(client_socket, "PROMPT", "Enter Employee ID to assign to: ") <= 0) { close(loan_fd); return; }
-    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { close(loan_fd); return; }
+    if (send_response(client_socket, "PROMPT", "Enter Employee ID to assign to: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     employee_id = atoi(g_read_buffer);
     
-    off_t offset = find_loan_record_offset(loan_fd, loan_id);
-    if (offset == -1) {
+    int result = bank_assign_loan(loan_id, employee_id);
+    if (result == BANK_OK) {
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Loan #%d assigned to Employee #%d.", loan_id, employee_id);
+        send_response(client_socket, "SUCCESS", g_write_buffer);
+    } else if (result == BANK_NOT_FOUND) {
         send_response(client_socket, "ERROR", "Loan ID not found.");
-        close(loan_fd); return;
-    }
-    
-    lock.l_type = F_WRLCK; lock.l_start = offset; lock.l_len = sizeof(struct LoanApplication);
-    fcntl(loan_fd, F_SETLKW, &lock);
-    
-    lseek(loan_fd, offset, SEEK_SET);
-    read(loan_fd, &loan, sizeof(loan));
-    
-    if (loan.status != 0) {
+    } else if (result == BANK_LOCK_FAILED) {
+        send_response(client_socket, "ERROR", "Failed to lock account. Try again.");
+    } else if (result == BANK_NOT_PENDING) {
         send_response(client_socket, "ERROR", "Loan was already assigned or processed.");
+    } else if (result == BANK_NOT_RECORDED) {
+        send_response(client_socket, "ERROR", "Server database error. Loan not assigned.");
     } else {
-        loan.status = 1; // 1 = Assigned
-        loan.assigned_to_employee_id = employee_id;
-        
-        lseek(loan_fd, offset, SEEK_SET);
-        write(loan_fd, &loan, sizeof(loan));
-        
-        snprintf(g_write_buffer, sizeof(g_write_buffer), "Loan #%d assigned to Employee #%d.", loan_id, employee_id);
-        send_response(client_socket, "SUCCESS", g_write_buffer);
+        send_response(client_socket, "ERROR", "Server database error.");
     }
-    
-    lock.l_type = F_UNLCK; fcntl(loan_fd, F_SETLK, &lock);
-    close(loan_fd);
+}
+
+static int append_feedback_line(int record, const void* data, void* ctx) {
+    const struct FeedbackEntry* feedback = data;
+    int* count = ctx;
+    char line[300];
+    snprintf(line, sizeof(line), "-> %s\\n", feedback->feedback_text);
+    if (strlen(g_write_buffer) + strlen(line) >= sizeof(g_write_buffer) - 50) {
+         strcat(g_write_buffer, "...(more entries truncated)...\\n");
+         return 1;
+    }
+    strcat(g_write_buffer, line);
+    (*count)++;
+    return 0;
 }
 
 void handle_review_feedback(int client_socket) {
-    struct FeedbackEntry feedback;
-    int fb_fd = open(FEEDBACK_DB_FILE, O_RDONLY);
-    if (fb_fd == -1) {
-        if (errno == ENOENT) { send_response(client_socket, "SUCCESS", "No feedback submitted yet."); return; }
+    if (storage_lock(STORAGE_FEEDBACK, STORAGE_WHOLE_TABLE, 0) == -1) {
         send_response(client_socket, "ERROR", "Server database error.");
         return;
     }
     
-    struct flock lock = {F_RDLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(fb_fd, F_SETLKW, &lock);
-    
     bzero(g_write_buffer, sizeof(g_write_buffer));
     strcat(g_write_buffer, "All Customer Feedback:\\n");
     int count = 0;
+    int rc = storage_scan(STORAGE_FEEDBACK, append_feedback_line, &count);
     
-    while (read(fb_fd, &feedback, sizeof(feedback)) == sizeof(feedback)) {
-        char line[300];
-        snprintf(line, sizeof(line), "-> %s\\n", feedback.feedback_text);
-        if (strlen(g_write_buffer) + strlen(line) < sizeof(g_write_buffer) - 50) {
-             strcat(g_write_buffer, line);
-        } else {
-             strcat(g_write_buffer, "...(more entries truncated)...\\n");
-             break;
-        }
-        count++;
-    }
-    
-    lock.l_type = F_UNLCK; fcntl(fb_fd, F_SETLK, &lock);
-    close(fb_fd);
+    storage_unlock(STORAGE_FEEDBACK, STORAGE_WHOLE_TABLE);
     
+    if (rc == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     if (count == 0) {
         send_response(client_socket, "SUCCESS", "No feedback submitted yet.");
     } else {
@@ -989,6 +854,58 @@ void handle_review_feedback(int client_socket) {
     }
 }
 
+void handle_view_bank_totals(int client_socket) {
+    struct LedgerTotals totals;
+    if (ledger_compute_totals(&totals) == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+
+    snprintf(g_write_buffer, sizeof(g_write_buffer),
+             "Bank Totals:\\n"
+             "Deposits: " MONEY_FMT " across %ld accounts\\n"
+             "Loans outstanding: " MONEY_FMT "\\n"
+             "Requested: %ld (" MONEY_FMT ")\\nAssigned: %ld (" MONEY_FMT ")\\n"
+             "Approved: %ld (" MONEY_FMT ")\\nRejected: %ld (" MONEY_FMT ")\\n",
+             MONEY_ARGS(totals.total_deposits), totals.accounts, MONEY_ARGS(totals.loans_outstanding),
+             totals.loan_count[0], MONEY_ARGS(totals.loan_total[0]), totals.loan_count[1], MONEY_ARGS(totals.loan_total[1]),
+             totals.loan_count[2], MONEY_ARGS(totals.loan_total[2]), totals.loan_count[3], MONEY_ARGS(totals.loan_total[3]));
+    send_response(client_socket, "SUCCESS", g_write_buffer);
+}
+
+/**
+ * @brief Lists accounts with IDs in a range, in ID order (B+tree range scan).
+ */
+void handle_list_accounts(int client_socket) {
+    int records[ID_LIST_MAX];
+    
+    if (send_response(client_socket, "PROMPT", "Enter first Account ID: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    int first_id = atoi(g_read_buffer);
+    if (send_response(client_socket, "PROMPT", "Enter last Account ID: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    int last_id = atoi(g_read_buffer);
+    
+    if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    int count = list_records_by_id(STORAGE_ACCOUNTS, first_id, last_id, records, ID_LIST_MAX);
+    if (count == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (count == 0) { send_response(client_socket, "SUCCESS", "No accounts in that range."); return; }
+    
+    bzero(g_write_buffer, sizeof(g_write_buffer));
+    snprintf(g_write_buffer, sizeof(g_write_buffer), "Accounts %d to %d:\\n", first_id, last_id);
+    for (int i = 0; i < count; i++) {
+        struct CustomerAccount account;
+        if (account_store_read(records[i], &account) == -1) continue;
+        char line[120];
+        snprintf(line, sizeof(line), "-> Acct %d | %s | %s | Balance: " MONEY_FMT "\\n", account.account_id,
+                 account.owner_name, account.is_active ? "Active" : "Inactive", MONEY_ARGS(account.balance));
+        if (strlen(g_write_buffer) + strlen(line) >= sizeof(g_write_buffer) - 50) {
+            strcat(g_write_buffer, "...(more accounts truncated)...\\n");
+            break;
+        }
+        strcat(g_write_buffer, line);
+    }
+    if (count == ID_LIST_MAX) strcat(g_write_buffer, "(Showing the first matches; narrow the range for more.)");
+    send_response(client_socket, "SUCCESS", g_write_buffer);
+}
+
 
 // =======================================
 // ADMIN ROLE
@@ -1013,28 +930,30 @@ void handle_admin_session(int client_socket) {
 
     // --- Main Menu Loop ---
     int choice = 0;
-    while (choice != 5) {
+    while (choice != 7) {
         const char* menu =
             "Admin Menu:\\n"
             "1. Add New Bank Employee/Manager\\n2. Modify Customer/Employee Details\\n"
-            "3. Manage User Roles\\n4. Change Admin Password\\n"
-            "5. Logout\\nChoice: ";
+            "3. Manage User Roles\\n4. List Staff\\n5. Import Customer Accounts\\n"
+            "6. Change Admin Password\\n7. Logout\\nChoice: ";
         
-        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 5; break; }
-        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 5; break; }
+        if (send_response(client_socket, "PROMPT", menu) <= 0) { choice = 7; break; }
+        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 7; break; }
         choice = atoi(g_read_buffer);
 
         switch (choice) {
             case 1: handle_create_staff(client_socket); break;
             case 2: {
-                if (send_response(client_socket, "PROMPT", "1. Modify Customer\\n2. Modify Employee\\nChoice: ") <= 0) { choice = 5; break; }
-                if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 5; break; }
+                if (send_response(client_socket, "PROMPT", "1. Modify Customer\\n2. Modify Employee\\nChoice: ") <= 0) { choice = 7; break; }
+                if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) { choice = 7; break; }
                 handle_modify_user_details(client_socket, atoi(g_read_buffer));
                 break;
             }
             case 3: handle_update_staff_role(client_socket); break;
-            case 4: handle_change_admin_pass(client_socket); break;
-            case 5: printf("Admin selected logout.\n"); break;
+            case 4: handle_list_staff(client_socket); break;
+            case 5: handle_import_accounts(client_socket); break;
+            case 6: handle_change_admin_pass(client_socket); break;
+            case 7: printf("Admin selected logout.\n"); break;
             default: send_response(client_socket, "ERROR", "Invalid choice.");
         }
     }
@@ -1079,7 +998,7 @@ int login_admin(int client_socket, const char* pass) {
 }
 
 void handle_create_staff(int client_socket) {
-    struct EmployeeRecord new_staff, temp_staff;
+    struct EmployeeRecord new_staff;
     
     if (send_response(client_socket, "PROMPT", "Enter new Employee ID: ") <= 0) return;
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
@@ -1101,32 +1020,67 @@ void handle_create_staff(int client_socket) {
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     new_staff.role = (atoi(g_read_buffer) == 0) ? 0 : 1; // Default to 1 (Employee)
 
-    int db_fd = open(STAFF_DB_FILE, O_RDWR | O_CREAT, 0644);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (storage_open(STORAGE_STAFF) == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(db_fd, F_SETLKW, &lock);
+    // Creators are serialized by the staff index, so existing records stay unlocked;
+    // without an index, fall back to locking the whole table
+    int table_locked = (g_staff_index == NULL || record_index_lock(g_staff_index) == -1);
+    if (table_locked) storage_lock(STORAGE_STAFF, STORAGE_WHOLE_TABLE, 1);
     
-    int duplicate = 0;
-    lseek(db_fd, 0, SEEK_SET);
-    while (read(db_fd, &temp_staff, sizeof(temp_staff)) == sizeof(temp_staff)) {
-        if (temp_staff.employee_id == new_staff.employee_id) {
-            duplicate = 1;
-            break;
+    if (find_staff_record(new_staff.employee_id) != -1) {
+        send_response(client_socket, "ERROR", "Employee ID already exists.");
+    } else {
+        int record = storage_append(STORAGE_STAFF, &new_staff);
+        if (record == -1) {
+            send_response(client_socket, "ERROR", "Server database error.");
+        } else {
+            if (g_staff_index != NULL) record_index_insert(g_staff_index, new_staff.employee_id, record);
+            btree_insert(g_staff_btree, new_staff.employee_id, record);
+            send_response(client_socket, "SUCCESS", "Staff account created successfully.");
         }
     }
     
-    if (duplicate) {
-        send_response(client_socket, "ERROR", "Employee ID already exists.");
+    if (table_locked) {
+        storage_unlock(STORAGE_STAFF, STORAGE_WHOLE_TABLE);
     } else {
-        lseek(db_fd, 0, SEEK_END);
-        write(db_fd, &new_staff, sizeof(new_staff));
-        send_response(client_socket, "SUCCESS", "Staff account created successfully.");
+        record_index_unlock(g_staff_index);
     }
+}
+
+/**
+ * @brief Lists staff in employee ID order, starting at a given ID
+ * (B+tree range scan).
+ */
+void handle_list_staff(int client_socket) {
+    int records[ID_LIST_MAX];
     
-    lock.l_type = F_UNLCK;
-    fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
+    if (send_response(client_socket, "PROMPT", "List staff from Employee ID: ") <= 0) return;
+    if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
+    int first_id = atoi(g_read_buffer);
+    
+    if (storage_open(STORAGE_STAFF) == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    int count = list_records_by_id(STORAGE_STAFF, first_id, INT_MAX, records, ID_LIST_MAX);
+    if (count == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (count == 0) { send_response(client_socket, "SUCCESS", "No staff found."); return; }
+    
+    bzero(g_write_buffer, sizeof(g_write_buffer));
+    strcat(g_write_buffer, "Staff:\\n");
+    int last_id = first_id;
+    for (int i = 0; i < count; i++) {
+        struct EmployeeRecord staff;
+        if (storage_get(STORAGE_STAFF, records[i], &staff) == -1) continue;
+        char line[100];
+        snprintf(line, sizeof(line), "-> #%d %s %s (%s)\\n", staff.employee_id, staff.first_name, staff.last_name,
+                 (staff.role == 0) ? "Manager" : "Employee");
+        strcat(g_write_buffer, line);
+        last_id = staff.employee_id;
+    }
+    if (count == ID_LIST_MAX && last_id < INT_MAX) {
+        char more[60];
+        snprintf(more, sizeof(more), "(More staff: list again from ID %d.)", last_id + 1);
+        strcat(g_write_buffer, more);
+    }
+    send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
 void handle_update_staff_role(int client_socket) {
@@ -1137,20 +1091,17 @@ void handle_update_staff_role(int client_socket) {
     if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
     employee_id = atoi(g_read_buffer);
     
-    int db_fd = open(STAFF_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+    if (storage_open(STORAGE_STAFF) == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
     
-    off_t offset = find_staff_record_offset(db_fd, employee_id);
-    if (offset == -1) {
+    int record = find_staff_record(employee_id);
+    if (record == -1) {
         send_response(client_socket, "ERROR", "Employee not found.");
-        close(db_fd); return;
+        return;
     }
     
-    struct flock lock = {F_WRLCK, SEEK_SET, offset, sizeof(struct EmployeeRecord), getpid()};
-    fcntl(db_fd, F_SETLKW, &lock);
+    storage_lock(STORAGE_STAFF, record, 1);
     
-    lseek(db_fd, offset, SEEK_SET);
-    read(db_fd, &staff, sizeof(staff));
+    storage_get(STORAGE_STAFF, record, &staff);
     
     snprintf(g_write_buffer, sizeof(g_write_buffer),
         "Employee %d (%s) is currently: %s\\n"
@@ -1163,20 +1114,43 @@ void handle_update_staff_role(int client_socket) {
     
     if (choice == 0) {
         staff.role = 0; // Manager
-        lseek(db_fd, offset, SEEK_SET); write(db_fd, &staff, sizeof(staff));
+        storage_put(STORAGE_STAFF, record, &staff);
         send_response(client_socket, "SUCCESS", "Role updated to Manager.");
     } else if (choice == 1) {
         staff.role = 1; // Employee
-        lseek(db_fd, offset, SEEK_SET); write(db_fd, &staff, sizeof(staff));
+        storage_put(STORAGE_STAFF, record, &staff);
         send_response(client_socket, "SUCCESS", "Role updated to Employee.");
     } else {
         send_response(client_socket, "ERROR", "Invalid choice. No action taken.");
     }
 
 cleanup_update_role:
-    lock.l_type = F_UNLCK;
-    fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
+    storage_unlock(STORAGE_STAFF, record);
+}
+
+/**
+ * @brief Bulk-loads customer accounts from a CSV or binary file on the
+ * server (path relative to its data directory). Account creation and
+ * WAL updates wait while the load runs.
+ */
+void handle_import_accounts(int client_socket) {
+    char path[256];
+    
+    if (send_response(client_socket, "PROMPT", "Enter import file path on the server (.csv, or .bin/.dat records): ") <= 0) return;
+    if (read_line(client_socket, path, sizeof(path)) <= 0) return;
+    if (strlen(path) == 0) { send_response(client_socket, "ERROR", "File path cannot be empty."); return; }
+    
+    struct ImportReport report;
+    int rc = account_import_file(path, account_import_format(path), &report);
+    if (rc == IMPORT_UNREADABLE) {
+        snprintf(g_write_buffer, sizeof(g_write_buffer), "Cannot read %s: %s", path, strerror(errno));
+        send_response(client_socket, "ERROR", g_write_buffer);
+        return;
+    }
+    if (rc == -1) { send_response(client_socket, "ERROR", "Import failed. Server database error."); return; }
+    account_import_summary(&report, g_write_buffer, sizeof(g_write_buffer));
+    printf("Admin import of %s: %s\n", path, g_write_buffer);
+    send_response(client_socket, "SUCCESS", g_write_buffer);
 }
 
 void handle_change_admin_pass(int client_socket) {
@@ -1219,32 +1193,32 @@ void handle_modify_user_details(int client_socket, int modify_type) {
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         account_id = atoi(g_read_buffer);
         
-        int db_fd = open(ACCOUNT_DB_FILE, O_RDWR);
-        if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+        if (account_store_open() == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
         
-        off_t offset = find_customer_record_offset(db_fd, account_id);
-        if (offset == -1) {
+        int record = account_store_find(account_id);
+        if (record == -1) {
             send_response(client_socket, "ERROR", "Account not found.");
-            close(db_fd); return;
+            return;
         }
         
-        struct flock lock = {F_WRLCK, SEEK_SET, offset, sizeof(struct CustomerAccount), getpid()};
-        fcntl(db_fd, F_SETLKW, &lock);
-        
-        lseek(db_fd, offset, SEEK_SET); read(db_fd, &account, sizeof(account));
+        account_store_read(record, &account);
         
         snprintf(g_write_buffer, sizeof(g_write_buffer), "Current name: %s. Enter new name: ", account.owner_name);
-        if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) goto cleanup_mod_cust;
-        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) goto cleanup_mod_cust;
+        if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) return;
+        if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         
+        // Lock only for the read-modify-write so balances stay current
+        account_store_lock(record, 1);
+        account_store_read(record, &account);
         strncpy(account.owner_name, g_read_buffer, sizeof(account.owner_name) - 1);
-        lseek(db_fd, offset, SEEK_SET); write(db_fd, &account, sizeof(account));
+        struct WalRecord wal;
+        wal_begin(&wal);
+        wal_add_account(&wal, record, &account, 0);
+        int committed = wal_commit(&wal);
+        account_store_unlock(record);
+        if (committed == -1) { send_response(client_socket, "ERROR", "Server database error. Name not updated."); return; }
         send_response(client_socket, "SUCCESS", "Customer name updated.");
         
-    cleanup_mod_cust:
-        lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-        close(db_fd);
-        
     } else if (modify_type == 2) {
         // --- Modify Staff ---
         struct EmployeeRecord staff;
@@ -1254,19 +1228,17 @@ void handle_modify_user_details(int client_socket, int modify_type) {
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) return;
         employee_id = atoi(g_read_buffer);
         
-        int db_fd = open(STAFF_DB_FILE, O_RDWR);
-        if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
+        if (storage_open(STORAGE_STAFF) == -1) { send_response(client_socket, "ERROR", "Server database error."); return; }
         
-        off_t offset = find_staff_record_offset(db_fd, employee_id);
-        if (offset == -1) {
+        int record = find_staff_record(employee_id);
+        if (record == -1) {
             send_response(client_socket, "ERROR", "Employee not found.");
-            close(db_fd); return;
+            return;
         }
         
-        struct flock lock = {F_WRLCK, SEEK_SET, offset, sizeof(struct EmployeeRecord), getpid()};
-        fcntl(db_fd, F_SETLKW, &lock);
+        storage_lock(STORAGE_STAFF, record, 1);
         
-        lseek(db_fd, offset, SEEK_SET); read(db_fd, &staff, sizeof(staff));
+        storage_get(STORAGE_STAFF, record, &staff);
         
         snprintf(g_write_buffer, sizeof(g_write_buffer), "Current name: %s %s. Enter new First Name: ", staff.first_name, staff.last_name);
         if (send_response(client_socket, "PROMPT", g_write_buffer) <= 0) goto cleanup_mod_staff;
@@ -1277,12 +1249,11 @@ void handle_modify_user_details(int client_socket, int modify_type) {
         if (read_line(client_socket, g_read_buffer, sizeof(g_read_buffer)) <= 0) goto cleanup_mod_staff;
         strncpy(staff.last_name, g_read_buffer, sizeof(staff.last_name) - 1);
 
-        lseek(db_fd, offset, SEEK_SET); write(db_fd, &staff, sizeof(staff));
+        storage_put(STORAGE_STAFF, record, &staff);
         send_response(client_socket, "SUCCESS", "Staff name updated.");
         
     cleanup_mod_staff:
-        lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-        close(db_fd);
+        storage_unlock(STORAGE_STAFF, record);
         
     } else {
         send_response(client_socket, "ERROR", "Invalid modification type.");
@@ -1300,25 +1271,22 @@ int handle_staff_password_change(int client_socket, int employee_id) {
         return 0;
     }
     
-    int db_fd = open(STAFF_DB_FILE, O_RDWR);
-    if (db_fd == -1) { send_response(client_socket, "ERROR", "Server database error."); return 0; }
+    if (storage_open(STORAGE_STAFF) == -1) { send_response(client_socket, "ERROR", "Server database error."); return 0; }
     
-    off_t offset = find_staff_record_offset(db_fd, employee_id);
-    if (offset == -1) {
+    int record = find_staff_record(employee_id);
+    if (record == -1) {
         send_response(client_socket, "ERROR", "Employee not found.");
-        close(db_fd); return 0;
+        return 0;
     }
     
-    struct flock lock = {F_WRLCK, SEEK_SET, offset, sizeof(struct EmployeeRecord), getpid()};
-    fcntl(db_fd, F_SETLKW, &lock);
+    storage_lock(STORAGE_STAFF, record, 1);
     
-    lseek(db_fd, offset, SEEK_SET); read(db_fd, &staff, sizeof(staff));
+    storage_get(STORAGE_STAFF, record, &staff);
     strncpy(staff.login_pass, new_pass, sizeof(staff.login_pass) - 1);
     staff.login_pass[sizeof(staff.login_pass) - 1] = '\0';
-    lseek(db_fd, offset, SEEK_SET); write(db_fd, &staff, sizeof(staff));
+    storage_put(STORAGE_STAFF, record, &staff);
     
-    lock.l_type = F_UNLCK; fcntl(db_fd, F_SETLK, &lock);
-    close(db_fd);
+    storage_unlock(STORAGE_STAFF, record);
     
     send_response(client_socket, "SUCCESS", "Password changed. You will be logged out.");
     return 1; // Success
@@ -29,22 +29,28 @@ void handle_fund_transfer(int client_socket, int source_account_id);
 void handle_loan_request(int client_socket, int account_id);
 void handle_view_transactions(int client_socket, int account_id);
 void handle_submit_feedback(int client_socket);
+void handle_export_statement(int client_socket, int account_id);
 
 // --- Staff-Specific Logic ---
 int login_staff(int client_socket, int employee_id, const char* pin, int role_required);
 void handle_create_customer(int client_socket);
 void handle_process_loan(int client_socket, int employee_id);
 void handle_view_assigned_loans(int client_socket, int employee_id);
+void handle_transactions_by_date(int client_socket); // Also on the manager menu
 
 // --- Manager-Specific Logic ---
 void handle_set_account_status(int client_socket);
 void handle_assign_loan(int client_socket);
 void handle_review_feedback(int client_socket);
+void handle_view_bank_totals(int client_socket);
+void handle_list_accounts(int client_socket);
 
 // --- Admin-Specific Logic ---
 int login_admin(int client_socket, const char* pass);
 void handle_create_staff(int client_socket);
+void handle_list_staff(int client_socket);
 void handle_update_staff_role(int client_socket);
+void handle_import_accounts(int client_socket);
 void handle_change_admin_pass(int client_socket);
 
 #endif // SERVER_LOGIC_H
@@ -0,0 +1,50 @@
+/*
+ * ========================================
+ * statement.h
+ * =Description: Full account statement export.
+ * - The whole history is rendered once into an
+ *   anonymous in-memory file (memfd), CSV or binary
+ * - The file is streamed to the client with
+ *   sendfile(), so the payload never passes through a
+ *   fixed-size response buffer
+ * - On the wire: "DATA:<file name>:<bytes>\n" followed
+ *   by exactly <bytes> raw bytes
+ * ========================================
+ */
+
+#ifndef STATEMENT_H
+#define STATEMENT_H
+
+#include "bank_storage.h"
+
+// --- Formats ---
+#define STATEMENT_CSV 0    // timestamp,operation,amount,balance,counterparty per line
+#define STATEMENT_BINARY 1 // struct StatementHeader, then struct Transaction records
+
+#define STATEMENT_MAGIC 0x4D545342u // "BSTM"
+#define STATEMENT_VERSION 1
+
+// Leads a binary statement
+struct StatementHeader {
+    unsigned int magic;
+    unsigned int version;
+    int account_id;
+    int record_size;       // sizeof(struct Transaction)
+    long long entries;
+    long long created_us;
+};
+
+// A rendered statement, ready to send
+struct Statement {
+    int fd;
+    int format;
+    long long size;        // Bytes
+    long long entries;
+};
+
+// --- Export ---
+int statement_render(int account_id, int format, struct Statement* statement);
+int statement_send(int socket_fd, const struct Statement* statement, const char* name);
+void statement_close(struct Statement* statement);
+
+#endif // STATEMENT_H
@@ -0,0 +1,920 @@
+/*
+ * ========================================
+ * storage.c
+ * =Description: Implementation of the storage
+ * engines (FILE, MMAP and MEMORY).
+ *
+ * Each engine is a table of function pointers; the
+ * storage_* calls dispatch to the one chosen by
+ * storage_init(), which runs in the parent before any
+ * fork. Shared state (MMAP/MEMORY record locks, MEMORY
+ * tables) is created there; file descriptors and
+ * mappings are opened lazily per process.
+ *
+ * MMAP and MEMORY lock records with striped, robust
+ * process-shared mutexes, which are always exclusive.
+ * Their whole-table lock is a separate mutex that
+ * serializes appenders and scanners, not record
+ * writers. The FILE engine uses fcntl locks, where the
+ * whole-table lock also excludes record lockers.
+ *
+ * Snapshot reads (every engine) take no lock at all.
+ * Each table has striped seqlock counters in shared
+ * memory: every write bumps `begun` before and `ended`
+ * after it touches its records, and a reader copies the
+ * record between loading `ended` and re-loading
+ * `begun`. If the two match, no write overlapped the
+ * copy; otherwise it copies again. Writers never wait
+ * on readers.
+ * ========================================
+ */
+
+#include "storage.h"
+#include "record_index.h"
+#include "loan_index.h"
+#include "txn_index.h"
+#include "txn_time_index.h"
+#include "journal.h"
+#include "uring.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define SCAN_BATCH 256 // Records per read during a scan
+#define SNAPSHOT_SPINS 8      // Snapshot retries before yielding the CPU
+#define SNAPSHOT_ATTEMPTS 64  // Then read under the record lock (e.g. a writer died mid-write)
+
+// One fixed-size record table
+struct StorageTable {
+    const char* path;  // NULL: exists only in the MEMORY engine
+    size_t record_size;
+    long capacity;     // Records addressable through a mapping or MEMORY table
+};
+
+static const struct StorageTable g_tables[STORAGE_TABLES] = {
+    [STORAGE_ACCOUNTS] = {ACCOUNT_DB_FILE, sizeof(struct AccountState), ACCOUNT_INDEX_CAPACITY},
+    [STORAGE_ACCOUNT_PROFILES] = {ACCOUNT_PROFILE_FILE, sizeof(struct AccountProfile), ACCOUNT_INDEX_CAPACITY},
+    [STORAGE_STAFF] = {STAFF_DB_FILE, sizeof(struct EmployeeRecord), STAFF_INDEX_CAPACITY},
+    [STORAGE_LOANS] = {LOAN_DB_FILE, sizeof(struct LoanApplication), LOAN_INDEX_CAPACITY},
+    [STORAGE_FEEDBACK] = {FEEDBACK_DB_FILE, sizeof(struct FeedbackEntry), STORAGE_FEEDBACK_CAPACITY},
+    [STORAGE_TRANSACTIONS] = {NULL, sizeof(struct Transaction), STORAGE_MEMORY_TRANSACTIONS},
+};
+
+// Operations every engine provides
+struct StorageEngine {
+    const char* name;
+    int (*open)(int table);
+    long (*count)(int table);
+    int (*read)(int table, int first_record, int count, void* records);
+    int (*write)(int table, int first_record, int count, const void* records, int extend);
+    int (*read_set)(struct StorageRead* reads, int count);
+    int (*write_set)(const struct StorageWrite* writes, int count);
+    int (*lock)(int table, int record, int exclusive);
+    void (*unlock)(int table, int record);
+    const void* (*records)(int table, long* count);
+    int (*append_transactions)(const struct Transaction* entries, int count);
+    int (*recent_transactions)(int account_id, struct Transaction* entries, int max_entries);
+    int (*transactions_between)(int account_id, long long from_us, long long to_us, txn_visit_fn visit, void* ctx);
+    int (*account_history)(int account_id, txn_visit_fn visit, void* ctx);
+};
+
+// Shared by every process (MMAP and MEMORY engines)
+struct StorageShared {
+    pthread_mutex_t table_locks[STORAGE_TABLES];
+    pthread_mutex_t record_locks[STORAGE_TABLES][STORAGE_LOCK_STRIPES];
+    long counts[STORAGE_TABLES]; // MEMORY engine: records in use
+};
+
+// Seqlock counters for one stripe of records; the stripe is quiet when they match
+struct StorageVersion {
+    unsigned long begun;
+    unsigned long ended;
+};
+
+static const struct StorageEngine g_file_engine, g_file_shared_lock_engine, g_mmap_engine, g_memory_engine;
+
+// --- Shared Configuration (set before fork) ---
+static const struct StorageEngine* g_engine = &g_file_engine;
+static int g_sync_policy = STORAGE_SYNC_NONE;
+static struct StorageShared* g_shared = NULL;
+static char* g_memory[STORAGE_TABLES];
+static struct StorageVersion (*g_versions)[STORAGE_VERSION_STRIPES] = NULL; // NULL: snapshots lock
+
+// --- Per-Process State ---
+static int g_fds[STORAGE_TABLES] = {-1, -1, -1, -1, -1, -1};
+static char* g_maps[STORAGE_TABLES];
+
+static int valid_table(int table) {
+    return table >= 0 && table < STORAGE_TABLES && (g_tables[table].path != NULL || g_engine == &g_memory_engine);
+}
+
+// --- FILE Engine ---
+
+static int file_open(int table) {
+    if (g_fds[table] != -1) return 0;
+    g_fds[table] = open(g_tables[table].path, O_RDWR | O_CREAT, 0644);
+    if (g_fds[table] == -1) {
+        perror("storage: open failed");
+        return -1;
+    }
+    return 0;
+}
+
+static long file_count(int table) {
+    struct stat st;
+    if (fstat(g_fds[table], &st) == -1) return -1;
+    return (long)(st.st_size / (off_t)g_tables[table].record_size);
+}
+
+static int file_read(int table, int first_record, int count, void* records) {
+    size_t size = g_tables[table].record_size;
+    ssize_t n = pread(g_fds[table], records, (size_t)count * size, (off_t)first_record * size);
+    return (n < 0) ? -1 : (int)((size_t)n / size);
+}
+
+static int file_write(int table, int first_record, int count, const void* records, int extend) {
+    size_t size = g_tables[table].record_size;
+    const char* data = records;
+    size_t left = (size_t)count * size;
+    off_t offset = (off_t)first_record * size;
+    while (left > 0) {
+        ssize_t n = pwrite(g_fds[table], data, left, offset);
+        if (n <= 0) return -1;
+        data += n; left -= (size_t)n; offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads every record of the set with one io_uring submission
+ * (plain preads without io_uring).
+ */
+static int file_read_set(struct StorageRead* reads, int count) {
+    struct UringOp ops[count];
+    for (int i = 0; i < count; i++) {
+        size_t size = g_tables[reads[i].table].record_size;
+        ops[i] = (struct UringOp){URING_READ, g_fds[reads[i].table], reads[i].data, size,
+                                  (off_t)reads[i].record * size, 0, 0};
+    }
+    return uring_run(ops, count);
+}
+
+/**
+ * @brief Writes every record of the set with one io_uring submission.
+ * The writes are independent and may land in any order.
+ */
+static int file_write_set(const struct StorageWrite* writes, int count) {
+    struct UringOp ops[count];
+    for (int i = 0; i < count; i++) {
+        size_t size = g_tables[writes[i].table].record_size;
+        ops[i] = (struct UringOp){URING_WRITE, g_fds[writes[i].table], (void*)writes[i].data, size,
+                                  (off_t)writes[i].record * size, 0, 0};
+    }
+    return uring_run(ops, count);
+}
+
+static int fcntl_lock(int table, int record, int type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type; lock.l_whence = SEEK_SET;
+    if (record != STORAGE_WHOLE_TABLE) {
+        lock.l_start = (off_t)record * g_tables[table].record_size;
+        lock.l_len = g_tables[table].record_size;
+    }
+    return fcntl(g_fds[table], (type == F_UNLCK) ? F_SETLK : F_SETLKW, &lock);
+}
+
+static int file_lock(int table, int record, int exclusive) {
+    return fcntl_lock(table, record, exclusive ? F_WRLCK : F_RDLCK);
+}
+
+static void file_unlock(int table, int record) {
+    fcntl_lock(table, record, F_UNLCK);
+}
+
+// Sets for engines without batched I/O: one record at a time
+static int each_read(struct StorageRead* reads, int count) {
+    for (int i = 0; i < count; i++) {
+        if (g_engine->read(reads[i].table, reads[i].record, 1, reads[i].data) != 1) return -1;
+    }
+    return 0;
+}
+
+static int each_write(const struct StorageWrite* writes, int count) {
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        if (g_engine->write(writes[i].table, writes[i].record, 1, writes[i].data, writes[i].extend) == -1) rc = -1;
+    }
+    return rc;
+}
+
+static const void* no_records(int table, long* count) {
+    return NULL;
+}
+
+// --- Transaction Log (FILE and MMAP) ---
+
+/**
+ * @brief Appends entries through the group-commit journal, or under
+ * the tail segment lock without one. A batch stays contiguous in the log.
+ */
+static int log_append_transactions(const struct Transaction* entries, int count) {
+    if (g_transaction_journal != NULL) {
+        if (count == 1) return journal_append(g_transaction_journal, entries);
+        return journal_append_batch(g_transaction_journal, entries, count);
+    }
+
+    // Only the tail segment is locked; readers never wait on it
+    if (txn_log_lock_tail() == -1) {
+        fprintf(stderr, "CRITICAL: transaction log unavailable\n");
+        return -1;
+    }
+
+    int rc = -1;
+    long record = txn_log_record_count();
+    if (txn_log_write(record, entries, count, 0) == 0) {
+        // Still under the tail lock, so chain updates are serialized
+        if (count == 1) {
+            txn_index_append((int)record, entries->account_id);
+        } else {
+            txn_index_commit_batch(record, entries, count);
+        }
+        rc = 0;
+    }
+    txn_log_unlock_tail();
+    return rc;
+}
+
+// Collects up to `capacity` transactions, newest first
+struct RecentTransactions {
+    struct Transaction* entries;
+    int count;
+    int capacity;
+};
+
+static int collect_recent_transaction(const struct Transaction* entry, void* ctx) {
+    struct RecentTransactions* recent = ctx;
+    recent->entries[recent->count++] = *entry;
+    return recent->count == recent->capacity;
+}
+
+// Keeps the last `capacity` transactions seen by an oldest-first scan
+struct TransactionRing {
+    struct Transaction* entries;
+    int seen;
+    int capacity;
+};
+
+static int keep_latest_transaction(const struct Transaction* entry, void* ctx) {
+    struct TransactionRing* ring = ctx;
+    ring->entries[ring->seen++ % ring->capacity] = *entry;
+    return 0;
+}
+
+/**
+ * @brief Returns an account's last entries (newest first) from the
+ * transaction index, or, if it is unavailable, by scanning the log
+ * segments that may hold the account. Takes no locks.
+ * @return Number of entries found, or -1 on a database error.
+ */
+static int log_recent_transactions(int account_id, struct Transaction* entries, int max_entries) {
+    struct RecentTransactions recent = {entries, 0, max_entries};
+    int found = txn_index_walk(account_id, max_entries, collect_recent_transaction, &recent);
+    if (found != -1) return found;
+
+    struct Transaction ring_entries[max_entries];
+    struct TransactionRing ring = {ring_entries, 0, max_entries};
+    if (txn_log_scan(account_id, keep_latest_transaction, &ring) == -1) return -1;
+
+    found = (ring.seen < max_entries) ? ring.seen : max_entries;
+    for (int i = 0; i < found; i++) {
+        entries[i] = ring_entries[(ring.seen - 1 - i) % max_entries];
+    }
+    return found;
+}
+
+// Collects a whole index chain (newest first) into a growing array
+struct HistoryChain {
+    struct Transaction* entries;
+    int count;
+    int capacity;
+};
+
+static int collect_history_entry(const struct Transaction* entry, void* ctx) {
+    struct HistoryChain* chain = ctx;
+    if (chain->count == chain->capacity) {
+        int capacity = chain->capacity ? chain->capacity * 2 : 256;
+        struct Transaction* grown = realloc(chain->entries, (size_t)capacity * sizeof(struct Transaction));
+        if (grown == NULL) return 1;
+        chain->entries = grown;
+        chain->capacity = capacity;
+    }
+    chain->entries[chain->count++] = *entry;
+    return 0;
+}
+
+/**
+ * @brief Visits all of an account's entries, oldest first. The index
+ * chain runs newest first, so it is collected and replayed backwards;
+ * without the index the log is scanned. Takes no locks.
+ * @return Number of entries visited, or -1 on a database error.
+ */
+static int log_account_history(int account_id, txn_visit_fn visit, void* ctx) {
+    struct HistoryChain chain = {NULL, 0, 0};
+    int found = txn_index_walk(account_id, 0, collect_history_entry, &chain);
+    if (found == -1) return txn_log_scan(account_id, visit, ctx);
+    if (found != chain.count) { // Out of memory
+        free(chain.entries);
+        return -1;
+    }
+
+    int visited = 0;
+    for (int i = chain.count - 1; i >= 0; i--) {
+        visited++;
+        if (visit(&chain.entries[i], ctx)) break;
+    }
+    free(chain.entries);
+    return visited;
+}
+
+// --- MMAP Engine ---
+
+/**
+ * @brief Opens a table file and maps room for every record it can
+ * address. Pages past the current EOF are never touched until a write
+ * has extended the file over them.
+ */
+static int mmap_open(int table) {
+    if (g_maps[table] != NULL) return 0;
+    // The file may already be open from before storage_init() (WAL recovery)
+    if (file_open(table) == -1) return -1;
+
+    size_t map_size = (size_t)g_tables[table].capacity * g_tables[table].record_size;
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, g_fds[table], 0);
+    if (map == MAP_FAILED) {
+        perror("storage: mmap failed");
+        close(g_fds[table]);
+        g_fds[table] = -1;
+        return -1;
+    }
+    g_maps[table] = map;
+    return 0;
+}
+
+static char* mapped_record(int table, int record) {
+    if (record < 0 || record >= g_tables[table].capacity) return NULL;
+    return g_maps[table] + (size_t)record * g_tables[table].record_size;
+}
+
+/**
+ * @brief Applies the configured msync policy to a written range.
+ */
+static void sync_mapped_range(char* addr, size_t len) {
+    if (g_sync_policy == STORAGE_SYNC_NONE) return;
+
+    uintptr_t page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t start = (uintptr_t)addr & ~page_mask;
+    int flags = (g_sync_policy == STORAGE_SYNC_SYNC) ? MS_SYNC : MS_ASYNC;
+    msync((void*)start, (uintptr_t)addr + len - start, flags);
+}
+
+/**
+ * @brief Single records come from the mapping (callers only ask for
+ * records they know exist); batches may run into EOF, so they use pread.
+ */
+static int mmap_read(int table, int first_record, int count, void* records) {
+    char* src = (count == 1) ? mapped_record(table, first_record) : NULL;
+    if (src == NULL) return file_read(table, first_record, count, records);
+    memcpy(records, src, g_tables[table].record_size);
+    return 1;
+}
+
+/**
+ * @brief Extending writes use pwrite, because touching mapped pages
+ * beyond EOF would fault.
+ */
+static int mmap_write(int table, int first_record, int count, const void* records, int extend) {
+    char* dst = extend ? NULL : mapped_record(table, first_record);
+    if (dst == NULL || first_record + count > g_tables[table].capacity) {
+        return file_write(table, first_record, count, records, extend);
+    }
+    size_t bytes = (size_t)count * g_tables[table].record_size;
+    memcpy(dst, records, bytes);
+    sync_mapped_range(dst, bytes);
+    return 0;
+}
+
+static const void* mmap_records(int table, long* count) {
+    *count = file_count(table);
+    if (*count > g_tables[table].capacity) *count = g_tables[table].capacity;
+    return (*count < 0) ? NULL : g_maps[table];
+}
+
+// --- Shared Locks (MMAP, MEMORY, and FILE with threaded sessions) ---
+
+static pthread_mutex_t* shared_lock_for(int table, int record) {
+    if (record == STORAGE_WHOLE_TABLE) return &g_shared->table_locks[table];
+    return &g_shared->record_locks[table][record % STORAGE_LOCK_STRIPES];
+}
+
+static int shared_lock(int table, int record, int exclusive) {
+    return lock_session_mutex(shared_lock_for(table, record)); // Held across prompts by some handlers
+}
+
+static void shared_unlock(int table, int record) {
+    pthread_mutex_unlock(shared_lock_for(table, record));
+}
+
+// --- MEMORY Engine ---
+
+static int memory_open(int table) {
+    return (g_memory[table] != NULL) ? 0 : -1;
+}
+
+static long memory_count(int table) {
+    return __atomic_load_n(&g_shared->counts[table], __ATOMIC_ACQUIRE);
+}
+
+static int memory_read(int table, int first_record, int count, void* records) {
+    long available = memory_count(table) - first_record;
+    if (first_record < 0 || available <= 0) return 0;
+    if (count > available) count = (int)available;
+    size_t size = g_tables[table].record_size;
+    memcpy(records, g_memory[table] + (size_t)first_record * size, (size_t)count * size);
+    return count;
+}
+
+/**
+ * @brief Writes records; an extending write then publishes them by
+ * raising the record count (records may be extended out of order).
+ */
+static int memory_write(int table, int first_record, int count, const void* records, int extend) {
+    long end = (long)first_record + count;
+    if (first_record < 0 || end > g_tables[table].capacity) return -1;
+    size_t size = g_tables[table].record_size;
+    memcpy(g_memory[table] + (size_t)first_record * size, records, (size_t)count * size);
+
+    long published = memory_count(table);
+    while (published < end &&
+           !__atomic_compare_exchange_n(&g_shared->counts[table], &published, end, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+    return 0;
+}
+
+static const void* memory_records(int table, long* count) {
+    *count = memory_count(table);
+    return g_memory[table];
+}
+
+static int memory_append_transactions(const struct Transaction* entries, int count) {
+    if (shared_lock(STORAGE_TRANSACTIONS, STORAGE_WHOLE_TABLE, 1) == -1) return -1;
+    int rc = memory_write(STORAGE_TRANSACTIONS, (int)memory_count(STORAGE_TRANSACTIONS), count, entries, 1);
+    shared_unlock(STORAGE_TRANSACTIONS, STORAGE_WHOLE_TABLE);
+    return rc;
+}
+
+static int memory_recent_transactions(int account_id, struct Transaction* entries, int max_entries) {
+    const struct Transaction* log = (const struct Transaction*)g_memory[STORAGE_TRANSACTIONS];
+    int found = 0;
+    for (long i = memory_count(STORAGE_TRANSACTIONS) - 1; i >= 0 && found < max_entries; i--) {
+        if (log[i].account_id == account_id) entries[found++] = log[i];
+    }
+    return found;
+}
+
+static int memory_transactions_between(int account_id, long long from_us, long long to_us,
+                                       txn_visit_fn visit, void* ctx) {
+    const struct Transaction* log = (const struct Transaction*)g_memory[STORAGE_TRANSACTIONS];
+    long count = memory_count(STORAGE_TRANSACTIONS);
+    int visited = 0;
+    for (long i = 0; i < count; i++) {
+        if (account_id != TXN_ALL_ACCOUNTS && log[i].account_id != account_id) continue;
+        if (log[i].timestamp_us < from_us || log[i].timestamp_us > to_us) continue;
+        visited++;
+        if (visit(&log[i], ctx)) break;
+    }
+    return visited;
+}
+
+static int memory_account_history(int account_id, txn_visit_fn visit, void* ctx) {
+    return memory_transactions_between(account_id, LLONG_MIN, LLONG_MAX, visit, ctx);
+}
+
+// --- Engines ---
+
+static const struct StorageEngine g_file_engine = {
+    "file", file_open, file_count, file_read, file_write, file_read_set, file_write_set, file_lock, file_unlock, no_records,
+    log_append_transactions, log_recent_transactions, txn_time_index_scan, log_account_history,
+};
+
+// FILE engine for threaded sessions: fcntl() locks only exclude other processes
+static const struct StorageEngine g_file_shared_lock_engine = {
+    "file", file_open, file_count, file_read, file_write, file_read_set, file_write_set, shared_lock, shared_unlock, no_records,
+    log_append_transactions, log_recent_transactions, txn_time_index_scan, log_account_history,
+};
+
+static const struct StorageEngine g_mmap_engine = {
+    "mmap", mmap_open, file_count, mmap_read, mmap_write, each_read, each_write, shared_lock, shared_unlock, mmap_records,
+    log_append_transactions, log_recent_transactions, txn_time_index_scan, log_account_history,
+};
+
+static const struct StorageEngine g_memory_engine = {
+    "memory", memory_open, memory_count, memory_read, memory_write, each_read, each_write, shared_lock, shared_unlock, memory_records,
+    memory_append_transactions, memory_recent_transactions, memory_transactions_between, memory_account_history,
+};
+
+// --- Engine Lifecycle ---
+
+static int create_shared_locks(void) {
+    if (g_shared != NULL) return 0;
+    g_shared = create_shared_region(sizeof(struct StorageShared));
+    if (g_shared == NULL) return -1;
+    for (int t = 0; t < STORAGE_TABLES; t++) {
+        init_shared_mutex(&g_shared->table_locks[t]);
+        for (int i = 0; i < STORAGE_LOCK_STRIPES; i++) {
+            init_shared_mutex(&g_shared->record_locks[t][i]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Selects the engine. Every engine creates its snapshot counters
+ * here, MMAP and MEMORY their shared locks (and MEMORY its tables), so
+ * this must run before fork().
+ * @return 0 on success, -1 if the engine could not be set up (the FILE
+ * engine stays selected).
+ */
+int storage_init(int engine, int sync_policy) {
+    g_sync_policy = sync_policy;
+    g_versions = create_shared_region(sizeof(*g_versions) * STORAGE_TABLES);
+    if (engine == STORAGE_FILE) return 0;
+    if (create_shared_locks() == -1) return -1;
+
+    if (engine == STORAGE_MEMORY) {
+        for (int t = 0; t < STORAGE_TABLES; t++) {
+            g_memory[t] = create_shared_region((size_t)g_tables[t].capacity * g_tables[t].record_size);
+            if (g_memory[t] == NULL) return -1;
+        }
+        g_engine = &g_memory_engine;
+    } else {
+        g_engine = &g_mmap_engine;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prepares the engine for sessions that share a process (epoll
+ * worker threads, or the coroutines of a pre-forked worker): the FILE
+ * engine switches from fcntl() record locks, which only exclude other
+ * processes, to the shared mutexes, and every table is opened up front
+ * so no two threads race to open it. Run after storage_init(), before
+ * the first session starts.
+ */
+int storage_init_threads(void) {
+    if (g_engine == &g_file_engine) {
+        if (create_shared_locks() == -1) return -1;
+        g_engine = &g_file_shared_lock_engine;
+    }
+    int rc = 0;
+    for (int t = 0; t < STORAGE_TABLES; t++) {
+        if (g_tables[t].path != NULL && g_engine->open(t) == -1) rc = -1;
+    }
+    return rc;
+}
+
+int storage_engine(void) {
+    if (g_engine == &g_memory_engine) return STORAGE_MEMORY;
+    return (g_engine == &g_mmap_engine) ? STORAGE_MMAP : STORAGE_FILE;
+}
+
+const char* storage_engine_name(void) {
+    return g_engine->name;
+}
+
+// --- Versioned Writes ---
+
+/**
+ * @brief Marks the stripes of `count` records as being written (`end`
+ * 0) or written (`end` 1). A range longer than the stripe count marks
+ * every stripe once.
+ */
+static void bump_versions(int table, int first_record, int count, int end) {
+    if (g_versions == NULL) return;
+    int stripes = (count < STORAGE_VERSION_STRIPES) ? count : STORAGE_VERSION_STRIPES;
+    for (int i = 0; i < stripes; i++) {
+        struct StorageVersion* version = &g_versions[table][((long)first_record + i) % STORAGE_VERSION_STRIPES];
+        if (end) {
+            __atomic_fetch_add(&version->ended, 1, __ATOMIC_RELEASE);
+        } else {
+            __atomic_fetch_add(&version->begun, 1, __ATOMIC_RELAXED);
+        }
+    }
+    // `begun` must be visible before any of the record bytes
+    if (!end) __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static int versioned_write(int table, int first_record, int count, const void* records, int extend) {
+    bump_versions(table, first_record, count, 0);
+    int rc = g_engine->write(table, first_record, count, records, extend);
+    bump_versions(table, first_record, count, 1);
+    return rc;
+}
+
+// --- Records ---
+
+/**
+ * @brief Opens a table for this process. Safe to call repeatedly; the
+ * FILE and MMAP engines create the file on first use.
+ */
+int storage_open(int table) {
+    if (!valid_table(table)) return -1;
+    return g_engine->open(table);
+}
+
+size_t storage_record_size(int table) {
+    return g_tables[table].record_size;
+}
+
+/**
+ * @brief Returns the number of records in a table, or -1 on error.
+ */
+long storage_count(int table) {
+    if (storage_open(table) == -1) return -1;
+    return g_engine->count(table);
+}
+
+/**
+ * @brief Copies one record out of a table.
+ */
+int storage_get(int table, int record, void* data) {
+    if (storage_open(table) == -1 || record < 0) return -1;
+    return (g_engine->read(table, record, 1, data) == 1) ? 0 : -1;
+}
+
+/**
+ * @brief Copies one record without locking it, consistent even while
+ * it is being updated. Copies again only when a write to the record's
+ * stripe overlapped the copy.
+ */
+int storage_snapshot(int table, int record, void* data) {
+    if (storage_open(table) == -1 || record < 0) return -1;
+
+    if (g_versions != NULL) {
+        struct StorageVersion* version = &g_versions[table][record % STORAGE_VERSION_STRIPES];
+        for (int attempt = 0; attempt < SNAPSHOT_ATTEMPTS; attempt++) {
+            unsigned long ended = __atomic_load_n(&version->ended, __ATOMIC_ACQUIRE);
+            int copied = g_engine->read(table, record, 1, data);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&version->begun, __ATOMIC_RELAXED) == ended) return (copied == 1) ? 0 : -1;
+            if (attempt >= SNAPSHOT_SPINS) sched_yield();
+        }
+    }
+
+    // No counters, or the stripe never went quiet: read under the lock
+    if (g_engine->lock(table, record, 0) == -1) return -1;
+    int copied = g_engine->read(table, record, 1, data);
+    g_engine->unlock(table, record);
+    return (copied == 1) ? 0 : -1;
+}
+
+/**
+ * @brief Copies up to `count` consecutive records.
+ * @return Records copied (fewer at the end of the table), or -1.
+ */
+int storage_read(int table, int first_record, int count, void* records) {
+    if (storage_open(table) == -1 || first_record < 0) return -1;
+    return g_engine->read(table, first_record, count, records);
+}
+
+/**
+ * @brief Copies several records, possibly from different tables, as one
+ * batch (one io_uring submission with the FILE engine).
+ * @return 0 if every record was copied, -1 otherwise.
+ */
+int storage_read_set(struct StorageRead* reads, int count) {
+    for (int i = 0; i < count; i++) {
+        if (storage_open(reads[i].table) == -1 || reads[i].record < 0) return -1;
+    }
+    return g_engine->read_set(reads, count);
+}
+
+/**
+ * @brief Overwrites an existing record. Caller must hold its lock.
+ */
+int storage_put(int table, int record, const void* data) {
+    if (storage_open(table) == -1 || record < 0) return -1;
+    return versioned_write(table, record, 1, data, 0);
+}
+
+/**
+ * @brief Writes a record at or past the end of a table.
+ */
+int storage_extend(int table, int record, const void* data) {
+    if (storage_open(table) == -1 || record < 0) return -1;
+    return versioned_write(table, record, 1, data, 1);
+}
+
+/**
+ * @brief Writes `count` consecutive records at or past the end of a
+ * table with one write (bulk loads).
+ */
+int storage_extend_batch(int table, int first_record, int count, const void* records) {
+    if (storage_open(table) == -1 || first_record < 0 || count < 0) return -1;
+    if (count == 0) return 0;
+    return versioned_write(table, first_record, count, records, 1);
+}
+
+/**
+ * @brief Writes several records, possibly to different tables, as one
+ * batch (one io_uring submission with the FILE engine). Callers hold the
+ * locks of the records they overwrite. The records land in no
+ * particular order.
+ */
+int storage_write_set(const struct StorageWrite* writes, int count) {
+    for (int i = 0; i < count; i++) {
+        if (storage_open(writes[i].table) == -1 || writes[i].record < 0) return -1;
+    }
+    for (int i = 0; i < count; i++) bump_versions(writes[i].table, writes[i].record, 1, 0);
+    int rc = g_engine->write_set(writes, count);
+    for (int i = 0; i < count; i++) bump_versions(writes[i].table, writes[i].record, 1, 1);
+    return rc;
+}
+
+/**
+ * @brief Adds a record after the last one. The caller serializes
+ * appenders (with the table lock or an index writer lock).
+ * @return The new record number, or -1 on error.
+ */
+int storage_append(int table, const void* data) {
+    long record = storage_count(table);
+    if (record < 0 || record > INT32_MAX) return -1;
+    return (versioned_write(table, (int)record, 1, data, 1) == 0) ? (int)record : -1;
+}
+
+/**
+ * @brief Flushes a table's writes to disk (a no-op for MEMORY).
+ */
+int storage_sync(int table) {
+    if (storage_open(table) == -1) return -1;
+    return (g_engine == &g_memory_engine) ? 0 : fsync(g_fds[table]);
+}
+
+/**
+ * @brief Visits every record in order, batch by batch, without locks.
+ * @return 0 when the scan finished or was stopped, -1 on error.
+ */
+int storage_scan(int table, storage_visit_fn visit, void* ctx) {
+    if (storage_open(table) == -1) return -1;
+    size_t size = g_tables[table].record_size;
+    char* batch = malloc(SCAN_BATCH * size);
+    if (batch == NULL) return -1;
+
+    int rc = 0, got;
+    for (int first = 0; (got = g_engine->read(table, first, SCAN_BATCH, batch)) > 0; first += got) {
+        for (int i = 0; i < got && rc == 0; i++) {
+            if (visit(first + i, batch + (size_t)i * size, ctx)) rc = 1;
+        }
+        if (rc) break;
+    }
+    free(batch);
+    return (got < 0) ? -1 : 0;
+}
+
+struct FindKey {
+    int key;
+    int record;
+};
+
+static int match_key(int record, const void* data, void* ctx) {
+    struct FindKey* find = ctx;
+    int key;
+    memcpy(&key, data, sizeof(key));
+    if (key != find->key) return 0;
+    find->record = record;
+    return 1;
+}
+
+/**
+ * @brief Scans a keyed table (the key is each record's first int) for
+ * `key`. Only a fallback for when no index can answer.
+ * @return The record number, or -1 if not found.
+ */
+int storage_find(int table, int key) {
+    struct FindKey find = {key, -1};
+    if (table == STORAGE_FEEDBACK || storage_scan(table, match_key, &find) == -1) return -1;
+    return find.record;
+}
+
+/**
+ * @brief Returns a read-only view of every record when the engine keeps
+ * the table in memory (MMAP, MEMORY), or NULL (FILE).
+ */
+const void* storage_records(int table, long* count) {
+    if (storage_open(table) == -1) return NULL;
+    return g_engine->records(table, count);
+}
+
+// --- Locking ---
+
+/**
+ * @brief Locks one record, or the whole table with STORAGE_WHOLE_TABLE
+ * (shared or exclusive; MMAP and MEMORY locks are always exclusive).
+ */
+int storage_lock(int table, int record, int exclusive) {
+    if (storage_open(table) == -1) return -1;
+    return g_engine->lock(table, record, exclusive);
+}
+
+/**
+ * @brief Releases a lock taken with storage_lock().
+ */
+void storage_unlock(int table, int record) {
+    g_engine->unlock(table, record);
+}
+
+/**
+ * @brief Exclusively locks two records in a global order to avoid deadlock.
+ */
+int storage_lock_pair(int table, int record_a, int record_b) {
+    if (g_engine != &g_file_engine) {
+        int stripe_a = record_a % STORAGE_LOCK_STRIPES;
+        int stripe_b = record_b % STORAGE_LOCK_STRIPES;
+        if (stripe_a == stripe_b) return storage_lock(table, record_a, 1);
+        if (stripe_a > stripe_b) { int t = record_a; record_a = record_b; record_b = t; }
+    } else if (record_a > record_b) {
+        int t = record_a; record_a = record_b; record_b = t;
+    }
+
+    if (storage_lock(table, record_a, 1) == -1) return -1;
+    if (storage_lock(table, record_b, 1) == -1) {
+        storage_unlock(table, record_a);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases a lock taken with storage_lock_pair().
+ */
+void storage_unlock_pair(int table, int record_a, int record_b) {
+    storage_unlock(table, record_a);
+    if (g_engine == &g_file_engine ||
+        record_a % STORAGE_LOCK_STRIPES != record_b % STORAGE_LOCK_STRIPES) {
+        storage_unlock(table, record_b);
+    }
+}
+
+// --- Transactions ---
+
+/**
+ * @brief Appends one transaction log entry.
+ */
+int storage_append_transaction(const struct Transaction* entry) {
+    return g_engine->append_transactions(entry, 1);
+}
+
+/**
+ * @brief Appends a batch of entries as one contiguous run of the log.
+ */
+int storage_append_transactions(const struct Transaction* entries, int count) {
+    if (count <= 0) return 0;
+    return g_engine->append_transactions(entries, count);
+}
+
+/**
+ * @brief Copies an account's last `max_entries` log entries, newest first.
+ * @return Number of entries copied, or -1 on a database error.
+ */
+int storage_recent_transactions(int account_id, struct Transaction* entries, int max_entries) {
+    return g_engine->recent_transactions(account_id, entries, max_entries);
+}
+
+/**
+ * @brief Visits, in log order, every log entry of `account_id` (or of
+ * TXN_ALL_ACCOUNTS) timestamped within [from_us, to_us].
+ * @return Number of entries visited, or -1 on a database error.
+ */
+int storage_transactions_between(int account_id, long long from_us, long long to_us, txn_visit_fn visit, void* ctx) {
+    return g_engine->transactions_between(account_id, from_us, to_us, visit, ctx);
+}
+
+/**
+ * @brief Visits every log entry of an account, oldest first.
+ * @return Number of entries visited, or -1 on a database error.
+ */
+int storage_account_history(int account_id, txn_visit_fn visit, void* ctx) {
+    return g_engine->account_history(account_id, visit, ctx);
+}
@@ -0,0 +1,111 @@
+/*
+ * ========================================
+ * storage.h
+ * =Description: Storage engine interface for the
+ * bank's fixed-size record tables (accounts, staff,
+ * loans, feedback) and the transaction log.
+ * One engine serves every table and is chosen at
+ * startup:
+ * - FILE: pread/pwrite with fcntl byte-range locks;
+ *   multi-record reads and writes go to the kernel as
+ *   one io_uring batch when it is enabled (uring.h)
+ * - MMAP: files mapped MAP_SHARED, records changed in
+ *   place, guarded by process-shared record locks
+ * - MEMORY: shared anonymous memory, nothing is read
+ *   from or written to disk (tests and benchmarks)
+ * Records are addressed by record number; the FILE
+ * and MMAP engines share the on-disk layout.
+ * ========================================
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <sys/types.h>  // For size_t
+
+#include "bank_storage.h"
+#include "txn_log.h" // txn_visit_fn
+
+// --- Engines ---
+#define STORAGE_FILE 0
+#define STORAGE_MMAP 1
+#define STORAGE_MEMORY 2
+
+// --- msync Policies (MMAP engine only) ---
+#define STORAGE_SYNC_NONE 0   // Leave write-back to the kernel
+#define STORAGE_SYNC_ASYNC 1  // msync(MS_ASYNC) after every update
+#define STORAGE_SYNC_SYNC 2   // msync(MS_SYNC) after every update
+
+// --- Tables ---
+#define STORAGE_ACCOUNTS 0         // struct AccountState, accounts.dat
+#define STORAGE_ACCOUNT_PROFILES 1 // struct AccountProfile, account_profiles.dat
+#define STORAGE_STAFF 2            // struct EmployeeRecord, staff.dat
+#define STORAGE_LOANS 3            // struct LoanApplication, loans.dat
+#define STORAGE_FEEDBACK 4         // struct FeedbackEntry, feedback.dat
+#define STORAGE_TRANSACTIONS 5     // struct Transaction (MEMORY engine; on disk it is the segmented log)
+#define STORAGE_TABLES 6
+
+// --- Tuning ---
+#define STORAGE_LOCK_STRIPES 4096           // Shared record locks per table (MMAP and MEMORY)
+#define STORAGE_FEEDBACK_CAPACITY (1 << 16) // Feedback entries addressable by MMAP/MEMORY
+#define STORAGE_MEMORY_TRANSACTIONS (1 << 20) // Transaction log capacity of the MEMORY engine
+#define STORAGE_VERSION_STRIPES (1 << 16)     // Seqlock counters per table (snapshot reads)
+
+#define STORAGE_WHOLE_TABLE -1 // storage_lock(): lock the table instead of one record
+
+// One record of a multi-record read (storage_read_set)
+struct StorageRead {
+    int table;
+    int record;
+    void* data;
+};
+
+// One record of a multi-record write (storage_write_set)
+struct StorageWrite {
+    int table;
+    int record;
+    const void* data;
+    int extend;  // At or past the end of the table
+};
+
+// Visitor for table scans; return non-zero to stop early
+typedef int (*storage_visit_fn)(int record, const void* data, void* ctx);
+
+// --- Engine Lifecycle (parent, before fork) ---
+int storage_init(int engine, int sync_policy);
+int storage_init_threads(void);
+int storage_engine(void);
+const char* storage_engine_name(void);
+
+// --- Records ---
+int storage_open(int table);
+size_t storage_record_size(int table);
+long storage_count(int table);
+int storage_get(int table, int record, void* data);
+int storage_snapshot(int table, int record, void* data);
+int storage_read(int table, int first_record, int count, void* records);
+int storage_read_set(struct StorageRead* reads, int count);
+int storage_put(int table, int record, const void* data);
+int storage_extend(int table, int record, const void* data);
+int storage_extend_batch(int table, int first_record, int count, const void* records);
+int storage_write_set(const struct StorageWrite* writes, int count);
+int storage_append(int table, const void* data);
+int storage_sync(int table);
+int storage_scan(int table, storage_visit_fn visit, void* ctx);
+int storage_find(int table, int key);
+const void* storage_records(int table, long* count);
+
+// --- Locking ---
+int storage_lock(int table, int record, int exclusive);
+void storage_unlock(int table, int record);
+int storage_lock_pair(int table, int record_a, int record_b);
+void storage_unlock_pair(int table, int record_a, int record_b);
+
+// --- Transactions ---
+int storage_append_transaction(const struct Transaction* entry);
+int storage_append_transactions(const struct Transaction* entries, int count);
+int storage_recent_transactions(int account_id, struct Transaction* entries, int max_entries);
+int storage_transactions_between(int account_id, long long from_us, long long to_us, txn_visit_fn visit, void* ctx);
+int storage_account_history(int account_id, txn_visit_fn visit, void* ctx);
+
+#endif // STORAGE_H
@@ -0,0 +1,214 @@
+/*
+ * ========================================
+ * txn_index.c
+ * =Description: Implementation of the per-account
+ * transaction index.
+ *
+ * Record N of transactions.idx describes global record
+ * N of the segmented log. Appends write the log record, then
+ * its index entry, then publish the new chain head, so
+ * readers walking a chain only ever see complete
+ * records and need no file lock.
+ * ========================================
+ */
+
+#include "txn_index.h"
+#include "record_index.h"
+#include "txn_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define LOG_RECORD_SIZE sizeof(struct Transaction)
+#define INDEX_ENTRY_SIZE sizeof(struct TransactionIndexEntry)
+#define SCAN_BATCH 4096
+
+// account_id -> newest record number (shared, created before fork)
+static struct RecordIndex* g_txn_heads = NULL;
+
+// Per-thread descriptor for transactions.idx
+static __thread int g_index_fd = -1;
+
+/**
+ * @brief Opens transactions.idx for this process on first use.
+ */
+static int open_index_file(void) {
+    if (g_index_fd == -1) {
+        g_index_fd = open(TRANSACTION_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+    }
+    return g_index_fd;
+}
+
+/**
+ * @brief Loads every chain head from the first `entries` index entries.
+ */
+static int load_heads(int index_fd, long entries) {
+    struct TransactionIndexEntry* batch = malloc(SCAN_BATCH * INDEX_ENTRY_SIZE);
+    if (batch == NULL) return -1;
+
+    long record = 0;
+    while (record < entries) {
+        long want = (entries - record < SCAN_BATCH) ? entries - record : SCAN_BATCH;
+        ssize_t n = pread(index_fd, batch, want * INDEX_ENTRY_SIZE, record * INDEX_ENTRY_SIZE);
+        if (n != (ssize_t)(want * INDEX_ENTRY_SIZE)) { free(batch); return -1; }
+        for (long i = 0; i < want; i++) {
+            record_index_set(g_txn_heads, batch[i].account_id, (int)(record + i));
+        }
+        record += want;
+    }
+    free(batch);
+    return 0;
+}
+
+/**
+ * @brief Indexes log records [from, to) that have no index entry yet
+ * (first run on an existing log, or a crash between the two writes).
+ */
+static int index_missing_records(int index_fd, long from, long to) {
+    struct Transaction* batch = malloc(SCAN_BATCH * LOG_RECORD_SIZE);
+    if (batch == NULL) return -1;
+
+    long record = from;
+    while (record < to) {
+        long want = (to - record < SCAN_BATCH) ? to - record : SCAN_BATCH;
+        if (txn_log_read(record, batch, (int)want) != want) { free(batch); return -1; }
+        for (long i = 0; i < want; i++) {
+            struct TransactionIndexEntry entry;
+            entry.account_id = batch[i].account_id;
+            entry.prev_record = record_index_lookup(g_txn_heads, entry.account_id);
+            pwrite(index_fd, &entry, INDEX_ENTRY_SIZE, (record + i) * INDEX_ENTRY_SIZE);
+            record_index_set(g_txn_heads, entry.account_id, (int)(record + i));
+        }
+        record += want;
+    }
+    free(batch);
+    return 0;
+}
+
+/**
+ * @brief Creates the shared chain heads and brings transactions.idx in
+ * line with the log. Must run in the parent before fork(), after
+ * txn_log_init() (which repairs a torn log tail).
+ */
+int txn_index_init(void) {
+    g_txn_heads = record_index_create(ACCOUNT_INDEX_CAPACITY);
+    if (g_txn_heads == NULL) return -1;
+
+    int index_fd = open(TRANSACTION_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+    if (index_fd == -1) {
+        perror("txn_index: open failed");
+        g_txn_heads = NULL;
+        return -1;
+    }
+
+    struct stat index_st;
+    fstat(index_fd, &index_st);
+    long log_records = txn_log_record_count();
+    long index_entries = index_st.st_size / INDEX_ENTRY_SIZE;
+
+    if (index_entries > log_records) index_entries = log_records;
+    ftruncate(index_fd, index_entries * INDEX_ENTRY_SIZE);
+
+    int rc = load_heads(index_fd, index_entries);
+    if (rc == 0 && index_entries < log_records) {
+        rc = index_missing_records(index_fd, index_entries, log_records);
+    }
+
+    close(index_fd);
+    if (rc == -1) {
+        fprintf(stderr, "txn_index: build failed, history views will scan the log.\n");
+        g_txn_heads = NULL;
+    }
+    return rc;
+}
+
+/**
+ * @brief Links a freshly appended log record into its account's chain.
+ */
+int txn_index_append(int record_number, int account_id) {
+    if (g_txn_heads == NULL || open_index_file() == -1) return -1;
+
+    struct TransactionIndexEntry entry;
+    entry.account_id = account_id;
+    entry.prev_record = record_index_lookup(g_txn_heads, account_id);
+
+    if (pwrite(g_index_fd, &entry, INDEX_ENTRY_SIZE, (off_t)record_number * INDEX_ENTRY_SIZE) != (ssize_t)INDEX_ENTRY_SIZE) {
+        return -1;
+    }
+    // Publish only after the entry is on file
+    return record_index_set(g_txn_heads, account_id, record_number);
+}
+
+/**
+ * @brief Journal commit hook: links a batch of consecutive log records
+ * with a single index write, then publishes the new chain heads.
+ * A small open-addressing table remembers each account's latest record
+ * within the batch, so large batches (bulk loads) stay linear.
+ */
+void txn_index_commit_batch(long first_record, const void* records, int count) {
+    if (g_txn_heads == NULL || open_index_file() == -1) return;
+
+    int slots = 1;
+    while (slots < 2 * count) slots <<= 1;
+    const struct Transaction* batch = records;
+    struct TransactionIndexEntry* entries = malloc((size_t)count * INDEX_ENTRY_SIZE);
+    int* latest = malloc((size_t)slots * sizeof(int)); // Batch position + 1, 0 if empty
+    if (entries == NULL || latest == NULL) { free(entries); free(latest); return; }
+    memset(latest, 0, (size_t)slots * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        int account_id = batch[i].account_id;
+        unsigned int slot = ((unsigned int)account_id * 2654435761u) & (unsigned int)(slots - 1);
+        while (latest[slot] != 0 && batch[latest[slot] - 1].account_id != account_id) {
+            slot = (slot + 1) & (unsigned int)(slots - 1);
+        }
+        entries[i].account_id = account_id;
+        // An earlier record in the same batch is newer than the published head
+        entries[i].prev_record = (latest[slot] != 0) ? (int)(first_record + latest[slot] - 1)
+                                                     : record_index_lookup(g_txn_heads, account_id);
+        latest[slot] = i + 1;
+    }
+
+    size_t bytes = (size_t)count * INDEX_ENTRY_SIZE;
+    if (pwrite(g_index_fd, entries, bytes, (off_t)first_record * INDEX_ENTRY_SIZE) == (ssize_t)bytes) {
+        for (int i = 0; i < count; i++) {
+            record_index_set(g_txn_heads, entries[i].account_id, (int)(first_record + i));
+        }
+    }
+    free(latest);
+    free(entries);
+}
+
+/**
+ * @brief Visits an account's transactions newest first, reading only
+ * that account's records.
+ * @return Number of records visited, or -1 if the index is unavailable
+ * and the caller must scan the log instead.
+ */
+int txn_index_walk(int account_id, int max_entries, txn_visit_fn visit, void* ctx) {
+    if (g_txn_heads == NULL || record_index_is_degraded(g_txn_heads)) return -1;
+    if (open_index_file() == -1) return -1;
+
+    int record = record_index_lookup(g_txn_heads, account_id);
+    if (record == -1) return 0;
+
+    int visited = 0;
+    while (record != -1 && (max_entries <= 0 || visited < max_entries)) {
+        struct Transaction entry;
+        struct TransactionIndexEntry link;
+        if (txn_log_read(record, &entry, 1) != 1) break;
+        if (pread(g_index_fd, &link, INDEX_ENTRY_SIZE, (off_t)record * INDEX_ENTRY_SIZE) != (ssize_t)INDEX_ENTRY_SIZE) break;
+
+        visited++;
+        if (visit(&entry, ctx)) break;
+        if (link.prev_record >= record) break; // Chains only point backwards
+        record = link.prev_record;
+    }
+
+    return visited;
+}
@@ -0,0 +1,28 @@
+/*
+ * ========================================
+ * txn_index.h
+ * =Description: Per-account index over the
+ * transaction log. Each account's records form a
+ * newest -> oldest chain stored in the sidecar file
+ * transactions.idx; the chain heads live in shared
+ * memory so history queries never scan the log.
+ * ========================================
+ */
+
+#ifndef TXN_INDEX_H
+#define TXN_INDEX_H
+
+#include "bank_storage.h"
+#include "txn_log.h" // txn_visit_fn
+
+// --- Index Lifecycle ---
+int txn_index_init(void);
+
+// --- Maintenance (caller holds the transaction log write lock) ---
+int txn_index_append(int record_number, int account_id);
+void txn_index_commit_batch(long first_record, const void* records, int count);
+
+// --- Queries ---
+int txn_index_walk(int account_id, int max_entries, txn_visit_fn visit, void* ctx);
+
+#endif // TXN_INDEX_H
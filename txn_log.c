@@ -0,0 +1,704 @@
+/*
+ * ========================================
+ * txn_log.c
+ * =Description: Implementation of the segmented
+ * transaction log.
+ *
+ * Writer protocol (tail segment only):
+ * 1. Widen the shared tail header's account range
+ * 2. pwrite the records, then the header
+ * 3. Fold the records into the time index, then
+ *    publish the new record count (release store)
+ * 4. If the segment is now full, seal it: mark the
+ *    header sealed, fsync, and start a new segment
+ *    on the next write
+ * Readers only look at records below the published
+ * count. Sealed segments never change again, so their
+ * headers are cached per process and used to skip
+ * segments that cannot hold an account.
+ * ========================================
+ */
+
+#include "txn_log.h"
+#include "txn_time_index.h"
+#include "uring.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define RECORD_SIZE sizeof(struct Transaction)
+#define HEADER_SIZE sizeof(struct TxnSegmentHeader)
+#define SCAN_BATCH 1024
+
+// Shared state, created by the parent before fork
+struct TxnLogShared {
+    pthread_mutex_t tail_lock;      // Serializes appends made without the journal
+    long record_count;              // Records on file; published after each write
+    struct TxnSegmentHeader active; // Tail segment header (magic 0: not started yet)
+};
+
+static struct TxnLogShared* g_log = NULL;
+
+// Per-thread read handle for one segment
+struct SegmentHandle {
+    int fd;
+    int sealed;                     // header is cached and final
+    struct TxnSegmentHeader header;
+};
+
+static __thread struct SegmentHandle* g_segments = NULL;
+static __thread int g_segment_slots = 0;
+
+// Per-thread write handle on the tail segment
+static __thread int g_write_fd = -1;
+static __thread int g_write_segment = -1;
+
+// --- Segment Helpers ---
+
+static void segment_path(const char* dir, int segment, char* path, size_t len) {
+    snprintf(path, len, "%s/seg_%06d.dat", dir, segment);
+}
+
+static off_t record_offset(long record) {
+    return HEADER_SIZE + (off_t)(record % TXN_SEGMENT_RECORDS) * RECORD_SIZE;
+}
+
+static void sync_dir(const char* dir) {
+    int fd = open(dir, O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static void init_header(struct TxnSegmentHeader* header, int segment) {
+    memset(header, 0, sizeof(*header));
+    header->magic = TXN_SEGMENT_MAGIC;
+    header->version = TXN_SEGMENT_VERSION;
+    header->segment = segment;
+    header->first_record = (long long)segment * TXN_SEGMENT_RECORDS;
+    header->min_account_id = INT_MAX;
+    header->max_account_id = INT_MIN;
+}
+
+/**
+ * @brief Widens a header's account range (and time range, if now != 0)
+ * to cover `count` records.
+ */
+static void header_cover(struct TxnSegmentHeader* header, const struct Transaction* records, int count, long long now) {
+    for (int i = 0; i < count; i++) {
+        if (records[i].account_id < header->min_account_id) header->min_account_id = records[i].account_id;
+        if (records[i].account_id > header->max_account_id) header->max_account_id = records[i].account_id;
+    }
+    if (now != 0) {
+        if (header->record_count == 0) header->first_time = now;
+        header->last_time = now;
+    }
+}
+
+/**
+ * @brief Recomputes a segment header from the records actually on file
+ * and drops a torn trailing record (after a crash or a truncation).
+ * @return Number of records in the segment, or -1 on error.
+ */
+static long rebuild_header(int fd, int segment, struct TxnSegmentHeader* header) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) return -1;
+
+    struct TxnSegmentHeader old;
+    int have_old = pread(fd, &old, HEADER_SIZE, 0) == (ssize_t)HEADER_SIZE && old.magic == TXN_SEGMENT_MAGIC;
+    long records = (st.st_size > (off_t)HEADER_SIZE) ? (long)((st.st_size - HEADER_SIZE) / RECORD_SIZE) : 0;
+    if (records > TXN_SEGMENT_RECORDS) records = TXN_SEGMENT_RECORDS;
+
+    // A valid header that matches the file size needs no scan
+    if (have_old && old.record_count == records && st.st_size == (off_t)(HEADER_SIZE + records * RECORD_SIZE)) {
+        *header = old;
+        return records;
+    }
+
+    init_header(header, segment);
+    struct Transaction* batch = malloc(SCAN_BATCH * RECORD_SIZE);
+    if (batch == NULL) return -1;
+    for (long done = 0; done < records; ) {
+        long want = (records - done < SCAN_BATCH) ? records - done : SCAN_BATCH;
+        if (pread(fd, batch, want * RECORD_SIZE, HEADER_SIZE + done * RECORD_SIZE) != (ssize_t)(want * RECORD_SIZE)) {
+            free(batch);
+            return -1;
+        }
+        header_cover(header, batch, (int)want, 0);
+        done += want;
+    }
+    free(batch);
+
+    header->record_count = (int)records;
+    if (have_old) {
+        header->first_time = old.first_time;
+        header->last_time = old.last_time;
+    } else if (records > 0) {
+        header->last_time = st.st_mtime;
+    }
+    ftruncate(fd, HEADER_SIZE + records * RECORD_SIZE);
+    if (pwrite(fd, header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE) return -1;
+    return records;
+}
+
+/**
+ * @brief Finalizes a full segment. It is never written again.
+ */
+static int seal_segment(int fd, struct TxnSegmentHeader* header) {
+    header->sealed = 1;
+    if (pwrite(fd, header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE) return -1;
+    return fsync(fd);
+}
+
+/**
+ * @brief Drops every cached descriptor (segments were rewritten).
+ */
+static void close_handles(void) {
+    for (int i = 0; i < g_segment_slots; i++) {
+        if (g_segments[i].fd != -1) close(g_segments[i].fd);
+    }
+    free(g_segments);
+    g_segments = NULL;
+    g_segment_slots = 0;
+    if (g_write_fd != -1) close(g_write_fd);
+    g_write_fd = -1;
+    g_write_segment = -1;
+}
+
+// --- Format v1 Conversion ---
+
+#define V1_RECORD_SIZE sizeof(struct TransactionV1)
+
+/**
+ * @brief Converts one v1 record. The operation and amount are parsed back
+ * out of the description; timestamps that do not parse (v1 wrote
+ * "%Y-m-d", dropping month and day) get `fallback_time` (seconds).
+ */
+void txn_log_convert_v1(const struct TransactionV1* old, struct Transaction* entry, long long fallback_time) {
+    memset(entry, 0, sizeof(*entry));
+    entry->account_id = old->account_id;
+    entry->counterparty_id = -1;
+    entry->resulting_balance = money_to_cents(old->resulting_balance);
+
+    char name[32];
+    double amount;
+    if (sscanf(old->description, "%31[^:]: %lf", name, &amount) == 2) {
+        for (int op = TXN_OP_DEPOSIT; op <= TXN_OP_LOAN_APPROVED; op++) {
+            if (strcmp(name, transaction_op_name(op)) == 0) entry->op = op;
+        }
+        entry->amount = money_to_cents(amount);
+    }
+
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    long long seconds = fallback_time;
+    if (sscanf(old->timestamp, "%d-%d-%d %d:%d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+               &local.tm_hour, &local.tm_min, &local.tm_sec) == 6) {
+        local.tm_year -= 1900;
+        local.tm_mon -= 1;
+        local.tm_isdst = -1;
+        time_t parsed = mktime(&local);
+        if (parsed != (time_t)-1) seconds = parsed;
+    }
+    entry->timestamp_us = seconds * 1000000;
+}
+
+/**
+ * @brief Streams `count` v1 records from `in_fd` (starting at byte
+ * `in_offset`) into segment `fd` as v2 records, widening `header`.
+ * @return 0 on success, -1 on I/O failure.
+ */
+static int convert_v1_records(int in_fd, off_t in_offset, int fd, long first_record, long count,
+                              struct TxnSegmentHeader* header, long long fallback_time) {
+    struct TransactionV1* old = malloc(SCAN_BATCH * V1_RECORD_SIZE);
+    struct Transaction* batch = malloc(SCAN_BATCH * RECORD_SIZE);
+    int ok = (old != NULL && batch != NULL);
+
+    for (long done = 0; ok && done < count; ) {
+        long want = (count - done < SCAN_BATCH) ? count - done : SCAN_BATCH;
+        ok = pread(in_fd, old, want * V1_RECORD_SIZE, in_offset + done * V1_RECORD_SIZE) == (ssize_t)(want * V1_RECORD_SIZE);
+        for (long i = 0; ok && i < want; i++) {
+            txn_log_convert_v1(&old[i], &batch[i], fallback_time);
+            long long seconds = batch[i].timestamp_us / 1000000;
+            if (header->record_count == 0 || seconds < header->first_time) header->first_time = seconds;
+            if (seconds > header->last_time) header->last_time = seconds;
+            header->record_count++;
+        }
+        if (ok) {
+            header_cover(header, batch, (int)want, 0);
+            ok = pwrite(fd, batch, want * RECORD_SIZE, record_offset(first_record + done)) == (ssize_t)(want * RECORD_SIZE);
+        }
+        done += want;
+    }
+    free(old);
+    free(batch);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Writes a converted segment's header and makes it durable.
+ */
+static int finish_segment(int fd, struct TxnSegmentHeader* header) {
+    if (header->record_count == TXN_SEGMENT_RECORDS) return seal_segment(fd, header);
+    if (pwrite(fd, header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE) return -1;
+    return fsync(fd);
+}
+
+/**
+ * @brief Splits a legacy transactions.dat (v1 records) into v2 segments.
+ * The segments are built in a temporary directory that is renamed into
+ * place, so a crash leaves either the old file or a complete segmented log.
+ * @return Records converted, or -1 on error.
+ */
+static long migrate_legacy_log(void) {
+    struct stat st;
+    int have_dir = (stat(TRANSACTION_LOG_DIR, &st) == 0);
+
+    int legacy_fd = open(TRANSACTION_DB_FILE, O_RDONLY);
+    if (legacy_fd == -1) {
+        if (!have_dir && mkdir(TRANSACTION_LOG_DIR, 0755) == -1) return -1;
+        return 0;
+    }
+    if (have_dir) {
+        // Crashed after the segments were published: just retire the old file
+        close(legacy_fd);
+        return rename(TRANSACTION_DB_FILE, TRANSACTION_DB_FILE ".migrated");
+    }
+
+    const char* temp_dir = TRANSACTION_LOG_DIR ".tmp";
+    if (mkdir(temp_dir, 0755) == -1 && errno != EEXIST) {
+        close(legacy_fd);
+        return -1;
+    }
+
+    fstat(legacy_fd, &st);
+    long total = (long)(st.st_size / V1_RECORD_SIZE);
+    int ok = 1;
+    for (long record = 0; ok && record < total; ) {
+        int segment = (int)(record / TXN_SEGMENT_RECORDS);
+        long segment_end = (long)(segment + 1) * TXN_SEGMENT_RECORDS;
+        if (segment_end > total) segment_end = total;
+
+        char path[128];
+        segment_path(temp_dir, segment, path, sizeof(path));
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) { ok = 0; break; }
+
+        struct TxnSegmentHeader header;
+        init_header(&header, segment);
+        ok = convert_v1_records(legacy_fd, (off_t)record * V1_RECORD_SIZE, fd, record, segment_end - record,
+                                &header, st.st_mtime) == 0 &&
+             finish_segment(fd, &header) == 0;
+        record = segment_end;
+        close(fd);
+    }
+    close(legacy_fd);
+
+    if (!ok) {
+        fprintf(stderr, "txn_log: migrating %s failed, keeping it\n", TRANSACTION_DB_FILE);
+        return -1;
+    }
+    sync_dir(temp_dir);
+    if (rename(temp_dir, TRANSACTION_LOG_DIR) == -1) return -1;
+    sync_dir(".");
+    printf("Migrated %ld transaction records from %s into %s/\n", total, TRANSACTION_DB_FILE, TRANSACTION_LOG_DIR);
+    if (rename(TRANSACTION_DB_FILE, TRANSACTION_DB_FILE ".migrated") == -1) return -1;
+    return total;
+}
+
+/**
+ * @brief Rewrites one version-1 segment as version 2. The new file is
+ * built next to it and renamed over it, so a crash leaves one complete
+ * version. Record numbers do not change (transactions.idx stays valid).
+ * @return Records converted (0 if already v2), or -1 on error.
+ */
+static long upgrade_segment(int segment) {
+    char path[128], temp_path[160];
+    segment_path(TRANSACTION_LOG_DIR, segment, path, sizeof(path));
+    int in_fd = open(path, O_RDONLY);
+    if (in_fd == -1) return -1;
+
+    struct stat st;
+    struct TxnSegmentHeader old;
+    if (fstat(in_fd, &st) == -1 || pread(in_fd, &old, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE ||
+        old.magic != TXN_SEGMENT_MAGIC || old.version != 1) {
+        close(in_fd);
+        return 0;
+    }
+
+    long records = (st.st_size > (off_t)HEADER_SIZE) ? (long)((st.st_size - HEADER_SIZE) / V1_RECORD_SIZE) : 0;
+    if (records > TXN_SEGMENT_RECORDS) records = TXN_SEGMENT_RECORDS;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        close(in_fd);
+        return -1;
+    }
+
+    struct TxnSegmentHeader header;
+    init_header(&header, segment);
+    long long fallback_time = old.last_time ? old.last_time : st.st_mtime;
+    int ok = convert_v1_records(in_fd, HEADER_SIZE, fd, header.first_record, records, &header, fallback_time) == 0 &&
+             finish_segment(fd, &header) == 0;
+    close(fd);
+    close(in_fd);
+    if (!ok || rename(temp_path, path) == -1) {
+        unlink(temp_path);
+        return -1;
+    }
+    return records;
+}
+
+/**
+ * @brief Converts a legacy transactions.dat and any version-1 segments
+ * to the v2 record format. Safe to rerun after a crash; called by
+ * txn_log_init() and by the offline `bank_tool convert-log`.
+ * @return Records converted, or -1 on error.
+ */
+long txn_log_upgrade(void) {
+    long converted = migrate_legacy_log();
+    if (converted == -1) return -1;
+
+    char path[128];
+    struct stat st;
+    for (int segment = 0; ; segment++) {
+        segment_path(TRANSACTION_LOG_DIR, segment, path, sizeof(path));
+        if (stat(path, &st) == -1) break;
+        long records = upgrade_segment(segment);
+        if (records == -1) {
+            fprintf(stderr, "txn_log: converting %s to format v2 failed\n", path);
+            return -1;
+        }
+        converted += records;
+    }
+    sync_dir(TRANSACTION_LOG_DIR);
+    if (converted > 0) unlink(TRANSACTION_TIME_INDEX_FILE); // Rebuilt from the new records
+    return converted;
+}
+
+// --- Log Lifecycle ---
+
+/**
+ * @brief Creates the shared tail state, upgrades older log formats
+ * and repairs the tail segment. Must run in the parent before fork().
+ */
+int txn_log_init(void) {
+    g_log = create_shared_region(sizeof(struct TxnLogShared));
+    if (g_log == NULL) return -1;
+    init_shared_mutex(&g_log->tail_lock);
+
+    if (txn_log_upgrade() == -1) {
+        perror("txn_log: cannot prepare " TRANSACTION_LOG_DIR);
+        g_log = NULL;
+        return -1;
+    }
+
+    char path[128];
+    struct stat st;
+    int segments = 0;
+    for (;;) {
+        segment_path(TRANSACTION_LOG_DIR, segments, path, sizeof(path));
+        if (stat(path, &st) == -1) break;
+        segments++;
+    }
+    if (segments == 0) return 0;
+
+    int last = segments - 1;
+    segment_path(TRANSACTION_LOG_DIR, last, path, sizeof(path));
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        g_log = NULL;
+        return -1;
+    }
+
+    struct TxnSegmentHeader header;
+    long records = rebuild_header(fd, last, &header);
+    int rc = 0;
+    if (records == -1) {
+        rc = -1;
+    } else if (records == TXN_SEGMENT_RECORDS) {
+        if (!header.sealed) rc = seal_segment(fd, &header);
+        g_log->record_count = (long)(last + 1) * TXN_SEGMENT_RECORDS;
+    } else {
+        g_log->active = header;
+        g_log->record_count = (long)last * TXN_SEGMENT_RECORDS + records;
+    }
+    close(fd);
+    if (rc == -1) g_log = NULL;
+    return rc;
+}
+
+/**
+ * @brief Cuts the log back to `record_count` records (WAL recovery).
+ * Later segments are deleted and the new tail is unsealed.
+ */
+int txn_log_truncate(long record_count) {
+    if (g_log == NULL) return -1;
+    close_handles();
+
+    int keep = (int)(record_count / TXN_SEGMENT_RECORDS);
+    long slot = record_count % TXN_SEGMENT_RECORDS;
+    char path[128];
+    for (int segment = keep + 1; ; segment++) {
+        segment_path(TRANSACTION_LOG_DIR, segment, path, sizeof(path));
+        if (unlink(path) == -1) break;
+    }
+
+    memset(&g_log->active, 0, sizeof(g_log->active));
+    segment_path(TRANSACTION_LOG_DIR, keep, path, sizeof(path));
+    int fd = open(path, O_RDWR);
+    int rc = 0;
+    if (fd != -1) {
+        struct TxnSegmentHeader header;
+        ftruncate(fd, HEADER_SIZE + slot * RECORD_SIZE);
+        if (rebuild_header(fd, keep, &header) == -1) rc = -1;
+        header.sealed = 0;
+        if (pwrite(fd, &header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE || fsync(fd) == -1) rc = -1;
+        g_log->active = header;
+        close(fd);
+    }
+    sync_dir(TRANSACTION_LOG_DIR);
+    __atomic_store_n(&g_log->record_count, record_count, __ATOMIC_RELEASE);
+    if (txn_time_index_truncate(record_count) == -1) rc = -1;
+    return rc;
+}
+
+// --- Writing ---
+
+/**
+ * @brief Opens the tail segment for writing, creating it on first use.
+ */
+static int open_tail_segment(int segment) {
+    if (g_write_segment == segment && g_write_fd != -1) return 0;
+    if (g_write_fd != -1) close(g_write_fd);
+    g_write_fd = -1;
+    g_write_segment = -1;
+
+    char path[128];
+    segment_path(TRANSACTION_LOG_DIR, segment, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return -1;
+
+    if (g_log->active.magic == 0 || g_log->active.segment != segment) {
+        init_header(&g_log->active, segment);
+        if (ftruncate(fd, 0) == -1 || pwrite(fd, &g_log->active, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE) {
+            close(fd);
+            return -1;
+        }
+        sync_dir(TRANSACTION_LOG_DIR); // The new file name must survive a crash
+    }
+    g_write_fd = fd;
+    g_write_segment = segment;
+    return 0;
+}
+
+/**
+ * @brief Writes `count` records starting at global record first_record,
+ * rolling over to new segments as they fill. Also the journal's write
+ * hook, so a batch is one io_uring submission (or two pwrites) per
+ * segment touched.
+ * @return 0 on success, -1 on failure.
+ */
+int txn_log_write(long first_record, const void* records, int count, int sync) {
+    if (g_log == NULL) return -1;
+    const struct Transaction* entries = records;
+    long long now = time(NULL);
+
+    while (count > 0) {
+        int segment = (int)(first_record / TXN_SEGMENT_RECORDS);
+        int slot = (int)(first_record % TXN_SEGMENT_RECORDS);
+        int n = (count < TXN_SEGMENT_RECORDS - slot) ? count : TXN_SEGMENT_RECORDS - slot;
+        struct TxnSegmentHeader* header = &g_log->active;
+
+        long published = __atomic_load_n(&g_log->record_count, __ATOMIC_ACQUIRE);
+        if (segment < published / TXN_SEGMENT_RECORDS && !(header->magic != 0 && header->segment == segment)) {
+            // Already sealed (a journal leader died after finishing it): nothing to redo
+            txn_time_index_cover(first_record, entries, n);
+            first_record += n; entries += n; count -= n;
+            continue;
+        }
+        if (open_tail_segment(segment) == -1) return -1;
+
+        // Widen the range first so lock-free scans never skip the new records
+        header_cover(header, entries, n, now);
+        if (slot + n > header->record_count) header->record_count = slot + n;
+        int filled = (slot + n == TXN_SEGMENT_RECORDS);
+
+        // Records, header and (unless the segment is about to be sealed) the
+        // fdatasync go to the kernel as one linked submission
+        struct UringOp ops[3] = {
+            {URING_WRITE, g_write_fd, (void*)entries, (size_t)n * RECORD_SIZE, record_offset(first_record), 1, 0},
+            {URING_WRITE, g_write_fd, header, HEADER_SIZE, 0, 1, 0},
+            {URING_FDATASYNC, g_write_fd, NULL, 0, 0, 0, 0},
+        };
+        if (uring_run(ops, (sync && !filled) ? 3 : 2) == -1) return -1;
+        txn_time_index_cover(first_record, entries, n);
+
+        first_record += n; entries += n; count -= n;
+        if (first_record > published) __atomic_store_n(&g_log->record_count, first_record, __ATOMIC_RELEASE);
+
+        if (filled) {
+            if (seal_segment(g_write_fd, header) == -1) return -1;
+            close(g_write_fd);
+            g_write_fd = -1;
+            g_write_segment = -1;
+            header->magic = 0; // The next write starts a new segment
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Takes the tail lock for an append made without the journal.
+ */
+int txn_log_lock_tail(void) {
+    return (g_log == NULL) ? -1 : lock_shared_mutex(&g_log->tail_lock);
+}
+
+void txn_log_unlock_tail(void) {
+    pthread_mutex_unlock(&g_log->tail_lock);
+}
+
+/**
+ * @brief fsyncs the tail segment. Sealed segments were synced when sealed.
+ */
+int txn_log_sync(void) {
+    if (g_log == NULL) return -1;
+    char path[128];
+    segment_path(TRANSACTION_LOG_DIR, (int)(txn_log_record_count() / TXN_SEGMENT_RECORDS), path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return (errno == ENOENT) ? 0 : -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+// --- Reading ---
+
+/**
+ * @brief Returns the number of records readers may look at.
+ */
+long txn_log_record_count(void) {
+    return (g_log == NULL) ? 0 : __atomic_load_n(&g_log->record_count, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Returns this process's read handle for a segment, opening it lazily.
+ */
+static struct SegmentHandle* segment_handle(int segment) {
+    if (segment >= g_segment_slots) {
+        int slots = g_segment_slots ? g_segment_slots : 16;
+        while (slots <= segment) slots *= 2;
+        struct SegmentHandle* grown = realloc(g_segments, slots * sizeof(*grown));
+        if (grown == NULL) return NULL;
+        for (int i = g_segment_slots; i < slots; i++) {
+            grown[i].fd = -1;
+            grown[i].sealed = 0;
+        }
+        g_segments = grown;
+        g_segment_slots = slots;
+    }
+
+    struct SegmentHandle* handle = &g_segments[segment];
+    if (handle->fd == -1) {
+        char path[128];
+        segment_path(TRANSACTION_LOG_DIR, segment, path, sizeof(path));
+        handle->fd = open(path, O_RDONLY);
+        if (handle->fd == -1) return NULL;
+    }
+    return handle;
+}
+
+/**
+ * @brief Reads up to `count` consecutive records.
+ * @return Number of records read.
+ */
+int txn_log_read(long first_record, struct Transaction* entries, int count) {
+    int done = 0;
+    while (done < count) {
+        long record = first_record + done;
+        int slot = (int)(record % TXN_SEGMENT_RECORDS);
+        int want = (count - done < TXN_SEGMENT_RECORDS - slot) ? count - done : TXN_SEGMENT_RECORDS - slot;
+
+        struct SegmentHandle* handle = segment_handle((int)(record / TXN_SEGMENT_RECORDS));
+        if (handle == NULL) break;
+        ssize_t got = pread(handle->fd, entries + done, (size_t)want * RECORD_SIZE, record_offset(record));
+        if (got <= 0) break;
+        done += (int)(got / RECORD_SIZE);
+        if (got < (ssize_t)(want * RECORD_SIZE)) break;
+    }
+    return done;
+}
+
+/**
+ * @brief Returns 0 only if a sealed segment's header rules out account_id.
+ */
+static int segment_may_contain(int segment, int account_id) {
+    struct SegmentHandle* handle = segment_handle(segment);
+    if (handle == NULL) return 1;
+
+    if (!handle->sealed) {
+        struct TxnSegmentHeader header;
+        if (pread(handle->fd, &header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE ||
+            header.magic != TXN_SEGMENT_MAGIC || !header.sealed) {
+            return 1; // Tail segment: its header may still be moving
+        }
+        handle->header = header; // Immutable from now on
+        handle->sealed = 1;
+    }
+    return handle->header.record_count > 0 &&
+           account_id >= handle->header.min_account_id && account_id <= handle->header.max_account_id;
+}
+
+/**
+ * @brief Visits an account's records oldest first, skipping sealed
+ * segments whose account range excludes it. Takes no locks.
+ * @return Number of records visited, or -1 on a read error.
+ */
+int txn_log_scan(int account_id, txn_visit_fn visit, void* ctx) {
+    long total = txn_log_record_count();
+    struct Transaction* batch = malloc(SCAN_BATCH * RECORD_SIZE);
+    if (batch == NULL) return -1;
+
+    int visited = 0;
+    long record = 0;
+    while (record < total) {
+        int segment = (int)(record / TXN_SEGMENT_RECORDS);
+        long segment_end = (long)(segment + 1) * TXN_SEGMENT_RECORDS;
+        if (segment_end > total) segment_end = total;
+
+        if (!segment_may_contain(segment, account_id)) {
+            record = segment_end;
+            continue;
+        }
+        while (record < segment_end) {
+            int want = (segment_end - record < SCAN_BATCH) ? (int)(segment_end - record) : SCAN_BATCH;
+            int got = txn_log_read(record, batch, want);
+            if (got <= 0) {
+                free(batch);
+                return -1;
+            }
+            for (int i = 0; i < got; i++) {
+                if (batch[i].account_id != account_id) continue;
+                visited++;
+                if (visit(&batch[i], ctx)) goto done;
+            }
+            record += got;
+        }
+    }
+
+done:
+    free(batch);
+    return visited;
+}
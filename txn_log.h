@@ -0,0 +1,47 @@
+/*
+ * ========================================
+ * txn_log.h
+ * =Description: Segmented, rolling transaction log.
+ * - Records keep one global record number; record N
+ *   lives in segment N / TXN_SEGMENT_RECORDS
+ * - Only the tail segment is ever written; a full
+ *   segment is sealed (header finalized, fsynced,
+ *   made read-only) and read without any lock
+ * - Segment headers carry the record count, account
+ *   range and time range so scans can skip segments
+ * ========================================
+ */
+
+#ifndef TXN_LOG_H
+#define TXN_LOG_H
+
+#include "bank_storage.h"
+
+// --- Segment Layout ---
+#ifndef TXN_SEGMENT_RECORDS
+#define TXN_SEGMENT_RECORDS 65536 // Records per segment (~2.5 MB)
+#endif
+#define TXN_SEGMENT_MAGIC 0x47455354u // "TSEG"
+#define TXN_SEGMENT_VERSION 2 // 40-byte records (v1: 144-byte text records)
+
+// Visitor for log scans and index walks; return non-zero to stop early
+typedef int (*txn_visit_fn)(const struct Transaction* entry, void* ctx);
+
+// --- Log Lifecycle (parent, before fork) ---
+int txn_log_init(void);
+int txn_log_truncate(long record_count);
+long txn_log_upgrade(void);
+void txn_log_convert_v1(const struct TransactionV1* old, struct Transaction* entry, long long fallback_time);
+
+// --- Writing (one writer at a time: the journal leader, or the tail lock holder) ---
+int txn_log_write(long first_record, const void* records, int count, int sync);
+int txn_log_lock_tail(void);
+void txn_log_unlock_tail(void);
+int txn_log_sync(void);
+
+// --- Reading (lock-free) ---
+long txn_log_record_count(void);
+int txn_log_read(long first_record, struct Transaction* entries, int count);
+int txn_log_scan(int account_id, txn_visit_fn visit, void* ctx);
+
+#endif // TXN_LOG_H
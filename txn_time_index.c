@@ -0,0 +1,290 @@
+/*
+ * ========================================
+ * txn_time_index.c
+ * =Description: Implementation of the sparse time
+ * index over the transaction log.
+ *
+ * Log order is close to time order, not equal to it
+ * (sessions commit concurrently, clocks step), so an
+ * entry keeps two bounds that only ever grow from one
+ * block to the next:
+ * - ceiling: the latest timestamp up to this block
+ * - floor: the earliest timestamp from this block on
+ * A query for [from, to] starts at the first block with
+ * ceiling >= from and ends at the last block with
+ * floor <= to; no matching record lies outside.
+ *
+ * The log writer folds each record into the block
+ * being filled (shared memory) before publishing it.
+ * A full block is appended to transactions.tidx. A
+ * record older than an earlier block's floor lowers
+ * that floor on file, which in practice touches the
+ * previous block at most.
+ * ========================================
+ */
+
+#include "txn_time_index.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define ENTRY_SIZE sizeof(struct TransactionTimeEntry)
+#define SCAN_BATCH 4096
+
+// Shared state, created by the parent before fork
+struct TimeIndexShared {
+    long indexed;                     // Log records folded in so far
+    long tail_block;                  // Block being filled
+    struct TransactionTimeEntry tail; // Its bounds so far
+    long long last_floor_us;          // floor_us of the block before it (LLONG_MIN if none)
+    int broken;                       // A write failed or records were skipped: queries scan the log
+};
+
+static struct TimeIndexShared* g_time = NULL;
+
+// Per-thread descriptor for transactions.tidx
+static __thread int g_time_fd = -1;
+
+/**
+ * @brief Opens transactions.tidx for this process on first use.
+ */
+static int open_time_file(void) {
+    if (g_time_fd == -1) {
+        g_time_fd = open(TRANSACTION_TIME_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+    }
+    return g_time_fd;
+}
+
+static int read_entry(long block, struct TransactionTimeEntry* entry) {
+    return pread(g_time_fd, entry, ENTRY_SIZE, (off_t)block * ENTRY_SIZE) == (ssize_t)ENTRY_SIZE ? 0 : -1;
+}
+
+static int write_entry(long block, const struct TransactionTimeEntry* entry) {
+    return pwrite(g_time_fd, entry, ENTRY_SIZE, (off_t)block * ENTRY_SIZE) == (ssize_t)ENTRY_SIZE ? 0 : -1;
+}
+
+// --- Maintenance ---
+
+/**
+ * @brief Lowers the floor of every block before the tail that is still
+ * above `floor_us`. Floors grow along the file, so this stops at the
+ * first block already at or below it.
+ */
+static void lower_earlier_floors(long long floor_us) {
+    for (long block = g_time->tail_block - 1; block >= 0; block--) {
+        struct TransactionTimeEntry entry;
+        if (read_entry(block, &entry) == -1) { g_time->broken = 1; return; }
+        if (entry.floor_us <= floor_us) break;
+        entry.floor_us = floor_us;
+        if (write_entry(block, &entry) == -1) { g_time->broken = 1; return; }
+    }
+    g_time->last_floor_us = floor_us;
+}
+
+/**
+ * @brief Appends the full tail block to the file and starts the next.
+ * The block number moves before the floor is reset, so a reader never
+ * pairs the old block with the new block's bounds.
+ */
+static void finish_block(void) {
+    struct TransactionTimeEntry done = g_time->tail;
+    if (write_entry(g_time->tail_block, &done) == -1) g_time->broken = 1;
+    g_time->last_floor_us = done.floor_us;
+    __atomic_store_n(&g_time->tail_block, g_time->tail_block + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_time->tail.floor_us, LLONG_MAX, __ATOMIC_RELEASE); // The ceiling carries over
+}
+
+/**
+ * @brief Log writer hook: folds `count` freshly written records into the
+ * index. Must run before the records are published, so a reader that
+ * can see a record also sees bounds covering it. Records already folded
+ * in (a batch redone by a new journal leader) are skipped.
+ */
+void txn_time_index_cover(long first_record, const struct Transaction* entries, int count) {
+    if (g_time == NULL || g_time->broken || open_time_file() == -1) return;
+    if (first_record > g_time->indexed) {
+        g_time->broken = 1; // Records missed the index; queries fall back to scanning
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        long record = first_record + i;
+        if (record < g_time->indexed) continue;
+
+        long long timestamp = entries[i].timestamp_us;
+        if (timestamp > g_time->tail.ceiling_us) {
+            __atomic_store_n(&g_time->tail.ceiling_us, timestamp, __ATOMIC_RELAXED);
+        }
+        if (timestamp < g_time->tail.floor_us) {
+            __atomic_store_n(&g_time->tail.floor_us, timestamp, __ATOMIC_RELAXED);
+            if (timestamp < g_time->last_floor_us) lower_earlier_floors(timestamp);
+        }
+        g_time->indexed = record + 1;
+        if (g_time->indexed % TXN_TIME_BLOCK == 0) finish_block();
+    }
+}
+
+// --- Index Lifecycle ---
+
+/**
+ * @brief Cuts the file back to the blocks that are still full after the
+ * log is cut to `record_count` (WAL recovery, import rollback). Their
+ * floors may now be lower than needed, which only widens a query.
+ */
+int txn_time_index_truncate(long record_count) {
+    int fd = open(TRANSACTION_TIME_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return -1;
+    struct stat st;
+    int rc = 0;
+    off_t keep = (off_t)(record_count / TXN_TIME_BLOCK) * ENTRY_SIZE;
+    if (fstat(fd, &st) == -1 || (st.st_size > keep && ftruncate(fd, keep) == -1)) rc = -1;
+    close(fd);
+    return rc;
+}
+
+/**
+ * @brief Creates the shared tail block and brings transactions.tidx in
+ * line with the log: entries past the log's full blocks are dropped, and
+ * records the file does not cover yet are folded in from the log. Must
+ * run in the parent before fork(), after txn_log_init().
+ */
+int txn_time_index_init(void) {
+    g_time = create_shared_region(sizeof(struct TimeIndexShared));
+    if (g_time == NULL) return -1;
+    if (open_time_file() == -1) {
+        perror("txn_time_index: open failed");
+        g_time = NULL;
+        return -1;
+    }
+
+    struct stat st;
+    fstat(g_time_fd, &st);
+    long log_records = txn_log_record_count();
+    long blocks = st.st_size / (off_t)ENTRY_SIZE;
+    if (blocks > log_records / TXN_TIME_BLOCK) blocks = log_records / TXN_TIME_BLOCK;
+    ftruncate(g_time_fd, (off_t)blocks * ENTRY_SIZE);
+
+    struct TransactionTimeEntry last = {LLONG_MIN, LLONG_MIN};
+    if (blocks > 0 && read_entry(blocks - 1, &last) == -1) blocks = 0;
+    g_time->indexed = blocks * TXN_TIME_BLOCK;
+    g_time->tail_block = blocks;
+    g_time->tail.ceiling_us = last.ceiling_us;
+    g_time->tail.floor_us = LLONG_MAX;
+    g_time->last_floor_us = last.floor_us;
+
+    struct Transaction* batch = malloc(SCAN_BATCH * sizeof(struct Transaction));
+    if (batch == NULL) {
+        g_time = NULL;
+        return -1;
+    }
+    for (long record = g_time->indexed; record < log_records && !g_time->broken; ) {
+        int want = (log_records - record < SCAN_BATCH) ? (int)(log_records - record) : SCAN_BATCH;
+        if (txn_log_read(record, batch, want) != want) g_time->broken = 1;
+        else txn_time_index_cover(record, batch, want);
+        record += want;
+    }
+    free(batch);
+
+    if (g_time->broken) {
+        fprintf(stderr, "txn_time_index: build failed, date-range queries will scan the log.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// --- Queries ---
+
+/**
+ * @brief Reads the bounds of a block that holds some of the first
+ * `total` log records: full blocks from the file, the block being filled
+ * from shared memory (or from the file, if it filled up meanwhile).
+ */
+static int block_bounds(long block, long total, struct TransactionTimeEntry* entry) {
+    if (block == total / TXN_TIME_BLOCK) {
+        long before = __atomic_load_n(&g_time->tail_block, __ATOMIC_ACQUIRE);
+        entry->ceiling_us = __atomic_load_n(&g_time->tail.ceiling_us, __ATOMIC_RELAXED);
+        entry->floor_us = __atomic_load_n(&g_time->tail.floor_us, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (before == block && __atomic_load_n(&g_time->tail_block, __ATOMIC_RELAXED) == block) return 0;
+    }
+    return read_entry(block, entry);
+}
+
+/**
+ * @brief Narrows [first, end) to the records that can fall in
+ * [from_us, to_us].
+ * @return 0 on success (first == end if nothing can match), -1 if the
+ * index could not be read.
+ */
+static int find_window(long total, long long from_us, long long to_us, long* first, long* end) {
+    long blocks = (total + TXN_TIME_BLOCK - 1) / TXN_TIME_BLOCK;
+    struct TransactionTimeEntry entry;
+
+    // First block whose ceiling reaches `from`
+    long lo = 0, hi = blocks;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (block_bounds(mid, total, &entry) == -1) return -1;
+        if (entry.ceiling_us >= from_us) hi = mid; else lo = mid + 1;
+    }
+    long first_block = lo;
+
+    // One past the last block whose floor is not after `to`
+    lo = first_block; hi = blocks;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (block_bounds(mid, total, &entry) == -1) return -1;
+        if (entry.floor_us <= to_us) lo = mid + 1; else hi = mid;
+    }
+
+    *first = first_block * TXN_TIME_BLOCK;
+    *end = (lo * TXN_TIME_BLOCK < total) ? lo * TXN_TIME_BLOCK : total;
+    if (*end < *first) *end = *first;
+    return 0;
+}
+
+/**
+ * @brief Visits, in log order, every record of one account (or of
+ * TXN_ALL_ACCOUNTS) timestamped within [from_us, to_us]. Reads only the
+ * blocks the index cannot rule out; without a usable index, the whole
+ * log. Takes no locks.
+ * @return Number of records visited, or -1 on a read error.
+ */
+int txn_time_index_scan(int account_id, long long from_us, long long to_us, txn_visit_fn visit, void* ctx) {
+    long total = txn_log_record_count();
+    long record = 0, end = total;
+    if (g_time != NULL && !g_time->broken && open_time_file() != -1 &&
+        find_window(total, from_us, to_us, &record, &end) == -1) {
+        record = 0;
+        end = total;
+    }
+
+    struct Transaction* batch = malloc(SCAN_BATCH * sizeof(struct Transaction));
+    if (batch == NULL) return -1;
+
+    int visited = 0;
+    while (record < end) {
+        int want = (end - record < SCAN_BATCH) ? (int)(end - record) : SCAN_BATCH;
+        int got = txn_log_read(record, batch, want);
+        if (got <= 0) {
+            free(batch);
+            return -1;
+        }
+        for (int i = 0; i < got; i++) {
+            if (account_id != TXN_ALL_ACCOUNTS && batch[i].account_id != account_id) continue;
+            if (batch[i].timestamp_us < from_us || batch[i].timestamp_us > to_us) continue;
+            visited++;
+            if (visit(&batch[i], ctx)) goto done;
+        }
+        record += got;
+    }
+
+done:
+    free(batch);
+    return visited;
+}
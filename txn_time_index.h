@@ -0,0 +1,36 @@
+/*
+ * ========================================
+ * txn_time_index.h
+ * =Description: Sparse time index over the
+ * transaction log, for date-range queries.
+ * - One entry per TXN_TIME_BLOCK log records, stored
+ *   in transactions.tidx; the block being filled lives
+ *   in shared memory
+ * - A range query binary-searches to the first and
+ *   last block that can hold a match and streams only
+ *   the records in between
+ * - Derived from the log: entries missing after a
+ *   crash are rebuilt from it on startup
+ * ========================================
+ */
+
+#ifndef TXN_TIME_INDEX_H
+#define TXN_TIME_INDEX_H
+
+#include "bank_storage.h"
+#include "txn_log.h" // txn_visit_fn
+
+#define TXN_TIME_BLOCK 1024     // Log records per index entry
+#define TXN_ALL_ACCOUNTS -1     // txn_time_index_scan(): every account
+
+// --- Index Lifecycle (parent, before fork) ---
+int txn_time_index_init(void);
+int txn_time_index_truncate(long record_count);
+
+// --- Maintenance (the log writer, before the records are published) ---
+void txn_time_index_cover(long first_record, const struct Transaction* entries, int count);
+
+// --- Queries ---
+int txn_time_index_scan(int account_id, long long from_us, long long to_us, txn_visit_fn visit, void* ctx);
+
+#endif // TXN_TIME_INDEX_H
@@ -0,0 +1,281 @@
+/*
+ * ========================================
+ * uring.c
+ * =Description: Implementation of batched I/O over
+ * io_uring, driven through raw syscalls.
+ *
+ * A ring is a pair of queues shared with the kernel:
+ * requests (SQEs) go in at the submission queue's tail,
+ * results (CQEs) come out at the completion queue's
+ * head. uring_run() fills one SQE per op, publishes
+ * them all, and makes one io_uring_enter() call that
+ * both submits them and waits for every completion.
+ * Ops marked `link` are chained (IOSQE_IO_LINK): the
+ * next one starts only after it succeeded, and is
+ * cancelled if it failed.
+ *
+ * Rings are per process. The parent only probes that
+ * io_uring works; each child creates its own ring the
+ * first time it runs a batch, since a ring inherited
+ * across fork() would be shared with the parent.
+ * ========================================
+ */
+
+#include "uring.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// Per-process ring
+struct Uring {
+    int fd;
+    pid_t owner;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;      // Same as sq_map with IORING_FEAT_SINGLE_MMAP
+    size_t cq_map_size;
+    size_t sqes_size;
+    struct iovec iovecs[URING_MAX_OPS];
+};
+
+// --- Shared Configuration (set before fork) ---
+static int g_enabled = 0;
+
+// --- Per-Thread State (each process, and each epoll worker, owns a ring) ---
+static __thread struct Uring g_ring = {.fd = -1};
+static __thread int g_ring_failed = 0; // Setup failed here: stay synchronous
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// --- Ring Lifecycle ---
+
+static void ring_close(struct Uring* ring) {
+    if (ring->sqes != NULL) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map != NULL) munmap(ring->sq_map, ring->sq_map_size);
+    if (ring->fd != -1) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+/**
+ * @brief Creates a ring of URING_MAX_OPS entries and maps its queues.
+ */
+static int ring_open(struct Uring* ring) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = sys_io_uring_setup(URING_MAX_OPS, &params);
+    if (ring->fd == -1) return -1;
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map && ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) { ring->sq_map = NULL; ring_close(ring); return -1; }
+    if (single_map) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) { ring->cq_map = NULL; ring_close(ring); return -1; }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) { ring->sqes = NULL; ring_close(ring); return -1; }
+
+    char* sq = ring->sq_map;
+    char* cq = ring->cq_map;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->owner = getpid();
+    return 0;
+}
+
+/**
+ * @brief Returns this process's ring, creating it on first use (and
+ * replacing one inherited through fork()), or NULL to run synchronously.
+ */
+static struct Uring* process_ring(void) {
+    if (!g_enabled || g_ring_failed) return NULL;
+    if (g_ring.fd != -1 && g_ring.owner == getpid()) return &g_ring;
+
+    if (g_ring.fd != -1) ring_close(&g_ring); // Drops only this process's reference
+    if (ring_open(&g_ring) == -1) {
+        perror("io_uring setup failed, using synchronous I/O");
+        g_ring_failed = 1;
+        return NULL;
+    }
+    return &g_ring;
+}
+
+// --- Setup ---
+
+/**
+ * @brief Turns the io_uring path on or off. Enabling probes that a ring
+ * can be created here.
+ * @return 0 on success, -1 if io_uring is unavailable (batches then run
+ * synchronously).
+ */
+int uring_init(int enable) {
+    g_enabled = 0;
+    if (!enable) return 0;
+
+    struct Uring probe;
+    if (ring_open(&probe) == -1) return -1;
+    ring_close(&probe);
+    g_enabled = 1;
+    return 0;
+}
+
+int uring_enabled(void) {
+    return g_enabled && !g_ring_failed;
+}
+
+// --- Batches ---
+
+static long expected_result(const struct UringOp* op) {
+    return (op->type == URING_FDATASYNC) ? 0 : (long)op->len;
+}
+
+/**
+ * @brief Runs ops one after another with plain syscalls. A failed
+ * linked op cancels the rest of its chain, as it would in the ring.
+ */
+static void run_sync(struct UringOp* ops, int count) {
+    int cancel = 0;
+    for (int i = 0; i < count; i++) {
+        struct UringOp* op = &ops[i];
+        if (cancel) {
+            op->result = -ECANCELED;
+        } else {
+            ssize_t n = 0;
+            size_t done = 0;
+            do {
+                if (op->type == URING_READ) {
+                    n = pread(op->fd, (char*)op->buf + done, op->len - done, op->offset + (off_t)done);
+                } else if (op->type == URING_WRITE) {
+                    n = pwrite(op->fd, (const char*)op->buf + done, op->len - done, op->offset + (off_t)done);
+                } else {
+                    n = fdatasync(op->fd);
+                }
+                if (n > 0) done += (size_t)n;
+            } while (op->type != URING_FDATASYNC && n > 0 && done < op->len);
+            op->result = (n < 0) ? -errno : (long)done;
+        }
+        cancel = op->link && op->result != expected_result(op);
+    }
+}
+
+/**
+ * @brief Submits up to URING_MAX_OPS ops with one io_uring_enter() and
+ * collects every completion.
+ * @return 0 once all completed, -1 if the ring failed.
+ */
+static int run_ring(struct Uring* ring, struct UringOp* ops, int count) {
+    unsigned tail = *ring->sq_tail;
+    unsigned mask = *ring->sq_mask;
+    for (int i = 0; i < count; i++) {
+        unsigned index = tail & mask;
+        struct io_uring_sqe* sqe = &ring->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = ops[i].fd;
+        sqe->user_data = (unsigned long long)i;
+        if (ops[i].link && i + 1 < count) sqe->flags = IOSQE_IO_LINK;
+        if (ops[i].type == URING_FDATASYNC) {
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        } else {
+            // READV/WRITEV rather than READ/WRITE: available since the first io_uring kernels
+            ring->iovecs[i].iov_base = ops[i].buf;
+            ring->iovecs[i].iov_len = ops[i].len;
+            sqe->opcode = (ops[i].type == URING_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr = (unsigned long long)(uintptr_t)&ring->iovecs[i];
+            sqe->len = 1;
+            sqe->off = (unsigned long long)ops[i].offset;
+        }
+        ring->sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    unsigned to_submit = (unsigned)count;
+    int completed = 0;
+    while (completed < count) {
+        int rc = sys_io_uring_enter(ring->fd, to_submit, (unsigned)(count - completed), IORING_ENTER_GETEVENTS);
+        if (rc == -1 && errno != EINTR) return -1;
+        if (rc > 0) to_submit -= (unsigned)rc;
+
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->user_data < (unsigned long long)count) ops[cqe->user_data].result = cqe->res;
+            head++;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs a batch and waits for all of it: one ring submission per
+ * URING_MAX_OPS ops with io_uring, plain syscalls otherwise. Each op's
+ * `result` is set. A short read or write is reported, not retried.
+ * @return 0 if every read and write moved its full length and every
+ * sync succeeded, -1 otherwise.
+ */
+int uring_run(struct UringOp* ops, int count) {
+    for (int first = 0; first < count; first += URING_MAX_OPS) {
+        int n = (count - first < URING_MAX_OPS) ? count - first : URING_MAX_OPS;
+        struct Uring* ring = process_ring();
+        if (ring == NULL) {
+            run_sync(ops + first, n);
+        } else if (run_ring(ring, ops + first, n) == -1) {
+            // Ops may still be in flight; a fresh ring is not worth the risk
+            perror("io_uring_enter failed, using synchronous I/O");
+            g_ring_failed = 1;
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (ops[i].result != expected_result(&ops[i])) {
+            errno = (ops[i].result < 0) ? (int)-ops[i].result : EIO;
+            return -1;
+        }
+    }
+    return 0;
+}
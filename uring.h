@@ -0,0 +1,47 @@
+/*
+ * ========================================
+ * uring.h
+ * =Description: Optional io_uring path for batched
+ * storage I/O. A caller describes several reads,
+ * writes and fdatasyncs as one batch; uring_run()
+ * hands the whole batch to the kernel with a single
+ * io_uring_enter() and waits for all of it.
+ * - Raw syscalls, no liburing
+ * - Each process (each thread in epoll mode) sets up
+ *   its own ring on first use
+ * - Without io_uring (disabled, old kernel, setup
+ *   failure) a batch runs as plain pread/pwrite/fdatasync
+ * ========================================
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <sys/types.h>  // For off_t, size_t
+
+// --- Operation Types ---
+#define URING_READ 0
+#define URING_WRITE 1
+#define URING_FDATASYNC 2
+
+#define URING_MAX_OPS 32 // Ring size; longer batches are submitted in chunks
+
+// One request of a batch
+struct UringOp {
+    int type;
+    int fd;
+    void* buf;     // Source of a URING_WRITE
+    size_t len;
+    off_t offset;
+    int link;      // Start the next op only once this one has succeeded
+    long result;   // Set by uring_run(): bytes transferred (0 for a sync) or -errno
+};
+
+// --- Setup (parent, before fork) ---
+int uring_init(int enable);
+int uring_enabled(void);
+
+// --- Batches ---
+int uring_run(struct UringOp* ops, int count);
+
+#endif // URING_H
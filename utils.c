@@ -7,6 +7,10 @@
 
 #include "utils.h"
 #include "bank_storage.h"
+#include "record_index.h"
+#include "loan_index.h"
+#include "btree.h"
+#include "storage.h"
 #include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,38 +19,339 @@
 #include <time.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+// --- Session Scheduling ---
+
+// Set by the epoll server before its workers start; NULL in forked sessions
+static const struct SessionHooks* g_session_hooks = NULL;
+
+// Scratch buffers of the running session (see g_read_buffer)
+static struct SessionBuffers g_process_buffers;
+__thread struct SessionBuffers* g_session_buffers = &g_process_buffers;
+
+/**
+ * @brief Installs the scheduler hooks of a server whose sessions are
+ * coroutines on worker threads. Call before the first session starts.
+ */
+void set_session_hooks(const struct SessionHooks* hooks) {
+    g_session_hooks = hooks;
+}
+
+/**
+ * @brief Parks the session until its socket is readable (or writable).
+ * A forked session owns its process and simply blocks in poll().
+ */
+void wait_for_socket(int socket_fd, int writable) {
+    if (g_session_hooks != NULL) {
+        g_session_hooks->wait(socket_fd, writable);
+        return;
+    }
+    struct pollfd ready = {socket_fd, writable ? POLLOUT : POLLIN, 0};
+    poll(&ready, 1, -1);
+}
+
+/**
+ * @brief Arms the signal handlers that release a logged-in session's
+ * lock when its client vanishes. Signals reach a whole process, so the
+ * epoll server relies on failed reads and writes instead.
+ */
+void watch_session_disconnect(void) {
+    if (g_session_hooks != NULL) return;
+    signal(SIGINT, handle_unexpected_disconnect);
+    signal(SIGPIPE, handle_unexpected_disconnect);
+}
+
+/**
+ * @brief Sends any queued responses, closes the connection and ends the
+ * session: the child process exits, or the coroutine is retired. Does
+ * not return.
+ */
+void end_client_session(int socket_fd) {
+    struct SessionWriter* writer = &g_session_buffers->writer;
+    flush_responses(socket_fd);
+    free(writer->data);
+    writer->data = NULL;
+    writer->capacity = 0;
+    if (g_session_hooks != NULL) g_session_hooks->end(socket_fd);
+    close(socket_fd);
+    exit(0);
+}
+
+/**
+ * @brief Locks a shared mutex that may be held across a client prompt.
+ * A coroutine must not block its worker thread on it (the holder may be
+ * a session on the same thread), so it retries and lets others run.
+ */
+int lock_session_mutex(pthread_mutex_t* mutex) {
+    if (g_session_hooks == NULL) return lock_shared_mutex(mutex);
+    for (;;) {
+        int rc = pthread_mutex_trylock(mutex);
+        if (rc == EOWNERDEAD) {
+            pthread_mutex_consistent(mutex);
+            rc = 0;
+        }
+        if (rc != EBUSY) return (rc == 0) ? 0 : -1;
+        g_session_hooks->yield();
+    }
+}
+
+/**
+ * @brief Starts (or with NULL ends) command mode for the running session.
+ */
+void set_session_script(struct SessionScript* script) {
+    g_session_buffers->script = script;
+}
+
+/**
+ * @brief Holds back a command-mode handler's response; only its last one
+ * is sent, so every command gets exactly one reply line.
+ * @return Bytes the response would have queued, or -1 if out of memory.
+ */
+static int hold_reply(struct SessionScript* script, const char* status, const char* message) {
+    size_t len = strlen(message);
+    if (len + 1 > script->reply_capacity) {
+        char* grown = realloc(script->reply, len + 1);
+        if (grown == NULL) return -1;
+        script->reply = grown;
+        script->reply_capacity = len + 1;
+    }
+    memcpy(script->reply, message, len + 1);
+    script->reply_status = status;
+    return (int)(strlen(status) + len + 2);
+}
+
+// --- Coalesced Response Writer ---
+
+/**
+ * @brief The running session's output queue for `socket_fd`.
+ */
+static struct SessionWriter* session_writer(int socket_fd) {
+    struct SessionWriter* writer = &g_session_buffers->writer;
+    if (writer->socket_fd != socket_fd) { // Never mix bytes of two connections
+        writer->socket_fd = socket_fd;
+        writer->failed = 0;
+        writer->used = 0;
+    }
+    return writer;
+}
+
+/**
+ * @brief Appends raw bytes to the output queue.
+ * @return 0 on success, -1 if the connection has failed or memory ran out.
+ */
+int queue_output(int socket_fd, const void* data, size_t len) {
+    struct SessionWriter* writer = session_writer(socket_fd);
+    if (writer->failed) return -1;
+    if (writer->used + len > writer->capacity) {
+        size_t capacity = (writer->capacity > 0) ? writer->capacity : 1024;
+        while (capacity < writer->used + len) capacity *= 2;
+        char* grown = realloc(writer->data, capacity);
+        if (grown == NULL) return -1;
+        writer->data = grown;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->used, data, len);
+    writer->used += len;
+    return 0;
+}
+
+/**
+ * @brief Writes everything queued. Called when the session is about to
+ * wait for input, so a whole interaction (e.g. a listing and the next
+ * prompt) leaves in one write() and usually one packet.
+ * @return 0 once sent (or nothing was queued), -1 if the connection failed.
+ */
+int flush_responses(int socket_fd) {
+    struct SessionWriter* writer = session_writer(socket_fd);
+    size_t sent = 0;
+    while (!writer->failed && sent < writer->used) {
+        ssize_t n = write(socket_fd, writer->data + sent, writer->used - sent);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            wait_for_socket(socket_fd, 1);
+            continue;
+        }
+        if (n <= 0) writer->failed = 1;
+        else sent += (size_t)n;
+    }
+    writer->used = 0;
+    return writer->failed ? -1 : 0;
+}
 
 /**
- * @brief Sends a formatted response to the client.
+ * @brief Queues a formatted response for the client. Messages have no
+ * length limit.
  * Protocol: [STATUS_CODE]:[Message]\n
+ * @return Bytes queued, or -1 if the connection has failed.
  */
 int send_response(int socket_fd, const char* status, const char* message) {
-    char temp_buffer[1024];
-    snprintf(temp_buffer, sizeof(temp_buffer), "%s:%s\n", status, message);
-    
-    return write(socket_fd, temp_buffer, strlen(temp_buffer));
+    size_t status_len = strlen(status), message_len = strlen(message);
+    struct SessionScript* script = g_session_buffers->script;
+    if (script != NULL) {
+        // Command mode: the arguments already answer every prompt
+        if (strncmp(status, "PROMPT", 6) == 0) return (int)(status_len + message_len + 2);
+        return hold_reply(script, status, message);
+    }
+    if (queue_output(socket_fd, status, status_len) == -1 || queue_output(socket_fd, ":", 1) == -1 ||
+        queue_output(socket_fd, message, message_len) == -1 || queue_output(socket_fd, "\n", 1) == -1) {
+        return -1;
+    }
+    if (g_session_buffers->writer.used >= SESSION_WRITER_FLUSH_AT && flush_responses(socket_fd) == -1) return -1;
+    return (int)(status_len + message_len + 2);
+}
+
+// --- Buffered Line Reader ---
+
+/**
+ * @brief Reads whatever the client has sent into the reader's free space,
+ * which may wrap around the end of the ring: both parts go to one readv().
+ * @return Bytes added, 0 on EOF, -1 on error.
+ */
+static int fill_reader(struct SessionReader* reader, int socket_fd) {
+    unsigned int end = (reader->start + reader->count) % SESSION_READER_CAPACITY;
+    unsigned int space = SESSION_READER_CAPACITY - reader->count;
+    unsigned int tail_space = SESSION_READER_CAPACITY - end;
+    struct iovec parts[2] = {
+        {reader->ring + end, (space < tail_space) ? space : tail_space},
+        {reader->ring, (space > tail_space) ? space - tail_space : 0},
+    };
+
+    for (;;) {
+        ssize_t n = readv(socket_fd, parts, (parts[1].iov_len > 0) ? 2 : 1);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            wait_for_socket(socket_fd, 0); // Epoll server: park until the client sends more
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n > 0) reader->count += (unsigned int)n;
+        return (int)n;
+    }
+}
+
+/**
+ * @brief Offset of the first newline among the first `limit` unread bytes
+ * (scanned as at most two runs of the ring), or -1 if there is none.
+ */
+static long find_newline(const struct SessionReader* reader, unsigned int limit) {
+    if (limit > reader->count) limit = reader->count;
+    unsigned int first_run = SESSION_READER_CAPACITY - reader->start;
+    if (first_run > limit) first_run = limit;
+
+    const char* hit = memchr(reader->ring + reader->start, '\n', first_run);
+    if (hit != NULL) return hit - (reader->ring + reader->start);
+    hit = memchr(reader->ring, '\n', limit - first_run);
+    return (hit != NULL) ? first_run + (hit - reader->ring) : -1;
+}
+
+/**
+ * @brief Copies `len` unread bytes out (len may be 0) and consumes `len + skip`.
+ */
+static void take_bytes(struct SessionReader* reader, char* out, unsigned int len, unsigned int skip) {
+    unsigned int first_run = SESSION_READER_CAPACITY - reader->start;
+    if (first_run > len) first_run = len;
+    memcpy(out, reader->ring + reader->start, first_run);
+    memcpy(out + first_run, reader->ring, len - first_run);
+    reader->start = (reader->start + len + skip) % SESSION_READER_CAPACITY;
+    reader->count -= len + skip;
+}
+
+static struct SessionReader* session_reader(int socket_fd) {
+    struct SessionReader* reader = &g_session_buffers->reader;
+    if (reader->socket_fd != socket_fd) { // Never mix bytes of two connections
+        reader->socket_fd = socket_fd;
+        reader->start = reader->count = 0;
+    }
+    return reader;
 }
 
 /**
  * @brief Reads a single newline-terminated line from a socket.
+ * Input is read in blocks into the session's ring buffer, so a line
+ * costs one read() at most, and lines the client sent together
+ * (pipelined input) are served without touching the socket. A line
+ * longer than max_len - 1 is returned in pieces.
+ * @return Length of the line (newline removed), or the failed read's
+ * result (0 on EOF) if the connection ends before a newline.
  */
 int read_line(int socket_fd, char* buffer, int max_len) {
-    bzero(buffer, max_len);
-    int total_bytes = 0;
-    char ch;
+    struct SessionScript* script = g_session_buffers->script;
+    if (script != NULL) {
+        if (script->next >= script->count) { // Reads as a disconnect: the handler gives up
+            script->starved = 1;
+            buffer[0] = '\0';
+            return 0;
+        }
+        snprintf(buffer, (size_t)max_len, "%s", script->args[script->next++]);
+        return (int)strlen(buffer);
+    }
+
+    struct SessionReader* reader = session_reader(socket_fd);
+    unsigned int limit = (unsigned int)max_len - 1;
+    if (limit >= SESSION_READER_CAPACITY) limit = SESSION_READER_CAPACITY - 1;
+    for (;;) {
+        // A newline right after a full buffer ends that line too
+        long newline = find_newline(reader, limit + 1);
+        if (newline >= 0) {
+            take_bytes(reader, buffer, (unsigned int)newline, 1);
+            buffer[newline] = '\0';
+            return (int)newline;
+        }
+        if (reader->count >= limit) {
+            take_bytes(reader, buffer, limit, 0);
+            buffer[limit] = '\0';
+            return (int)limit;
+        }
 
-    while (total_bytes < max_len - 1) {
-        int bytes_read = read(socket_fd, &ch, 1);
+        // About to wait for the client: send what it is waiting for first
+        if (flush_responses(socket_fd) == -1) return -1;
+        int bytes_read = fill_reader(reader, socket_fd);
         if (bytes_read <= 0) {
+            reader->count = 0; // Drop the unfinished line, so later reads see the end too
+            buffer[0] = '\0';
             return bytes_read;
         }
-        if (ch == '\n') {
-            break;
+    }
+}
+
+/**
+ * @brief Returns the next input byte without consuming it, waiting for
+ * the client if nothing is buffered. Used to tell protocols apart.
+ * @return The byte (0-255), or -1 if the connection ended.
+ */
+int peek_input(int socket_fd) {
+    struct SessionReader* reader = session_reader(socket_fd);
+    while (reader->count == 0) {
+        if (flush_responses(socket_fd) == -1 || fill_reader(reader, socket_fd) <= 0) return -1;
+    }
+    return (unsigned char)reader->ring[reader->start];
+}
+
+/**
+ * @brief Reads exactly `len` bytes of binary input, through the same
+ * buffer as read_line(), so the two can follow each other.
+ * @return `len`, or the failed read's result (0 on EOF) if the
+ * connection ends first.
+ */
+int read_exact(int socket_fd, void* buffer, int len) {
+    struct SessionReader* reader = session_reader(socket_fd);
+    char* out = buffer;
+    int done = 0;
+    while (done < len) {
+        if (reader->count == 0) {
+            if (flush_responses(socket_fd) == -1) return -1;
+            int bytes_read = fill_reader(reader, socket_fd);
+            if (bytes_read <= 0) return bytes_read;
         }
-        buffer[total_bytes++] = ch;
+        unsigned int chunk = (unsigned int)(len - done);
+        if (chunk > reader->count) chunk = reader->count;
+        take_bytes(reader, out + done, chunk, 0);
+        done += (int)chunk;
     }
-    buffer[total_bytes] = '\0'; // Null-terminate
-    return total_bytes;
+    return done;
 }
 
 // --- Session Management Implementation ---
@@ -72,6 +377,26 @@ sem_t* create_session_lock(int session_id, char* sem_name_buffer, int buffer_siz
     return sem;
 }
 
+/**
+ * @brief Takes the one-session-per-user lock for a login.
+ * @return 0 with the semaphore in `*session_sem` (release it with
+ * release_session_lock()), 1 if the ID is logged in elsewhere, -1 on error.
+ */
+int acquire_session_lock(int session_id, sem_t** session_sem) {
+    char sem_name[50];
+    sem_t* sem = create_session_lock(session_id, sem_name, sizeof(sem_name));
+    if (sem == NULL) return -1;
+
+    if (sem_trywait(sem) == -1) {
+        int busy = (errno == EAGAIN);
+        if (!busy) perror("sem_trywait");
+        sem_close(sem);
+        return busy ? 1 : -1;
+    }
+    *session_sem = sem;
+    return 0;
+}
+
 /**
  * @brief Signal handler for SIGINT / SIGTERM to clean up the semaphore.
  */
@@ -116,82 +441,326 @@ void handle_session_logout(int socket_fd, int session_id, sem_t* session_sem) {
     send_response(socket_fd, "LOGOUT", "Logged out successfully.");
 }
 
+// --- Shared Memory Implementation ---
+
+/**
+ * @brief Allocates zero-filled memory shared with all future children.
+ * @return The region, or NULL on failure.
+ */
+void* create_shared_region(size_t bytes) {
+    void* region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("mmap shared region failed");
+        return NULL;
+    }
+    return region;
+}
+
+/**
+ * @brief Initializes a robust, process-shared mutex inside a shared region.
+ */
+int init_shared_mutex(pthread_mutex_t* mutex) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return (rc == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Locks a shared mutex, recovering it if the owning child died.
+ * Callers keep every critical section a single, self-contained update,
+ * so the protected data is consistent even after an owner death.
+ */
+int lock_shared_mutex(pthread_mutex_t* mutex) {
+    int rc = pthread_mutex_lock(mutex);
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(mutex);
+        rc = 0;
+    }
+    return (rc == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Initializes a process-shared condition variable that times
+ * out against CLOCK_MONOTONIC.
+ */
+int init_shared_cond(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int rc = pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return (rc == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Waits on a shared condition for at most timeout_us.
+ * @return 0 when signalled, 1 on timeout, -1 on error.
+ */
+int wait_shared_cond(pthread_cond_t* cond, pthread_mutex_t* mutex, long timeout_us) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    int rc = pthread_cond_timedwait(cond, mutex, &deadline);
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(mutex);
+        rc = 0;
+    }
+    if (rc == ETIMEDOUT) return 1;
+    return (rc == 0) ? 0 : -1;
+}
+
 // --- Database & Logging Implementation ---
 
 /**
- * @brief Finds the byte offset of a CustomerAccount record by its ID.
+ * @brief Finds the record number of an account in the accounts table by
+ * its ID. Uses the shared account index when available, then the B+tree;
+ * the table scan is only a fallback for when neither can answer.
+ * @return The record number, or -1 if not found.
  */
-off_t find_customer_record_offset(int db_fd, int account_id) {
-    struct CustomerAccount temp_account;
-    lseek(db_fd, 0, SEEK_SET);
-    
-    off_t current_pos = 0;
-    while (read(db_fd, &temp_account, sizeof(temp_account)) == sizeof(temp_account)) {
-        if (temp_account.account_id == account_id) {
-            return current_pos;
-        }
-        current_pos = lseek(db_fd, 0, SEEK_CUR);
+int find_customer_record(int account_id) {
+    if (g_account_index != NULL) {
+        int record_number = record_index_find(g_account_index, account_id);
+        if (record_number != RECORD_INDEX_UNKNOWN) return record_number;
     }
-    return -1; // Not found
+    int record_number = btree_find(g_account_btree, account_id);
+    return (record_number != BTREE_UNKNOWN) ? record_number : storage_find(STORAGE_ACCOUNTS, account_id);
 }
 
 /**
- * @brief Finds the byte offset of an EmployeeRecord record by its ID.
+ * @brief Finds the record number of an EmployeeRecord by its ID.
+ * Uses the shared staff index and the B+tree, scanning only if neither
+ * can answer.
  */
-off_t find_staff_record_offset(int db_fd, int employee_id) {
-    struct EmployeeRecord temp_staff;
-    lseek(db_fd, 0, SEEK_SET);
-    
-    off_t current_pos = 0;
-    while (read(db_fd, &temp_staff, sizeof(temp_staff)) == sizeof(temp_staff)) {
-        if (temp_staff.employee_id == employee_id) {
-            return current_pos;
-        }
-        current_pos = lseek(db_fd, 0, SEEK_CUR);
+int find_staff_record(int employee_id) {
+    if (g_staff_index != NULL) {
+        int record_number = record_index_find(g_staff_index, employee_id);
+        if (record_number != RECORD_INDEX_UNKNOWN) return record_number;
     }
-    return -1; // Not found
+    int record_number = btree_find(g_staff_btree, employee_id);
+    return (record_number != BTREE_UNKNOWN) ? record_number : storage_find(STORAGE_STAFF, employee_id);
+}
+
+// Matches collected by the scan fallback of list_records_by_id()
+struct KeyedRecords {
+    int first_key, last_key;
+    int (*pairs)[2]; // {key, record}
+    long count, capacity;
+    int failed;
+};
+
+static int collect_in_range(int record, const void* data, void* ctx) {
+    struct KeyedRecords* found = ctx;
+    int key;
+    memcpy(&key, data, sizeof(key));
+    if (key < found->first_key || key > found->last_key) return 0;
+    if (found->count == found->capacity) {
+        long capacity = found->capacity ? found->capacity * 2 : 256;
+        int (*grown)[2] = realloc(found->pairs, capacity * sizeof(*grown));
+        if (grown == NULL) { found->failed = 1; return 1; }
+        found->pairs = grown;
+        found->capacity = capacity;
+    }
+    found->pairs[found->count][0] = key;
+    found->pairs[found->count++][1] = record;
+    return 0;
+}
+
+static int compare_keyed(const void* a, const void* b) {
+    const int* x = a;
+    const int* y = b;
+    return (x[0] > y[0]) - (x[0] < y[0]);
 }
 
 /**
- * @brief Finds the byte offset of a LoanApplication record by its ID.
+ * @brief Lists the records of the accounts or staff table whose ID is in
+ * [first_key, last_key], in ID order, up to max_records. Uses the table's
+ * B+tree; without one it scans the table and sorts the matches.
+ * @return Records listed, or -1 on a database error.
  */
-off_t find_loan_record_offset(int db_fd, int loan_id) {
-    struct LoanApplication temp_loan;
-    lseek(db_fd, 0, SEEK_SET);
-    
-    off_t current_pos = 0;
-    while (read(db_fd, &temp_loan, sizeof(temp_loan)) == sizeof(temp_loan)) {
-        if (temp_loan.loan_id == loan_id) {
-            return current_pos;
-        }
-        current_pos = lseek(db_fd, 0, SEEK_CUR);
+int list_records_by_id(int table, int first_key, int last_key, int* records, int max_records) {
+    struct BTree* tree = (table == STORAGE_ACCOUNTS) ? g_account_btree : g_staff_btree;
+    int listed = btree_range(tree, first_key, last_key, NULL, records, max_records);
+    if (listed != -1) return listed;
+
+    struct KeyedRecords found = {first_key, last_key, NULL, 0, 0, 0};
+    if (storage_scan(table, collect_in_range, &found) == -1 || found.failed) {
+        free(found.pairs);
+        return -1;
     }
-    return -1; // Not found
+    qsort(found.pairs, found.count, sizeof(*found.pairs), compare_keyed);
+    listed = (found.count < max_records) ? (int)found.count : max_records;
+    for (int i = 0; i < listed; i++) records[i] = found.pairs[i][1];
+    free(found.pairs);
+    return listed;
 }
 
+/**
+ * @brief Finds the record number of a LoanApplication by its ID.
+ * Uses the shared loan index, scanning only if it cannot answer.
+ */
+int find_loan_record(int loan_id) {
+    if (loan_id <= 0) return -1; // IDs start at 1; 0 marks an unused record
+    int record_number = loan_index_find(loan_id);
+    if (record_number != RECORD_INDEX_UNKNOWN) return record_number;
+    return storage_find(STORAGE_LOANS, loan_id);
+}
 
 /**
- * @brief Appends a transaction record to the transaction database.
+ * @brief Splits an account into its accounts.dat and account_profiles.dat parts.
  */
-void log_transaction(int account_id, const char* type, double amount, double new_balance) {
-    struct Transaction log_entry;
-    log_entry.account_id = account_id;
-    log_entry.resulting_balance = new_balance;
+void split_account(const struct CustomerAccount* account, struct AccountState* state, struct AccountProfile* profile) {
+    memset(state, 0, sizeof(*state));
+    state->account_id = account->account_id;
+    state->is_active = account->is_active;
+    state->balance = account->balance;
 
-    time_t now = time(NULL);
-    strftime(log_entry.timestamp, sizeof(log_entry.timestamp), "%Y-m-d %H:%M:%S", localtime(&now));
-    snprintf(log_entry.description, sizeof(log_entry.description), "%s: %+.2f", type, amount);
+    memset(profile, 0, sizeof(*profile));
+    profile->account_id = account->account_id;
+    memcpy(profile->owner_name, account->owner_name, sizeof(profile->owner_name));
+    memcpy(profile->access_pin, account->access_pin, sizeof(profile->access_pin));
+}
 
-    int log_fd = open(TRANSACTION_DB_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (log_fd == -1) {
-        perror("CRITICAL: Failed to open transaction log");
-        return;
+/**
+ * @brief Rebuilds a full account from its two parts.
+ */
+void join_account(const struct AccountState* state, const struct AccountProfile* profile, struct CustomerAccount* account) {
+    memset(account, 0, sizeof(*account));
+    account->account_id = state->account_id;
+    account->is_active = state->is_active;
+    account->balance = state->balance;
+    memcpy(account->owner_name, profile->owner_name, sizeof(account->owner_name));
+    memcpy(account->access_pin, profile->access_pin, sizeof(account->access_pin));
+}
+
+// --- Money ---
+
+/**
+ * @brief Parses a decimal amount such as "12", "12.3" or "-0.05" into
+ * cents without going through floating point.
+ * @return 0 on success, -1 if the text is not an amount with at most
+ * two decimals or exceeds MONEY_MAX_INPUT.
+ */
+int parse_money(const char* text, money_t* amount) {
+    while (*text == ' ' || *text == '\t') text++;
+    int negative = (*text == '-');
+    if (*text == '-' || *text == '+') text++;
+
+    money_t units = 0;
+    int digits = 0;
+    for (; *text >= '0' && *text <= '9'; text++, digits++) {
+        units = units * 10 + (*text - '0');
+        if (units > MONEY_MAX_INPUT / MONEY_SCALE) return -1;
     }
+    money_t cents = 0;
+    if (*text == '.') {
+        text++;
+        int decimals = 0;
+        for (; *text >= '0' && *text <= '9'; text++, decimals++, digits++) {
+            if (decimals == 2) return -1;
+            cents = cents * 10 + (*text - '0');
+        }
+        if (decimals == 1) cents *= 10;
+    }
+    while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+    if (digits == 0 || *text != '\0') return -1;
+
+    money_t value = units * MONEY_SCALE + cents;
+    *amount = negative ? -value : value;
+    return 0;
+}
+
+/**
+ * @brief Parses a local date or date-time, "YYYY-MM-DD", "YYYY-MM-DD
+ * HH:MM" or "YYYY-MM-DD HH:MM:SS", into microseconds since the epoch.
+ * With `end_of_range` set, the omitted fields are filled in as late as
+ * possible, so "2024-05-31" as an end bound covers that whole day.
+ * @return 0 on success, -1 if the text is not such a date.
+ */
+int parse_time_bound(const char* text, int end_of_range, long long* time_us) {
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    char extra;
+    int fields = sscanf(text, " %d-%d-%d %d:%d:%d %c", &local.tm_year, &local.tm_mon, &local.tm_mday,
+                        &local.tm_hour, &local.tm_min, &local.tm_sec, &extra);
+    if (fields != 3 && fields != 5 && fields != 6) return -1;
+    if (local.tm_mon < 1 || local.tm_mon > 12 || local.tm_mday < 1 || local.tm_mday > 31 ||
+        local.tm_hour > 23 || local.tm_min > 59 || local.tm_sec > 60) return -1;
+
+    long long span_us = 0; // Length of the period the text names, minus 1 us
+    if (fields == 3) span_us = 86400LL * 1000000 - 1;
+    else if (fields == 5) span_us = 60LL * 1000000 - 1;
+    else span_us = 1000000 - 1;
+
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    time_t seconds = mktime(&local);
+    if (seconds == (time_t)-1) return -1;
+    *time_us = (long long)seconds * 1000000 + (end_of_range ? span_us : 0);
+    return 0;
+}
+
+/**
+ * @brief Converts a legacy floating-point amount to cents, rounding half
+ * away from zero. Only used when upgrading old data.
+ */
+money_t money_to_cents(double amount) {
+    return (money_t)(amount * MONEY_SCALE + (amount < 0 ? -0.5 : 0.5));
+}
+
+// Display names, indexed by enum TransactionOp
+static const char* const g_transaction_op_names[] = {
+    "UNKNOWN", "DEPOSIT", "WITHDRAWAL", "TRANSFER_OUT", "TRANSFER_IN", "OPENING_BALANCE", "LOAN_APPROVED"
+};
+
+/**
+ * @brief Returns the display name of a TransactionOp.
+ */
+const char* transaction_op_name(int op) {
+    if (op < 0 || op > TXN_OP_LOAN_APPROVED) op = TXN_OP_UNKNOWN;
+    return g_transaction_op_names[op];
+}
+
+/**
+ * @brief Fills in a transaction log record (timestamped now).
+ */
+void build_transaction(struct Transaction* entry, int account_id, int op, money_t amount,
+                       int counterparty_id, money_t new_balance) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
 
-    struct flock lock = {F_WRLCK, SEEK_SET, 0, 0, getpid()};
-    fcntl(log_fd, F_SETLKW, &lock);
-    write(log_fd, &log_entry, sizeof(log_entry));
-    lock.l_type = F_UNLCK;
-    fcntl(log_fd, F_SETLK, &lock);
-    close(log_fd);
+    memset(entry, 0, sizeof(*entry));
+    entry->account_id = account_id;
+    entry->counterparty_id = counterparty_id;
+    entry->op = op;
+    entry->timestamp_us = (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    entry->amount = amount;
+    entry->resulting_balance = new_balance;
 }
+
+/**
+ * @brief Renders one record as "[time] OP: +amount | Balance: x".
+ */
+void format_transaction(const struct Transaction* entry, char* line, size_t len) {
+    char timestamp[32];
+    time_t seconds = (time_t)(entry->timestamp_us / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &local);
+
+    snprintf(line, len, "[%s] %s: %s" MONEY_FMT " | Balance: " MONEY_FMT, timestamp,
+             transaction_op_name(entry->op), entry->amount >= 0 ? "+" : "",
+             MONEY_ARGS(entry->amount), MONEY_ARGS(entry->resulting_balance));
+}
+
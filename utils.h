@@ -11,26 +11,123 @@
 #define UTILS_H
 
 #include <semaphore.h>
+#include <pthread.h>
 #include <sys/types.h>  // For off_t
 
+#include "bank_storage.h" // For money_t
+
 // --- Socket Communication ---
+// Responses are queued and go out together, in one write(), when the
+// session next waits for client input (or ends).
 int send_response(int socket_fd, const char* status, const char* message);
+int queue_output(int socket_fd, const void* data, size_t len);
+int flush_responses(int socket_fd);
 int read_line(int socket_fd, char* buffer, int max_len);
+int peek_input(int socket_fd);
+int read_exact(int socket_fd, void* buffer, int len);
+
+struct SessionScript; // Command mode (see below)
+
+// --- Session Scheduling ---
+// Hooks of the epoll server, whose sessions are coroutines on worker
+// threads. Without them every session owns its process and blocks.
+struct SessionHooks {
+    void (*wait)(int socket_fd, int writable); // Park until the socket is ready
+    void (*yield)(void);                       // Let the thread's other sessions run
+    void (*end)(int socket_fd);                // Close and retire the session; does not return
+};
+
+void set_session_hooks(const struct SessionHooks* hooks);
+void wait_for_socket(int socket_fd, int writable);
+void watch_session_disconnect(void);
+void end_client_session(int socket_fd);
+int lock_session_mutex(pthread_mutex_t* mutex);
+void set_session_script(struct SessionScript* script);
 
 // --- Session Management ---
 sem_t* create_session_lock(int session_id, char* sem_name_buffer, int buffer_size);
+int acquire_session_lock(int session_id, sem_t** session_sem);
 void release_session_lock(int session_id, sem_t* session_sem);
 void handle_session_logout(int socket_fd, int session_id, sem_t* session_sem);
 void handle_unexpected_disconnect(int signum);
 
+// --- Shared Memory (set up by the parent before fork) ---
+void* create_shared_region(size_t bytes);
+int init_shared_mutex(pthread_mutex_t* mutex);
+int lock_shared_mutex(pthread_mutex_t* mutex);
+int init_shared_cond(pthread_cond_t* cond);
+int wait_shared_cond(pthread_cond_t* cond, pthread_mutex_t* mutex, long timeout_us);
+
+// --- Money ---
+// printf support: snprintf(buf, len, "Balance: " MONEY_FMT, MONEY_ARGS(balance))
+#define MONEY_FMT "%s%lld.%02lld"
+#define MONEY_ARGS(m) ((m) < 0 ? "-" : ""), ((m) < 0 ? -(m) : (m)) / MONEY_SCALE, ((m) < 0 ? -(m) : (m)) % MONEY_SCALE
+#define MONEY_MAX_INPUT 100000000000000LL // Largest accepted amount (1 trillion), keeps sums far from overflow
+
+int parse_money(const char* text, money_t* amount);
+money_t money_to_cents(double amount);
+
+// --- Dates ---
+int parse_time_bound(const char* text, int end_of_range, long long* time_us);
+
 // --- Database & Logging ---
-off_t find_customer_record_offset(int db_fd, int account_id);
-off_t find_staff_record_offset(int db_fd, int employee_id);
-off_t find_loan_record_offset(int db_fd, int loan_id);
-void log_transaction(int account_id, const char* type, double amount, double new_balance);
+int find_customer_record(int account_id);
+int find_staff_record(int employee_id);
+int find_loan_record(int loan_id);
+int list_records_by_id(int table, int first_key, int last_key, int* records, int max_records);
+void split_account(const struct CustomerAccount* account, struct AccountState* state, struct AccountProfile* profile);
+void join_account(const struct AccountState* state, const struct AccountProfile* profile, struct CustomerAccount* account);
+const char* transaction_op_name(int op);
+void build_transaction(struct Transaction* entry, int account_id, int op, money_t amount,
+                       int counterparty_id, money_t new_balance);
+void format_transaction(const struct Transaction* entry, char* line, size_t len);
 
 // --- Global BuffFers ---
-extern char g_read_buffer[1024];
-extern char g_write_buffer[1024];
+#define SESSION_READER_CAPACITY 4096
+#define SESSION_WRITER_FLUSH_AT 65536 // Queued bytes that force a flush without waiting for input
+
+// Bytes received from the client but not yet returned by read_line()
+struct SessionReader {
+    int socket_fd;         // Connection the bytes came from
+    unsigned int start;    // Ring index of the first unread byte
+    unsigned int count;    // Unread bytes
+    char ring[SESSION_READER_CAPACITY];
+};
+
+// Responses queued for the client but not yet written
+struct SessionWriter {
+    int socket_fd;         // Connection the bytes are for
+    int failed;            // A write failed: the client is gone
+    size_t used;
+    size_t capacity;
+    char* data;            // Grown with realloc(), freed when the session ends
+};
+
+// Command mode: a handler's prompts are answered from the command line's
+// arguments. While a session has a script, read_line() returns the next
+// argument instead of reading the socket, prompts are not sent, and the
+// handler's last other response is held back for the caller to send.
+struct SessionScript {
+    char** args;
+    int count;
+    int next;                  // Next argument read_line() returns
+    int starved;               // A read found no argument left
+    const char* reply_status;  // NULL until the handler responds
+    char* reply;               // Grown with realloc()
+    size_t reply_capacity;
+};
+
+// Scratch buffers of the running session. A forked session owns its
+// process's pair; the epoll server points this at the resumed session's.
+struct SessionBuffers {
+    char read[1024];
+    char write[1024];
+    struct SessionReader reader;
+    struct SessionWriter writer;
+    struct SessionScript* script; // Command mode only
+};
+extern __thread struct SessionBuffers* g_session_buffers;
+#define g_read_buffer (g_session_buffers->read)
+#define g_write_buffer (g_session_buffers->write)
 
 #endif // UTILS_H
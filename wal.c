@@ -0,0 +1,650 @@
+/*
+ * ========================================
+ * wal.c
+ * =Description: Implementation of the write-ahead log.
+ *
+ * Commit protocol (wal_commit, caller holds the record locks):
+ * 1. Enter the checkpoint gate
+ * 2. Append the WAL record through the group-commit
+ *    journal; it is durable when this returns
+ * 3. Apply the after-images to the data files and
+ *    append the transaction log entries (no fsync)
+ * 4. Leave the gate
+ *
+ * Checkpoint (background process):
+ * - Closes the gate and waits until no operation is
+ *   between steps 1 and 4, so every logged record is applied
+ * - fsyncs the data files and the transaction log
+ * - Writes wal.ckpt with epoch + 1 and the log length,
+ *   then empties the WAL. Records of an older epoch are
+ *   ignored by recovery, so a crash between the two is safe.
+ *
+ * Pause (bulk loads): a checkpoint that keeps the gate
+ * closed until wal_resume(), so the loader writes the
+ * data files and the transaction log directly while no
+ * WAL record is pending. Resuming checkpoints again, so
+ * a later recovery never cuts the loaded log entries.
+ *
+ * Recovery (startup) re-applies every record of the
+ * current epoch. Images are idempotent; the transaction
+ * log is cut back to the checkpointed length before the
+ * logged entries are appended again, so none is duplicated.
+ * ========================================
+ */
+
+#include "wal.h"
+#include "account_store.h"
+#include "storage.h"
+#include "txn_log.h"
+#include "ledger.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+
+#define WAL_MAGIC 0x57414c32u            // "WAL2" (v2 transaction records)
+#define WAL_MAGIC_V1 0x57414c31u         // "WAL1": v1 transaction records, replayed on upgrade
+#define WAL_CHECKPOINT_MAGIC 0x434b5031u // "CKP1"
+#define WAL_GATE_SLOTS 256               // Operations that can be between log and apply at once
+#define GATE_CHECK_US 100000             // Re-check dead holders this often
+#define QUIESCE_TIMEOUT_US 2000000       // Give up a checkpoint after this long
+#define WAL_PAUSED 1
+#define WAL_PAUSE_FAILED 2
+
+// Contents of wal.ckpt
+struct WalCheckpoint {
+    unsigned int magic;
+    int epoch;                    // WAL records of this epoch are replayed
+    long long transaction_records; // Transaction log length when it was taken
+};
+
+// Checkpoint gate, shared by every process
+struct WalShared {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int epoch;
+    int active;                     // Operations inside the gate
+    pid_t checkpoint_pid;           // Non-zero while a checkpoint holds the gate closed
+    int paused;                     // WAL_PAUSED while a bulk load holds the gate, WAL_PAUSE_FAILED once it failed
+    pid_t holders[WAL_GATE_SLOTS];  // Who is inside, so dead holders can be reclaimed
+};
+
+static struct WalShared* g_wal = NULL;
+static int g_recovered_epoch = 0; // Set by wal_recover() in the parent
+
+// WAL record layout written before the v2 transaction format ("WAL1")
+struct WalRecordV1 {
+    unsigned int magic;
+    unsigned int checksum;
+    int epoch;
+    int image_count;
+    int transaction_count;
+    struct WalImage images[WAL_MAX_IMAGES];
+    struct TransactionV1 transactions[WAL_MAX_TRANSACTIONS];
+};
+
+// --- Record Helpers ---
+
+/**
+ * @brief FNV-1a over everything after the checksum field.
+ */
+static unsigned int checksum_after(const void* record, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)record + offsetof(struct WalRecord, epoch);
+    size_t len = size - offsetof(struct WalRecord, epoch);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static unsigned int wal_checksum(const struct WalRecord* record) {
+    return checksum_after(record, sizeof(*record));
+}
+
+static int counts_are_valid(int image_count, int transaction_count) {
+    return image_count >= 0 && image_count <= WAL_MAX_IMAGES &&
+           transaction_count >= 0 && transaction_count <= WAL_MAX_TRANSACTIONS;
+}
+
+static int record_is_valid(const struct WalRecord* record) {
+    return record->magic == WAL_MAGIC && record->checksum == wal_checksum(record) &&
+           counts_are_valid(record->image_count, record->transaction_count);
+}
+
+/**
+ * @brief Reads the WAL record at `offset`; a WAL1 record is converted to
+ * the current layout.
+ * @return Bytes consumed, or 0 at the end of the valid log.
+ */
+static size_t read_record(int fd, off_t offset, int v1, struct WalRecord* record) {
+    if (!v1) {
+        if (pread(fd, record, sizeof(*record), offset) != sizeof(*record) || !record_is_valid(record)) return 0;
+        return sizeof(*record);
+    }
+
+    struct WalRecordV1 old;
+    if (pread(fd, &old, sizeof(old), offset) != sizeof(old) || old.magic != WAL_MAGIC_V1 ||
+        old.checksum != checksum_after(&old, sizeof(old)) ||
+        !counts_are_valid(old.image_count, old.transaction_count)) {
+        return 0;
+    }
+    memset(record, 0, sizeof(*record));
+    record->magic = WAL_MAGIC;
+    record->epoch = old.epoch;
+    record->image_count = old.image_count;
+    record->transaction_count = old.transaction_count;
+    memcpy(record->images, old.images, sizeof(record->images));
+    for (int i = 0; i < old.transaction_count; i++) {
+        txn_log_convert_v1(&old.transactions[i], &record->transactions[i], time(NULL));
+    }
+    return sizeof(old);
+}
+
+static size_t table_record_size(int table) {
+    if (table == WAL_TABLE_ACCOUNTS) return sizeof(struct CustomerAccount);
+    if (table == WAL_TABLE_ACCOUNT_STATE) return sizeof(struct AccountState);
+    return sizeof(struct LoanApplication);
+}
+
+/**
+ * @brief Clears a record before images and log entries are added.
+ */
+void wal_begin(struct WalRecord* record) {
+    memset(record, 0, sizeof(*record)); // Padding is covered by the checksum
+}
+
+static int add_image(struct WalRecord* record, int table, int record_number, const void* data, int append) {
+    if (record->image_count >= WAL_MAX_IMAGES) return -1;
+    struct WalImage* image = &record->images[record->image_count++];
+    image->table = table;
+    image->record = record_number;
+    image->append = append;
+    memcpy(image->data, data, table_record_size(table));
+    return 0;
+}
+
+int wal_add_account(struct WalRecord* record, int record_number, const struct CustomerAccount* account, int append) {
+    return add_image(record, WAL_TABLE_ACCOUNTS, record_number, account, append);
+}
+
+int wal_add_account_state(struct WalRecord* record, int record_number, const struct AccountState* state) {
+    return add_image(record, WAL_TABLE_ACCOUNT_STATE, record_number, state, 0);
+}
+
+int wal_add_loan(struct WalRecord* record, int record_number, const struct LoanApplication* loan, int append) {
+    return add_image(record, WAL_TABLE_LOANS, record_number, loan, append);
+}
+
+int wal_add_transaction(struct WalRecord* record, int account_id, int op, money_t amount,
+                        int counterparty_id, money_t new_balance) {
+    if (record->transaction_count >= WAL_MAX_TRANSACTIONS) return -1;
+    build_transaction(&record->transactions[record->transaction_count++], account_id, op, amount,
+                      counterparty_id, new_balance);
+    return 0;
+}
+
+// --- Applying Records ---
+
+/**
+ * @brief Writes a record's images and log entries into the live tables.
+ * In-place images go out as one batched write; new accounts keep their
+ * profile-first order.
+ */
+static int apply_record(const struct WalRecord* record) {
+    int rc = 0;
+    struct StorageWrite writes[2 * WAL_MAX_IMAGES];
+    struct AccountState states[WAL_MAX_IMAGES];
+    struct AccountProfile profiles[WAL_MAX_IMAGES];
+    int write_count = 0;
+
+    for (int i = 0; i < record->image_count; i++) {
+        const struct WalImage* image = &record->images[i];
+        if (image->table == WAL_TABLE_ACCOUNTS) {
+            const struct CustomerAccount* account = (const struct CustomerAccount*)image->data;
+            if (image->append) {
+                if (account_store_extend(image->record, account) == -1) rc = -1;
+                continue;
+            }
+            split_account(account, &states[i], &profiles[i]);
+            writes[write_count++] = (struct StorageWrite){STORAGE_ACCOUNTS, image->record, &states[i], 0};
+            writes[write_count++] = (struct StorageWrite){STORAGE_ACCOUNT_PROFILES, image->record, &profiles[i], 0};
+        } else if (image->table == WAL_TABLE_ACCOUNT_STATE) {
+            writes[write_count++] = (struct StorageWrite){STORAGE_ACCOUNTS, image->record, image->data, 0};
+        } else {
+            writes[write_count++] = (struct StorageWrite){STORAGE_LOANS, image->record, image->data, image->append};
+        }
+    }
+    if (write_count > 0 && storage_write_set(writes, write_count) == -1) rc = -1;
+
+    for (int i = 0; i < record->transaction_count; i++) {
+        if (storage_append_transaction(&record->transactions[i]) == -1) rc = -1;
+    }
+    return rc;
+}
+
+// --- Checkpoint Gate ---
+
+/**
+ * @brief Frees gate slots whose process has died. Caller holds the lock.
+ */
+static void reap_dead_holders(void) {
+    for (int i = 0; i < WAL_GATE_SLOTS; i++) {
+        pid_t pid = g_wal->holders[i];
+        if (pid != 0 && kill(pid, 0) == -1 && errno == ESRCH) {
+            g_wal->holders[i] = 0;
+            g_wal->active--;
+        }
+    }
+}
+
+/**
+ * @brief Waits until no checkpoint is running, then registers the caller.
+ * @return The gate slot, or -1 on error. *epoch receives the current epoch.
+ */
+static int gate_enter(int* epoch) {
+    if (lock_shared_mutex(&g_wal->lock) == -1) return -1;
+
+    int slot = -1;
+    for (;;) {
+        pid_t checkpointer = g_wal->checkpoint_pid;
+        int dead = (checkpointer != 0 && kill(checkpointer, 0) == -1 && errno == ESRCH);
+        if (g_wal->paused == WAL_PAUSE_FAILED || (g_wal->paused && dead)) {
+            // A bulk load stopped half-way; only a restart can roll it back
+            pthread_mutex_unlock(&g_wal->lock);
+            fprintf(stderr, "CRITICAL: unfinished bulk load, updates refused until the server restarts\n");
+            return -1;
+        }
+        if (dead) g_wal->checkpoint_pid = 0; // Checkpointer died with the gate closed
+        if (g_wal->checkpoint_pid == 0) {
+            for (int i = 0; i < WAL_GATE_SLOTS && slot == -1; i++) {
+                if (g_wal->holders[i] == 0) slot = i;
+            }
+            if (slot != -1) break;
+            reap_dead_holders();
+        }
+        wait_shared_cond(&g_wal->cond, &g_wal->lock, GATE_CHECK_US);
+    }
+
+    g_wal->holders[slot] = getpid();
+    g_wal->active++;
+    *epoch = g_wal->epoch;
+    pthread_mutex_unlock(&g_wal->lock);
+    return slot;
+}
+
+static void gate_exit(int slot) {
+    lock_shared_mutex(&g_wal->lock);
+    g_wal->holders[slot] = 0;
+    g_wal->active--;
+    if (g_wal->active == 0) pthread_cond_broadcast(&g_wal->cond);
+    pthread_mutex_unlock(&g_wal->lock);
+}
+
+/**
+ * @brief Logs one operation durably, then applies it.
+ * Without a WAL (startup failed) the operation is applied directly.
+ * @return 0 on success, -1 if the operation was not (fully) recorded.
+ */
+int wal_commit(struct WalRecord* record) {
+    if (g_wal == NULL) return apply_record(record);
+
+    int slot = gate_enter(&record->epoch);
+    if (slot == -1) return -1;
+
+    record->magic = WAL_MAGIC;
+    record->checksum = wal_checksum(record);
+    int rc = journal_append(g_wal_journal, record);
+    if (rc == 0) rc = apply_record(record);
+
+    gate_exit(slot);
+    return rc;
+}
+
+// --- Checkpoint File ---
+
+static int read_checkpoint(struct WalCheckpoint* checkpoint) {
+    int fd = open(WAL_CHECKPOINT_FILE, O_RDONLY);
+    if (fd == -1) return -1;
+    ssize_t n = read(fd, checkpoint, sizeof(*checkpoint));
+    close(fd);
+    return (n == sizeof(*checkpoint) && checkpoint->magic == WAL_CHECKPOINT_MAGIC) ? 0 : -1;
+}
+
+/**
+ * @brief Replaces wal.ckpt atomically (write, fsync, rename, fsync dir).
+ */
+static int write_checkpoint(const struct WalCheckpoint* checkpoint) {
+    const char* temp_path = WAL_CHECKPOINT_FILE ".tmp";
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return -1;
+
+    int ok = write(fd, checkpoint, sizeof(*checkpoint)) == sizeof(*checkpoint) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temp_path, WAL_CHECKPOINT_FILE) == -1) return -1;
+
+    int dir_fd = open(".", O_RDONLY);
+    if (dir_fd != -1) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return 0;
+}
+
+/**
+ * @brief fsyncs a data file; a file that does not exist yet is fine.
+ */
+static int sync_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return (errno == ENOENT) ? 0 : -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+// --- Recovery ---
+
+/**
+ * @brief Cuts the transaction log (and its index) back to the
+ * checkpointed length so replayed entries are not duplicated.
+ * @return The record number the replayed entries start at.
+ */
+static long rewind_transaction_log(long long transaction_records) {
+    long end = (long)transaction_records;
+    if (end > txn_log_record_count()) end = txn_log_record_count();
+    txn_log_truncate(end);
+
+    struct stat st;
+    off_t index_end = (off_t)end * sizeof(struct TransactionIndexEntry);
+    if (stat(TRANSACTION_INDEX_FILE, &st) == 0 && st.st_size > index_end) {
+        truncate(TRANSACTION_INDEX_FILE, index_end);
+    }
+    return end;
+}
+
+static int write_at(int fd, const void* data, size_t size, int record) {
+    return pwrite(fd, data, size, (off_t)record * size) == (ssize_t)size ? 0 : -1;
+}
+
+/**
+ * @brief Writes one image into the data files. Before data format 3 an
+ * account image is a whole accounts.dat record; from 3 on it is split
+ * into its accounts.dat and account_profiles.dat parts.
+ */
+static int replay_image(const struct WalImage* image, int split, int accounts_fd, int profiles_fd, int loans_fd) {
+    if (image->table == WAL_TABLE_LOANS) {
+        return write_at(loans_fd, image->data, sizeof(struct LoanApplication), image->record);
+    }
+    if (image->table == WAL_TABLE_ACCOUNT_STATE) {
+        return write_at(accounts_fd, image->data, sizeof(struct AccountState), image->record);
+    }
+    if (!split) return write_at(accounts_fd, image->data, sizeof(struct CustomerAccount), image->record);
+
+    struct AccountState state;
+    struct AccountProfile profile;
+    split_account((const struct CustomerAccount*)image->data, &state, &profile);
+    if (write_at(profiles_fd, &profile, sizeof(profile), image->record) == -1) return -1;
+    return write_at(accounts_fd, &state, sizeof(state), image->record);
+}
+
+/**
+ * @brief Re-applies every WAL record of the checkpoint's epoch.
+ * @return Number of operations replayed, or -1 on I/O failure.
+ */
+static int replay_records(int wal_fd, const struct WalCheckpoint* checkpoint) {
+    int split = ledger_data_format() >= 3;
+    int accounts_fd = open(ACCOUNT_DB_FILE, O_RDWR | O_CREAT, 0644);
+    int profiles_fd = split ? open(ACCOUNT_PROFILE_FILE, O_RDWR | O_CREAT, 0644) : -1;
+    int loans_fd = open(LOAN_DB_FILE, O_RDWR | O_CREAT, 0644);
+    if (accounts_fd == -1 || (split && profiles_fd == -1) || loans_fd == -1) {
+        perror("wal: open data files failed");
+        if (accounts_fd != -1) close(accounts_fd);
+        if (profiles_fd != -1) close(profiles_fd);
+        if (loans_fd != -1) close(loans_fd);
+        return -1;
+    }
+
+    unsigned int magic = 0;
+    int v1 = pread(wal_fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == WAL_MAGIC_V1;
+
+    struct WalRecord record;
+    off_t offset = 0;
+    long log_end = 0;
+    int replayed = 0, ok = 1;
+    for (size_t size; (size = read_record(wal_fd, offset, v1, &record)) > 0; offset += size) {
+        if (record.epoch > checkpoint->epoch) break; // Torn tail
+        if (record.epoch < checkpoint->epoch) continue; // Applied before the last checkpoint
+
+        if (replayed++ == 0) log_end = rewind_transaction_log(checkpoint->transaction_records);
+        for (int i = 0; i < record.image_count; i++) {
+            if (replay_image(&record.images[i], split, accounts_fd, profiles_fd, loans_fd) == -1) ok = 0;
+        }
+        if (txn_log_write(log_end, record.transactions, record.transaction_count, 0) == -1) ok = 0;
+        log_end += record.transaction_count;
+    }
+
+    if (replayed > 0 && (fsync(accounts_fd) == -1 || fsync(loans_fd) == -1 || txn_log_sync() == -1 ||
+                         (split && fsync(profiles_fd) == -1))) ok = 0;
+    close(accounts_fd);
+    if (profiles_fd != -1) close(profiles_fd);
+    close(loans_fd);
+    return ok ? replayed : -1;
+}
+
+/**
+ * @brief Brings the data files up to date with the WAL, then starts a
+ * new epoch with an empty WAL. Must run after txn_log_init() and
+ * before any index is built.
+ */
+int wal_recover(void) {
+    int wal_fd = open(WAL_FILE, O_RDWR | O_CREAT, 0644);
+    if (wal_fd == -1) {
+        perror("wal: open failed");
+        return -1;
+    }
+
+    struct WalCheckpoint checkpoint;
+    if (read_checkpoint(&checkpoint) == -1) {
+        struct stat st;
+        fstat(wal_fd, &st);
+        if (st.st_size > 0) fprintf(stderr, "wal: %s has no checkpoint, discarding it\n", WAL_FILE);
+        checkpoint.magic = WAL_CHECKPOINT_MAGIC;
+        checkpoint.epoch = -1; // Matches no record
+        checkpoint.transaction_records = 0;
+    }
+
+    int replayed = replay_records(wal_fd, &checkpoint);
+    if (replayed == -1) {
+        fprintf(stderr, "wal: replay failed, leaving %s in place\n", WAL_FILE);
+        close(wal_fd);
+        return -1;
+    }
+    if (replayed > 0) printf("WAL: replayed %d operation(s) from %s\n", replayed, WAL_FILE);
+
+    checkpoint.epoch++;
+    checkpoint.transaction_records = txn_log_record_count();
+    int rc = (write_checkpoint(&checkpoint) == 0 && ftruncate(wal_fd, 0) == 0 && fsync(wal_fd) == 0) ? 0 : -1;
+    close(wal_fd);
+    if (rc == -1) {
+        perror("wal: starting a new epoch failed");
+        return -1;
+    }
+    g_recovered_epoch = checkpoint.epoch;
+    return 0;
+}
+
+// --- Checkpointing ---
+
+/**
+ * @brief Closes the gate and waits for in-flight operations to finish
+ * applying their records. Called with the lock held and the gate open;
+ * returns with the lock released and the gate closed.
+ * @return 1 if nothing is left inside the gate, 0 if it timed out.
+ */
+static int close_gate(void) {
+    g_wal->checkpoint_pid = getpid();
+
+    long waited_us = 0;
+    while (g_wal->active > 0 && waited_us < QUIESCE_TIMEOUT_US) {
+        if (wait_shared_cond(&g_wal->cond, &g_wal->lock, GATE_CHECK_US) == 1) {
+            reap_dead_holders();
+            waited_us += GATE_CHECK_US;
+        }
+    }
+    int quiet = (g_wal->active == 0);
+    pthread_mutex_unlock(&g_wal->lock);
+    return quiet;
+}
+
+static void open_gate(void) {
+    lock_shared_mutex(&g_wal->lock);
+    g_wal->checkpoint_pid = 0;
+    g_wal->paused = 0;
+    pthread_cond_broadcast(&g_wal->cond);
+    pthread_mutex_unlock(&g_wal->lock);
+}
+
+/**
+ * @brief fsyncs the data files and the log, then starts a new epoch.
+ * The caller holds the gate closed.
+ */
+static int take_checkpoint(void) {
+    struct WalCheckpoint checkpoint = {WAL_CHECKPOINT_MAGIC, g_wal->epoch + 1, 0};
+    if (sync_file(ACCOUNT_DB_FILE) == -1 || sync_file(ACCOUNT_PROFILE_FILE) == -1 ||
+        sync_file(LOAN_DB_FILE) == -1 ||
+        txn_log_sync() == -1 || sync_file(TRANSACTION_INDEX_FILE) == -1) return -1;
+
+    checkpoint.transaction_records = txn_log_record_count();
+    if (write_checkpoint(&checkpoint) == -1) return -1;
+    // Old records now belong to a past epoch, so this may fail safely
+    journal_reset(g_wal_journal);
+
+    lock_shared_mutex(&g_wal->lock);
+    g_wal->epoch = checkpoint.epoch;
+    pthread_mutex_unlock(&g_wal->lock);
+    return 0;
+}
+
+/**
+ * @brief Makes everything logged so far durable in the data files and
+ * empties the WAL. Briefly holds new operations at the gate.
+ * @return 0 on success (or nothing to do), -1 on failure.
+ */
+int wal_checkpoint(void) {
+    if (g_wal == NULL) return -1;
+    if (journal_record_count(g_wal_journal) == 0) return 0; // Nothing logged since the last one
+
+    if (lock_shared_mutex(&g_wal->lock) == -1) return -1;
+    if (g_wal->checkpoint_pid != 0) {
+        pthread_mutex_unlock(&g_wal->lock);
+        return 0;
+    }
+
+    int rc = close_gate() ? take_checkpoint() : -1;
+    open_gate();
+    return rc;
+}
+
+/**
+ * @brief Checkpoints and keeps the gate closed: WAL operations wait
+ * until wal_resume(). Without a WAL there is nothing to hold.
+ * @return 0 with the gate closed, -1 if it could not be closed.
+ */
+int wal_pause(void) {
+    if (g_wal == NULL) return 0;
+    if (lock_shared_mutex(&g_wal->lock) == -1) return -1;
+
+    // Wait out a running checkpoint or another pause
+    for (;;) {
+        pid_t holder = g_wal->checkpoint_pid;
+        int dead = (holder != 0 && kill(holder, 0) == -1 && errno == ESRCH);
+        if (g_wal->paused == WAL_PAUSE_FAILED || (g_wal->paused && dead)) {
+            pthread_mutex_unlock(&g_wal->lock);
+            return -1;
+        }
+        if (holder == 0 || dead) break;
+        wait_shared_cond(&g_wal->cond, &g_wal->lock, GATE_CHECK_US);
+    }
+
+    g_wal->paused = WAL_PAUSED;
+    if (!close_gate() || take_checkpoint() == -1) {
+        open_gate();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checkpoints what was written while paused (so recovery keeps
+ * it) and reopens the gate.
+ */
+int wal_resume(void) {
+    if (g_wal == NULL) return 0;
+    int rc = take_checkpoint();
+    open_gate();
+    return rc;
+}
+
+/**
+ * @brief Ends a pause whose bulk load failed half-way: the gate stays
+ * closed and WAL operations fail until a restart rolls the load back.
+ */
+void wal_abandon(void) {
+    if (g_wal == NULL) return;
+    lock_shared_mutex(&g_wal->lock);
+    g_wal->paused = WAL_PAUSE_FAILED;
+    pthread_cond_broadcast(&g_wal->cond);
+    pthread_mutex_unlock(&g_wal->lock);
+}
+
+/**
+ * @brief Forks the background checkpointer. It dies with the server.
+ */
+static void start_checkpointer(int interval_sec) {
+    pid_t server_pid = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("wal: checkpointer fork failed");
+        return;
+    }
+    if (pid > 0) return;
+
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    signal(SIGINT, SIG_IGN); // Shut down together with the server instead
+    while (getppid() == server_pid) {
+        sleep(interval_sec);
+        if (wal_checkpoint() == -1) fprintf(stderr, "wal: checkpoint failed, will retry\n");
+    }
+    _exit(0);
+}
+
+/**
+ * @brief Creates the shared gate and the WAL journal, then starts the
+ * checkpointer. Call after wal_recover() succeeded, before accepting.
+ */
+int wal_init(const struct JournalConfig* config, int checkpoint_interval_sec) {
+    struct WalShared* shared = create_shared_region(sizeof(struct WalShared));
+    if (shared == NULL) return -1;
+
+    init_shared_mutex(&shared->lock);
+    init_shared_cond(&shared->cond);
+    shared->epoch = g_recovered_epoch;
+
+    g_wal_journal = journal_create(WAL_FILE, sizeof(struct WalRecord), config, NULL);
+    if (g_wal_journal == NULL) return -1;
+
+    g_wal = shared;
+    if (checkpoint_interval_sec > 0) start_checkpointer(checkpoint_interval_sec);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * ========================================
+ * wal.h
+ * =Description: Write-ahead log in front of
+ * accounts.dat and loans.dat.
+ * - Every logical operation (e.g. a transfer) is one
+ *   WAL record holding the after-images of the records
+ *   it changes plus its transaction log entries
+ * - Records are made durable with group commit before
+ *   the data files are touched
+ * - A background checkpointer fsyncs the data files
+ *   and empties the WAL; startup replays what is left
+ * ========================================
+ */
+
+#ifndef WAL_H
+#define WAL_H
+
+#include "bank_storage.h"
+#include "journal.h"
+
+// --- Files ---
+#define WAL_FILE "wal.log"
+#define WAL_CHECKPOINT_FILE "wal.ckpt"
+
+// --- Limits & Defaults ---
+#define WAL_MAX_IMAGES 2                // Records changed by one operation
+#define WAL_MAX_TRANSACTIONS 2          // Log entries written by one operation
+#define WAL_DEFAULT_CHECKPOINT_SEC 10   // Background checkpoint interval
+
+// --- Tables a WAL image can target ---
+#define WAL_TABLE_ACCOUNTS 0
+#define WAL_TABLE_LOANS 1
+#define WAL_TABLE_ACCOUNT_STATE 2 // Hot part of an account only (accounts.dat)
+
+// After-image of one fixed-size record
+struct WalImage {
+    int table;
+    int record;
+    int append;      // 1 if the record extends the file
+    char data[sizeof(struct CustomerAccount)]; // Largest image type
+};
+
+// One logical operation (fixed size, so it fits the journal)
+struct WalRecord {
+    unsigned int magic;
+    unsigned int checksum;  // Over everything after this field
+    int epoch;              // Checkpoint generation the record belongs to
+    int image_count;
+    int transaction_count;
+    struct WalImage images[WAL_MAX_IMAGES];
+    struct Transaction transactions[WAL_MAX_TRANSACTIONS];
+};
+
+// --- WAL Lifecycle (parent, before fork) ---
+int wal_recover(void);
+int wal_init(const struct JournalConfig* config, int checkpoint_interval_sec);
+
+// --- Building & Committing an Operation ---
+void wal_begin(struct WalRecord* record);
+int wal_add_account(struct WalRecord* record, int record_number, const struct CustomerAccount* account, int append);
+int wal_add_account_state(struct WalRecord* record, int record_number, const struct AccountState* state);
+int wal_add_loan(struct WalRecord* record, int record_number, const struct LoanApplication* loan, int append);
+int wal_add_transaction(struct WalRecord* record, int account_id, int op, money_t amount,
+                        int counterparty_id, money_t new_balance);
+int wal_commit(struct WalRecord* record);
+
+// --- Checkpointing ---
+int wal_checkpoint(void);
+int wal_pause(void);
+int wal_resume(void);
+void wal_abandon(void);
+
+#endif // WAL_H